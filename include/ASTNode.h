@@ -1,11 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <initializer_list>
-#include <list>
 #include <ostream>
-#include <set>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 struct ASTLocation {
 	size_t line = 0;
@@ -22,19 +21,24 @@ std::ostream & operator<<(std::ostream &, const ASTLocation &);
 
 class Parser;
 
+/** AST nodes are allocated from a shared pool of large chunks and recycled by size when deleted (see operator new). */
 class ASTNode {
 	private:
 		ASTNode() = default;
 
 	public:
+		enum class Attribute: uint8_t {Static = 1, Constructor = 2, Destructor = 4};
+
 		Parser *parser = nullptr;
 		int symbol = 0;
+		/** A bitwise OR of Attribute values. */
+		uint8_t attributes = 0;
 		ASTLocation location;
 		const std::string *text = nullptr;
 		ASTNode *parent = nullptr;
-		std::list<ASTNode *> children;
-		std::set<std::string> attributes;
-		std::unordered_map<std::string, std::string> map;
+		std::vector<ASTNode *> children;
+		/** For constructor declarations inside struct definitions, the name of the struct. */
+		const std::string *structName = nullptr;
 
 		ASTNode(Parser &, int sym, const ASTLocation &loc, const char *info);
 		ASTNode(Parser &, int sym, const ASTLocation &loc, const std::string *info);
@@ -51,6 +55,12 @@ class ASTNode {
 		ASTNode & operator=(ASTNode &&) = delete;
 		virtual ~ASTNode();
 
+		static void * operator new(size_t);
+		static void operator delete(void *, size_t);
+
+		bool hasAttribute(Attribute attribute) const { return (attributes & uint8_t(attribute)) != 0; }
+		ASTNode * setAttribute(Attribute attribute) { attributes |= uint8_t(attribute); return this; }
+
 		ASTNode * operator[](size_t) const;
 		ASTNode * at(size_t) const;
 		size_t size() const;
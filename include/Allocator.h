@@ -3,19 +3,34 @@
 #include <memory>
 #include <string>
 
+#include "Variable.h"
+#include "Why.h"
+
 class Function;
-struct VirtualRegister;
+
+/** Precise interference links a definition only with the vregs live right after it. Block-clique interference links
+ *  every pair of vregs referenced or live anywhere in the same block and relies on Function::split() to keep blocks
+ *  small enough to color. */
+enum class InterferenceMode {Precise, BlockCliques};
+
+/** Selects the register allocator. Auto uses linear scan for functions past LinearScanAllocator's size thresholds and
+ *  graph coloring for everything else. */
+enum class AllocatorChoice {Auto, Coloring, LinearScan};
 
 class Allocator {
 	protected:
 		Function &function;
 		int spillCount = 0;
 		int attempts = 0;
+		int coalescedCount = 0;
 
 	public:
 		enum class Result: int {Spilled = 1, NotSpilled = 2, Success = 3};
 
-		std::shared_ptr<VirtualRegister> lastSpill, lastSpillAttempt;
+		/** The range of registers that allocators may assign. */
+		constexpr static int firstRegister = Why::temporaryOffset, lastRegister = Why::savedOffset + Why::savedCount - 1;
+
+		VregPtr lastSpill, lastSpillAttempt;
 
 		explicit Allocator(Function &function_): function(function_) {}
 		Allocator(const Allocator &) = delete;
@@ -27,6 +42,7 @@ class Allocator {
 		virtual Result attempt() = 0;
 		[[nodiscard]] int getAttempts() const { return attempts; }
 		[[nodiscard]] int getSpillCount() const { return spillCount; }
+		[[nodiscard]] int getCoalescedCount() const { return coalescedCount; }
 
 		static std::string stringify(Result result) {
 			return result == Result::Spilled? "Spilled" : (result == Result::NotSpilled? "NotSpilled" :
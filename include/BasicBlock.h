@@ -5,12 +5,13 @@
 #include <set>
 #include <string>
 
+#include "Bitset.h"
 #include "Makeable.h"
+#include "Variable.h"
 #include "WeakSet.h"
 
 class Function;
 class Node;
-struct VirtualRegister;
 struct WhyInstruction;
 
 struct BasicBlock: Makeable<BasicBlock> {
@@ -18,27 +19,31 @@ struct BasicBlock: Makeable<BasicBlock> {
 	std::string label;
 	std::list<std::shared_ptr<WhyInstruction>> instructions;
 	WeakSet<BasicBlock> predecessors, successors;
-	std::set<std::shared_ptr<VirtualRegister>> liveIn, liveOut, readCache, writtenCache;
+	/** IDs of the vregs live on entry to and on exit from the block. Filled in by Function::computeLiveness(). */
+	Bitset liveIn, liveOut;
+	/** IDs of the vregs read before any write in the block and of the vregs written anywhere in the block. */
+	Bitset uses, defs;
 	Node *node = nullptr;
 	int index = -1;
 
 	BasicBlock(Function &function_, std::string label_): function(function_), label(std::move(label_)) {}
 
-	BasicBlock & operator+=(const std::shared_ptr<WhyInstruction> &instruction) {
-		instructions.push_back(instruction);
-		return *this;
-	}
+	BasicBlock & operator+=(const std::shared_ptr<WhyInstruction> &instruction);
 
 	explicit operator bool() const { return !instructions.empty(); }
 
 	/** Returns a set of all variables (excluding globals and register-allocated/precolored) referenced in the block. */
-	[[nodiscard]] std::set<std::shared_ptr<VirtualRegister>> gatherVariables() const;
+	[[nodiscard]] std::set<VregPtr> gatherVariables() const;
 
 	/** Returns the number of unique variables (excluding globals and register-allocated/precolored) referenced in the
 	 *  block. */
 	[[nodiscard]] size_t countVariables() const;
 
-	void cacheReadWritten();
+	/** Recomputes the uses and defs sets. Precolored vregs and vregs belonging to other functions are ignored. */
+	void computeUsesAndDefs();
+
+	/** Returns whether control can continue from the end of the block into the block after it. */
+	[[nodiscard]] bool fallsThrough() const;
 } __attribute__((packed, aligned(128)));
 
 using BasicBlockPtr = std::shared_ptr<BasicBlock>;
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** A dynamically sized set of small nonnegative integers (usually vreg IDs) stored as 64-bit words. */
+class Bitset {
+	private:
+		std::vector<uint64_t> words;
+
+	public:
+		Bitset() = default;
+		explicit Bitset(size_t bits): words((bits + 63) / 64, 0) {}
+
+		/** Grows or shrinks the set to hold at least the given number of bits. New bits are cleared. */
+		void resize(size_t bits) { words.resize((bits + 63) / 64, 0); }
+		size_t capacity() const { return words.size() * 64; }
+		void clear() { std::fill(words.begin(), words.end(), 0); }
+
+		bool test(size_t index) const {
+			return index / 64 < words.size() && ((words[index / 64] >> (index % 64)) & 1) != 0;
+		}
+
+		void set(size_t index) {
+			if (words.size() <= index / 64)
+				words.resize(index / 64 + 1, 0);
+			words[index / 64] |= uint64_t(1) << (index % 64);
+		}
+
+		void reset(size_t index) {
+			if (index / 64 < words.size())
+				words[index / 64] &= ~(uint64_t(1) << (index % 64));
+		}
+
+		size_t count() const {
+			size_t out = 0;
+			for (const uint64_t word: words)
+				out += size_t(std::popcount(word));
+			return out;
+		}
+
+		bool empty() const {
+			return std::all_of(words.begin(), words.end(), [](uint64_t word) { return word == 0; });
+		}
+
+		/** Adds every member of another set to this one. Returns whether this set changed. */
+		bool unite(const Bitset &other) {
+			if (words.size() < other.words.size())
+				words.resize(other.words.size(), 0);
+			bool changed = false;
+			for (size_t i = 0; i < other.words.size(); ++i) {
+				const uint64_t old = words[i];
+				words[i] |= other.words[i];
+				changed = changed || words[i] != old;
+			}
+			return changed;
+		}
+
+		/** Removes every member of another set from this one. */
+		Bitset & subtract(const Bitset &other) {
+			for (size_t i = 0, max = std::min(words.size(), other.words.size()); i < max; ++i)
+				words[i] &= ~other.words[i];
+			return *this;
+		}
+
+		Bitset & operator|=(const Bitset &other) {
+			unite(other);
+			return *this;
+		}
+
+		bool operator==(const Bitset &other) const {
+			const size_t common = std::min(words.size(), other.words.size());
+			if (!std::equal(words.begin(), words.begin() + common, other.words.begin()))
+				return false;
+			const auto &longer = words.size() < other.words.size()? other.words : words;
+			return std::all_of(longer.begin() + common, longer.end(), [](uint64_t word) { return word == 0; });
+		}
+
+		/** Calls a function with each member of the set in ascending order. */
+		template <typename F>
+		void forEach(F &&function) const {
+			for (size_t i = 0; i < words.size(); ++i)
+				for (uint64_t word = words[i]; word != 0; word &= word - 1)
+					function(i * 64 + size_t(std::countr_zero(word)));
+		}
+};
@@ -2,9 +2,10 @@
 
 #include <memory>
 #include <set>
+#include <vector>
 
 #include "Allocator.h"
-#include "Graph.h"
+#include "InterferenceGraph.h"
 #include "Variable.h"
 
 /** Assigns registers using a graph coloring algorithm. */
@@ -12,19 +13,46 @@ class ColoringAllocator: public Allocator {
 	private:
 		std::set<int> triedIDs;
 
+		/** Returns the cost of spilling each node in the interference graph: its reads and writes, each weighted by
+		 *  10^(loop nesting depth) of its block. Rematerializable vregs cost half as much. Vregs that can't be spilled,
+		 *  or whose every read directly follows a definition so that spilling them gains nothing, cost infinity. The
+		 *  coloring divides these by degree. */
+		std::vector<double> spillCosts() const;
+
+		/** Chooses a spill when none of the uncolored nodes are worth spilling: the spillable node with the lowest cost
+		 *  per neighbor among the uncolored nodes' neighbors, or among all nodes if none of those qualify, or failing that
+		 *  any spillable node. */
+		VregPtr selectCheapest(const std::vector<double> &costs,
+		                                                const std::vector<size_t> &uncolored);
+
+		/** Gives vregs the argument or return value register they're moved from or to when that register isn't
+		 *  otherwise written, and no call happens, while the vreg is live. Only vregs whose whole live range is inside
+		 *  one block are considered. Returns the number of vregs that were given a register. */
+		int coalescePrecolored();
+
+		/** Conservatively coalesces the ends of moves between vregs in the interference graph, adding the spill cost of
+		 *  each removed node to the node it was merged into. Returns the number of moves coalesced. */
+		int coalesce(std::vector<double> &costs);
+
+		/** Links each definition with every vreg live immediately after it. */
+		void addPreciseInterference();
+
+		/** Links every pair of vregs that are referenced, live-in or live-out in the same block. */
+		void addBlockCliqueInterference();
+
 	public:
-		Graph interference = Graph("interference");
+		InterferenceMode mode;
+		InterferenceGraph interference;
 
-		using Allocator::Allocator;
+		explicit ColoringAllocator(Function &function_, InterferenceMode mode_ = InterferenceMode::Precise):
+			Allocator(function_), mode(mode_) {}
 
 		/** Creates an interference graph of all the function's variables. */
 		void makeInterferenceGraph();
 
-		std::shared_ptr<VirtualRegister> selectMostLive(int *liveness_out = nullptr) const;
-
-		/** Makes an attempt to allocate registers. If the graph is uncolorable, the function attempts to spill a
-		 *  variable. If one was spilled, it returns Spilled; otherwise, it returns NotSpilled. If the graph was
-		 *  colorable, it returns Success. */
+		/** Makes an attempt to allocate registers. If optimistic coloring leaves some variables uncolored, the function
+		 *  spills all of them that can be spilled. If any were spilled, it returns Spilled; otherwise, it returns
+		 *  NotSpilled. If the graph was colorable, it returns Success. */
 		Result attempt() override;
 
 		const decltype(triedIDs)    & getTriedIDs()    const { return triedIDs;    }
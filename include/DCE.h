@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Pass.h"
+
+/** Dead code elimination. Deletes the blocks that can't be reached from the entry of the CFG, then every instruction
+ *  without side effects (see WhyInstruction::hasSideEffects()) whose results can't reach an instruction with side
+ *  effects through the def-use chains in the vreg table. Starting from the instructions that have to stay instead of
+ *  from the ones that are unused means that values only feeding each other around a loop are deleted too. */
+class DCE: public Pass {
+	private:
+		/** Deletes the blocks that the dominator tree doesn't reach, along with the phi inputs that came from them.
+		 *  Returns whether there were any. */
+		bool removeUnreachable();
+
+		/** Deletes the instructions whose results are never needed. Returns whether there were any. */
+		bool removeDead();
+
+	public:
+		using Pass::Pass;
+
+		bool run() override;
+};
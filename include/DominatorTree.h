@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Graph;
+class Node;
+
+/** The dominator tree or post-dominator tree of the nodes reachable from an entry node, along with their dominance
+ *  frontiers. Post-dominance is relative to a virtual exit that every node without successors leads to, so nodes that
+ *  can't reach such a node (for example, nodes stuck in an infinite loop) aren't part of a post-dominator tree. */
+class DominatorTree {
+	public:
+		static constexpr size_t NONE = SIZE_MAX;
+
+	private:
+		bool post;
+		/** Node indices are positions in reverse postorder, offset by one: index 0 is a virtual root whose only
+		 *  children are the entry (or every exit, for post-dominator trees). */
+		std::vector<Node *> nodes;
+		std::unordered_map<const Node *, size_t> indices;
+		std::vector<size_t> idoms;
+		std::vector<std::vector<size_t>> predecessors;
+		std::vector<std::vector<Node *>> childLists;
+		/** Frontiers can have a quadratic number of entries in total, so they're only computed when first asked for. */
+		mutable std::vector<std::vector<Node *>> frontiers;
+		mutable bool frontiersComputed = false;
+		/** Preorder numbers of each node in the tree and the largest preorder number among its descendants, which make
+		 *  dominance checks constant-time. */
+		std::vector<size_t> preorder, lastDescendant;
+		std::vector<Node *> ordered;
+
+		size_t indexOf(const Node &) const;
+
+		void computeFrontiers() const;
+
+	public:
+		/** Uses Cooper, Harvey and Kennedy's iterative algorithm over reverse postorder. */
+		DominatorTree(const Graph &, Node &entry, bool post_ = false);
+
+		bool isPost() const { return post; }
+
+		/** Returns the number of nodes in the tree. */
+		size_t size() const { return ordered.size(); }
+
+		/** Returns the nodes in the tree in reverse postorder (of the reversed graph, for post-dominator trees). Every
+		 *  node comes after its immediate dominator. */
+		const std::vector<Node *> & order() const { return ordered; }
+
+		/** Returns whether a node is part of the tree. */
+		bool contains(const Node &) const;
+
+		/** Returns the immediate (post-)dominator of a node, or nullptr for the roots of the tree and nodes that aren't
+		 *  in it. */
+		Node * immediateDominator(const Node &) const;
+
+		/** Returns whether one node (post-)dominates another. Every node in the tree dominates itself. */
+		bool dominates(const Node &dominator, const Node &node) const;
+
+		/** Returns whether one node strictly (post-)dominates another. */
+		bool strictlyDominates(const Node &dominator, const Node &node) const;
+
+		/** Returns the nodes immediately (post-)dominated by a node. */
+		const std::vector<Node *> & children(const Node &) const;
+
+		/** Returns the (post-)dominance frontier of a node without duplicates. */
+		const std::vector<Node *> & frontier(const Node &) const;
+
+		/** Returns the nodes without an immediate (post-)dominator: the entry, or the exits for post-dominator trees. */
+		const std::vector<Node *> & roots() const;
+};
@@ -19,6 +19,7 @@
 #include "Makeable.h"
 #include "Program.h"
 #include "Scope.h"
+#include "StringSet.h"
 #include "Type.h"
 #include "Util.h"
 #include "Variable.h"
@@ -68,14 +69,19 @@ struct Expr: Checkable, std::enable_shared_from_this<Expr> {
 	[[nodiscard]] virtual size_t getSize(const Context &) const { return 0; } // in bytes
 	/** Attempts to evaluate the expression at compile time. */
 	[[nodiscard]] virtual std::optional<ssize_t> evaluate(const Context &) const { return std::nullopt; }
-	/** This function both performs type checking and returns a type. */
-	virtual std::unique_ptr<Type> getType(const Context &) const = 0;
+	/** This function both performs type checking and returns a type. The result is memoized per node for as long as the
+	 *  context's scope, struct name and program stay the same and no scope in the program has been created or added to
+	 *  since. */
+	std::unique_ptr<Type> getType(const Context &) const;
+	/** Like getType, but returns the memoized type instead of a copy. The reference is invalidated by the next call to
+	 *  getType or getTypeRef on this node. */
+	const Type & getTypeRef(const Context &) const;
 	virtual bool compileAddress(const VregPtr &, Function &, const Context &) { return false; }
 	// virtual bool forward(const VregPtr &destination, Function &function, const Context &context) {
 		// return compileAddress(destination, function, context);
 	// }
 	[[nodiscard]] virtual bool isLvalue(const Context &) const { return false; }
-	[[nodiscard]] bool isUnsigned(const Context &context) const { return getType(context)->isUnsigned(0); }
+	[[nodiscard]] bool isUnsigned(const Context &context) const { return getTypeRef(context).isUnsigned(0); }
 	Expr * setLocation(const ASTLocation &location_) { debug.location = location_; return this; }
 	[[nodiscard]] const ASTLocation & getLocation() const { return debug.location; }
 	Expr * setFunction(const Function &);
@@ -92,6 +98,17 @@ struct Expr: Checkable, std::enable_shared_from_this<Expr> {
 	[[nodiscard]] std::shared_ptr<const T> ptrcast() const {
 		return std::dynamic_pointer_cast<const T>(shared_from_this());
 	}
+
+	protected:
+		/** Performs type checking and computes the type returned by getType. */
+		virtual std::unique_ptr<Type> computeType(const Context &) const = 0;
+
+	private:
+		mutable std::unique_ptr<Type> cachedType;
+		mutable const Scope *cachedScope = nullptr;
+		mutable const Program *cachedProgram = nullptr;
+		mutable std::string cachedStructName;
+		mutable size_t cachedGeneration = 0;
 };
 
 using Argument = std::variant<Expr *, VregPtr>;
@@ -125,21 +142,19 @@ struct BinaryExpr: Expr {
 
 	bool shouldParenthesize() const override { return true; }
 
-	std::unique_ptr<Type> getType(const Context &context) const override {
+	std::unique_ptr<Type> computeType(const Context &context) const override {
 		if (auto fnptr = getOperator(context))
 			return std::unique_ptr<Type>(fnptr->returnType->copy());
-		auto left_type  = left->getType(context);
-		auto right_type = right->getType(context);
-		if (!(*left_type && *right_type) || !(*right_type && *left_type))
-			throw ImplicitConversionError(*left_type, *right_type, getLocation());
-		return left_type;
+		const Type &left_type  = left->getTypeRef(context);
+		const Type &right_type = right->getTypeRef(context);
+		if (!(left_type && right_type) || !(right_type && left_type))
+			throw ImplicitConversionError(left_type, right_type, getLocation());
+		return std::unique_ptr<Type>(left_type.copy());
 	}
 
 	virtual FunctionPtr getOperator(const Context &context) const {
-		TypePtr left_type = left->getType(context);
-		TypePtr right_type = right->getType(context);
-		return context.program->getOperator({left_type.get(), right_type.get()}, operator_str_map.at(std::string(O)),
-			getLocation());
+		return context.program->getOperator({&left->getTypeRef(context), &right->getTypeRef(context)},
+			operator_str_map.at(std::string(O)), getLocation());
 	}
 };
 
@@ -149,16 +164,16 @@ struct LogicExpr: BinaryExpr<O> {
 
 	[[nodiscard]] size_t getSize(const Context &context) const override { return this->left->getSize(context); }
 
-	[[nodiscard]] std::unique_ptr<Type> getType(const Context &context) const override {
+	[[nodiscard]] std::unique_ptr<Type> computeType(const Context &context) const override {
 		if (auto fnptr = this->getOperator(context))
 			return std::unique_ptr<Type>(fnptr->returnType->copy());
-		auto left_type  = this->left->getType(context);
-		auto right_type = this->right->getType(context);
+		const Type &left_type  = this->left->getTypeRef(context);
+		const Type &right_type = this->right->getTypeRef(context);
 		auto bool_type = std::make_unique<BoolType>();
-		if (!(*left_type && *bool_type))
-			throw ImplicitConversionError(*left_type, *bool_type, this->getLocation());
-		if (!(*right_type && *bool_type))
-			throw ImplicitConversionError(*right_type, *bool_type, this->getLocation());
+		if (!(left_type && *bool_type))
+			throw ImplicitConversionError(left_type, *bool_type, this->getLocation());
+		if (!(right_type && *bool_type))
+			throw ImplicitConversionError(right_type, *bool_type, this->getLocation());
 		return bool_type;
 	}
 };
@@ -192,13 +207,13 @@ struct CompExpr: BinaryExpr<O> {
 		return std::nullopt;
 	}
 
-	[[nodiscard]] std::unique_ptr<Type> getType(const Context &context) const override {
+	[[nodiscard]] std::unique_ptr<Type> computeType(const Context &context) const override {
 		if (auto fnptr = this->getOperator(context))
 			return std::unique_ptr<Type>(fnptr->returnType->copy());
-		auto left_type  = this->left->getType(context);
-		auto right_type = this->right->getType(context);
-		if (!(*left_type && *right_type) || !(*right_type && *left_type))
-			throw ImplicitConversionError(*left_type, *right_type, this->getLocation());
+		const Type &left_type  = this->left->getTypeRef(context);
+		const Type &right_type = this->right->getTypeRef(context);
+		if (!(left_type && right_type) || !(right_type && left_type))
+			throw ImplicitConversionError(left_type, right_type, this->getLocation());
 		return std::make_unique<BoolType>();
 	}
 };
@@ -223,7 +238,7 @@ struct PlusExpr: BinaryExpr<"+"> {
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	size_t getSize(const Context &) const override { return 8; }
 	std::optional<ssize_t> evaluate(const Context &) const override;
-	std::unique_ptr<Type> getType(const Context &context) const override;
+	std::unique_ptr<Type> computeType(const Context &context) const override;
 };
 
 struct MinusExpr: BinaryExpr<"-"> {
@@ -240,7 +255,7 @@ struct MinusExpr: BinaryExpr<"-"> {
 		return std::nullopt;
 	}
 
-	std::unique_ptr<Type> getType(const Context &context) const override;
+	std::unique_ptr<Type> computeType(const Context &context) const override;
 };
 
 struct MultExpr: BinaryExpr<"*"> {
@@ -334,7 +349,7 @@ struct NumberExpr: AtomicExpr {
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	size_t getSize(const Context &) const override;
 	size_t getSize() const;
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 };
 
 struct BoolExpr: AtomicExpr {
@@ -345,7 +360,7 @@ struct BoolExpr: AtomicExpr {
 	ssize_t getValue() const override { return value? 1 : 0; }
 	std::optional<ssize_t> evaluate(const Context &) const override { return getValue(); }
 	void compile(VregPtr, Function &, const Context &, size_t) override;
-	std::unique_ptr<Type> getType(const Context &) const override { return std::make_unique<BoolType>(); }
+	std::unique_ptr<Type> computeType(const Context &) const override { return std::make_unique<BoolType>(); }
 };
 
 struct NullExpr: AtomicExpr {
@@ -356,7 +371,7 @@ struct NullExpr: AtomicExpr {
 	size_t getSize(const Context &) const override { return 8; }
 	std::optional<ssize_t> evaluate(const Context &) const override { return getValue(); }
 	void compile(VregPtr, Function &, const Context &, size_t) override;
-	std::unique_ptr<Type> getType(const Context &) const override {
+	std::unique_ptr<Type> computeType(const Context &) const override {
 		return std::make_unique<PointerType>(new VoidType);
 	}
 };
@@ -368,17 +383,19 @@ struct VregExpr: Expr, Makeable<VregExpr> {
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	explicit operator std::string() const override { return virtualRegister->regOrID(); }
 	size_t getSize(const Context &) const override;
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 };
 
 struct VariableExpr: Expr {
-	std::string name;
-	explicit VariableExpr(std::string name_): name(std::move(name_)) {}
+	/** Interned, so that scopes can look it up without hashing the string. */
+	const std::string *name;
+	explicit VariableExpr(const std::string *name_): name(name_) {}
+	explicit VariableExpr(const std::string &name_): name(StringSet::intern(name_)) {}
 	Expr * copy() const override { return (new VariableExpr(name))->setDebug(debug); }
 	void compile(VregPtr, Function &, const Context &, size_t) override;
-	explicit operator std::string() const override { return name; }
+	explicit operator std::string() const override { return *name; }
 	size_t getSize(const Context &) const override;
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 	bool compileAddress(const VregPtr &, Function &, const Context &) override;
 	// bool forward(VregPtr, Function &, const Context &) override;
 	bool isLvalue(const Context &) const override { return true; }
@@ -392,7 +409,7 @@ struct AddressOfExpr: Expr, Makeable<AddressOfExpr> {
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	explicit operator std::string() const override { return "&" + std::string(*subexpr); }
 	size_t getSize(const Context &) const override { return 8; }
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 };
 
 struct NotExpr: Expr {
@@ -403,7 +420,7 @@ struct NotExpr: Expr {
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	explicit operator std::string() const override { return "~" + std::string(*subexpr); }
 	size_t getSize(const Context &context) const override { return subexpr->getSize(context); }
-	std::unique_ptr<Type> getType(const Context &context) const override;
+	std::unique_ptr<Type> computeType(const Context &context) const override;
 };
 
 struct LnotExpr: Expr {
@@ -414,7 +431,7 @@ struct LnotExpr: Expr {
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	explicit operator std::string() const override { return "!" + std::string(*subexpr); }
 	size_t getSize(const Context &context) const override { return subexpr->getSize(context); }
-	std::unique_ptr<Type> getType(const Context &context) const override;
+	std::unique_ptr<Type> computeType(const Context &context) const override;
 };
 
 struct StringExpr: Expr {
@@ -424,7 +441,7 @@ struct StringExpr: Expr {
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	explicit operator std::string() const override { return "\"" + Util::escape(contents) + "\""; }
 	size_t getSize(const Context &) const override { return 8; }
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 
 	private:
 		std::string getID(Program &) const;
@@ -438,7 +455,7 @@ struct DerefExpr: Expr {
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	explicit operator std::string() const override { return "*" + std::string(*subexpr); }
 	size_t getSize(const Context &) const override;
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 	std::unique_ptr<Type> checkType(const Context &) const;
 	bool compileAddress(const VregPtr &, Function &, const Context &) override;
 	bool isLvalue(const Context &) const override { return true; }
@@ -448,7 +465,7 @@ struct DerefExpr: Expr {
 struct HasArguments: Expr {
 	std::vector<ExprPtr> arguments;
 	explicit HasArguments(std::vector<ExprPtr> arguments_): arguments(std::move(arguments_)) {}
-	FunctionPtr findFunction(const std::string &, const Context &) const;
+	FunctionPtr findFunction(const std::string *, const Context &) const;
 };
 
 struct CallExpr: HasArguments {
@@ -470,7 +487,7 @@ struct CallExpr: HasArguments {
 	bool isLvalue(const Context &) const override;
 	explicit operator std::string() const override;
 	size_t getSize(const Context &) const override;
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 	std::string getStructName(const Context &) const;
 	FunctionPtr getOperator(const Context &) const;
 };
@@ -478,7 +495,7 @@ struct CallExpr: HasArguments {
 struct AssignExpr: BinaryExpr<"="> {
 	using BinaryExpr::BinaryExpr;
 	bool shouldParenthesize() const override { return false; }
-	std::unique_ptr<Type> getType(const Context &context) const override;
+	std::unique_ptr<Type> computeType(const Context &context) const override;
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	size_t getSize(const Context &context) const override { return left->getSize(context); }
 	std::optional<ssize_t> evaluate(const Context &) const override;
@@ -495,7 +512,7 @@ struct CompoundAssignExpr: BinaryExpr<O> {
 			->setDebug(this->debug);
 	}
 
-	[[nodiscard]] std::unique_ptr<Type> getType(const Context &context) const override {
+	[[nodiscard]] std::unique_ptr<Type> computeType(const Context &context) const override {
 		if (auto fnptr = this->getOperator(context))
 			return std::unique_ptr<Type>(fnptr->returnType->copy());
 		auto left_type  = this->left->getType(context);
@@ -524,7 +541,7 @@ struct CompoundAssignExpr: BinaryExpr<O> {
 			if (!tryCast(*right_type, *left_type, destination, function, this->getLocation()))
 				throw ImplicitConversionError(right_type, left_type, this->getLocation());
 			if (!this->left->compileAddress(temp_var, function, context))
-				throw LvalueError(std::string(*this->left->getType(context)), this->getLocation());
+				throw LvalueError(std::string(this->left->getTypeRef(context)), this->getLocation());
 			function.add<StoreRInstruction>(destination, temp_var)->setDebug(*this);
 			if (multiplier != 1)
 				function.add<MultIInstruction>(destination, destination, immLikeReg(destination, multiplier))
@@ -540,7 +557,7 @@ struct CompoundAssignExpr: BinaryExpr<O> {
 		auto left_value  = this->left?  this->left->evaluate(context)  : std::nullopt;
 		auto right_value = this->right? this->right->evaluate(context) : std::nullopt;
 		if (left_value && right_value) {
-			if (this->left->getType(context)->isUnsigned(0))
+			if (this->left->isUnsigned(context))
 				return FnU()(*left_value, *right_value);
 			return FnS()(*left_value, *right_value);
 		}
@@ -622,7 +639,7 @@ struct PointerArithmeticAssignExpr: CompoundAssignExpr<O, R, Fn> {
 				context, this->getLocation());
 			function.add<R>(destination, temp_var, destination)->setDebug(*this);
 			if (!this->left->compileAddress(temp_var, function, context))
-				throw LvalueError(std::string(*this->left->getType(context)), this->getLocation());
+				throw LvalueError(std::string(this->left->getTypeRef(context)), this->getLocation());
 			function.add<StoreRInstruction>(destination, temp_var)->setDebug(*this);
 			if (multiplier != 1)
 				function.add<MultIInstruction>(destination, destination, immLikeReg(destination, multiplier))
@@ -651,7 +668,7 @@ struct CastExpr: Expr {
 		return "(" + std::string(*targetType) + ") " + std::string(*subexpr);
 	}
 	size_t getSize(const Context &) const override { return targetType->getSize(); }
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 };
 
 struct AccessExpr: Expr {
@@ -662,8 +679,8 @@ struct AccessExpr: Expr {
 	Expr * copy() const override { return (new AccessExpr(array->copy(), subscript->copy()))->setDebug(debug); }
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	explicit operator std::string() const override { return std::string(*array) + "[" + std::string(*subscript) + "]"; }
-	size_t getSize(const Context &context) const override { return getType(context)->getSize(); }
-	std::unique_ptr<Type> getType(const Context &) const override;
+	size_t getSize(const Context &context) const override { return getTypeRef(context).getSize(); }
+	std::unique_ptr<Type> computeType(const Context &) const override;
 	bool compileAddress(const VregPtr &, Function &, const Context &) override;
 	bool isLvalue(const Context &) const override { return true; } // TODO: verify
 	std::unique_ptr<Type> check(const Context &);
@@ -682,9 +699,8 @@ struct LengthExpr: Expr {
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	explicit operator std::string() const override { return "#" + std::string(*subexpr); }
 	size_t getSize(const Context &context) const override { return subexpr->getSize(context); }
-	std::unique_ptr<Type> getType(const Context &context) const override {
-		auto type = subexpr->getType(context);
-		if (auto fnptr = context.program->getOperator({type.get()}, CPMTOK_HASH, getLocation()))
+	std::unique_ptr<Type> computeType(const Context &context) const override {
+		if (auto fnptr = context.program->getOperator({&subexpr->getTypeRef(context)}, CPMTOK_HASH, getLocation()))
 			return std::unique_ptr<Type>(fnptr->returnType->copy());
 		return std::make_unique<UnsignedType>(64);
 	}
@@ -716,7 +732,7 @@ struct PrefixExpr: Expr {
 			auto addr_variable = function.newVar(PointerType::make(subtype->copy()));
 			subexpr->compile(function.newVar(subtype), function, context, multiplier);
 			if (!subexpr->compileAddress(addr_variable, function, context))
-				throw LvalueError(std::string(*subexpr->getType(context)));
+				throw LvalueError(std::string(subexpr->getTypeRef(context)));
 			function.addComment("Prefix operator" + std::string(O));
 			function.add<LoadRInstruction>(addr_variable, destination)->setDebug(*this);
 			function.add<I>(destination, destination, immLikeReg(destination, to_add))->setDebug(*this);
@@ -727,10 +743,11 @@ struct PrefixExpr: Expr {
 		}
 	}
 	FunctionPtr getOperator(const Context &context) const {
-		TypePtr sub_type = this->subexpr->getType(context);
-		if (sub_type->isStruct())
-			sub_type = PointerType::make(sub_type->copy());
-		return context.program->getOperator({sub_type.get()}, operator_str_map.at(std::string(O) + "."), getLocation());
+		const Type &sub_type = this->subexpr->getTypeRef(context);
+		const int oper = operator_str_map.at(std::string(O) + ".");
+		if (sub_type.isStruct())
+			return context.program->getOperator({PointerType::make(sub_type.copy()).get()}, oper, getLocation());
+		return context.program->getOperator({&sub_type}, oper, getLocation());
 	}
 	bool compileAddress(const VregPtr & destination, Function &function, const Context &context) override {
 		return subexpr->compileAddress(destination, function, context);
@@ -738,7 +755,7 @@ struct PrefixExpr: Expr {
 	bool isLvalue(const Context &) const override { return true; }
 	explicit operator std::string() const override { return std::string(O) + std::string(*subexpr); }
 	size_t getSize(const Context &context) const override { return subexpr->getSize(context); }
-	std::unique_ptr<Type> getType(const Context &context) const override {
+	std::unique_ptr<Type> computeType(const Context &context) const override {
 		if (auto fnptr = getOperator(context))
 			return std::unique_ptr<Type>(fnptr->returnType->copy());
 		return subexpr->getType(context);
@@ -774,7 +791,7 @@ struct PostfixExpr: Expr {
 			auto addr_var = function.newVar(PointerType::make(subtype->copy()));
 			subexpr->compile(function.newVar(subtype), function, context, multiplier);
 			if (!subexpr->compileAddress(addr_var, function, context))
-				throw LvalueError(std::string(*subexpr->getType(context)));
+				throw LvalueError(std::string(subexpr->getTypeRef(context)));
 			function.addComment("Postfix operator" + std::string(O));
 			function.add<LoadRInstruction>(addr_var, destination)->setDebug(*this);
 			function.add<I>(destination, temp_var, immLikeReg(temp_var, to_add))->setDebug(*this);
@@ -785,14 +802,15 @@ struct PostfixExpr: Expr {
 		}
 	}
 	FunctionPtr getOperator(const Context &context) const {
-		TypePtr sub_type = this->subexpr->getType(context);
-		if (sub_type->isStruct())
-			sub_type = PointerType::make(sub_type->copy());
-		return context.program->getOperator({sub_type.get()}, operator_str_map.at("." + std::string(O)), getLocation());
+		const Type &sub_type = this->subexpr->getTypeRef(context);
+		const int oper = operator_str_map.at("." + std::string(O));
+		if (sub_type.isStruct())
+			return context.program->getOperator({PointerType::make(sub_type.copy()).get()}, oper, getLocation());
+		return context.program->getOperator({&sub_type}, oper, getLocation());
 	}
 	explicit operator std::string() const override { return std::string(*subexpr) + std::string(O); }
 	size_t getSize(const Context &context) const override { return subexpr->getSize(context); }
-	std::unique_ptr<Type> getType(const Context &context) const override {
+	std::unique_ptr<Type> computeType(const Context &context) const override {
 		if (auto fnptr = getOperator(context))
 			return std::unique_ptr<Type>(fnptr->returnType->copy());
 		return subexpr->getType(context);
@@ -823,7 +841,7 @@ struct TernaryExpr: Expr {
 
 	bool shouldParenthesize() const override { return true; }
 
-	std::unique_ptr<Type> getType(const Context &context) const override;
+	std::unique_ptr<Type> computeType(const Context &context) const override;
 	size_t getSize(const Context &) const override;
 };
 
@@ -839,7 +857,7 @@ struct DotExpr: Expr {
 	Expr * copy() const override { return (new DotExpr(left->copy(), ident))->setDebug(debug); }
 	explicit operator std::string() const override { return stringify(left.get()) + "." + ident; }
 	bool shouldParenthesize() const override { return true; }
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 	bool compileAddress(const VregPtr &, Function &, const Context &) override;
 	bool isLvalue(const Context &) const override { return true; }
 	std::shared_ptr<StructType> checkType(const Context &) const;
@@ -858,7 +876,7 @@ struct ArrowExpr: Expr {
 	Expr * copy() const override { return (new ArrowExpr(left->copy(), ident))->setDebug(debug); }
 	explicit operator std::string() const override { return stringify(left.get()) + "->" + ident; }
 	bool shouldParenthesize() const override { return true; }
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 	bool compileAddress(const VregPtr &, Function &, const Context &) override;
 	bool isLvalue(const Context &) const override { return true; }
 	std::shared_ptr<StructType> checkType(const Context &) const;
@@ -873,31 +891,33 @@ struct SizeofExpr: Expr, Makeable<SizeofExpr> {
 	std::optional<ssize_t> evaluate(const Context &) const override { return argument->getSize(); }
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	size_t getSize(const Context &) const override { return 8; }
-	std::unique_ptr<Type> getType(const Context &) const override { return std::make_unique<UnsignedType>(64); }
+	std::unique_ptr<Type> computeType(const Context &) const override { return std::make_unique<UnsignedType>(64); }
 };
 
 struct OffsetofExpr: Expr {
-	std::string structName, fieldName;
-	explicit OffsetofExpr(std::string struct_name, std::string field_name):
-		structName(std::move(struct_name)), fieldName(std::move(field_name)) {}
+	const std::string *structName;
+	std::string fieldName;
+	explicit OffsetofExpr(const std::string *struct_name, std::string field_name):
+		structName(struct_name), fieldName(std::move(field_name)) {}
 	Expr * copy() const override { return (new OffsetofExpr(structName, fieldName))->setDebug(debug); }
-	explicit operator std::string() const override { return "offsetof(%" + structName  + ", " + fieldName + ")"; }
+	explicit operator std::string() const override { return "offsetof(%" + *structName + ", " + fieldName + ")"; }
 	std::optional<ssize_t> evaluate(const Context &) const override;
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	size_t getSize(const Context &) const override { return 8; }
-	std::unique_ptr<Type> getType(const Context &) const override { return std::make_unique<UnsignedType>(64); }
+	std::unique_ptr<Type> computeType(const Context &) const override { return std::make_unique<UnsignedType>(64); }
 };
 
 struct SizeofMemberExpr: Expr {
-	std::string structName, fieldName;
-	explicit SizeofMemberExpr(std::string struct_name, std::string field_name):
-		structName(std::move(struct_name)), fieldName(std::move(field_name)) {}
+	const std::string *structName;
+	std::string fieldName;
+	explicit SizeofMemberExpr(const std::string *struct_name, std::string field_name):
+		structName(struct_name), fieldName(std::move(field_name)) {}
 	Expr * copy() const override { return (new SizeofMemberExpr(structName, fieldName))->setDebug(debug); }
-	explicit operator std::string() const override { return "sizeof(%" + structName  + ", " + fieldName + ")"; }
+	explicit operator std::string() const override { return "sizeof(%" + *structName + ", " + fieldName + ")"; }
 	std::optional<ssize_t> evaluate(const Context &) const override;
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	size_t getSize(const Context &) const override { return 8; }
-	std::unique_ptr<Type> getType(const Context &) const override { return std::make_unique<UnsignedType>(64); }
+	std::unique_ptr<Type> computeType(const Context &) const override { return std::make_unique<UnsignedType>(64); }
 };
 
 struct InitializerExpr: Expr {
@@ -908,24 +928,25 @@ struct InitializerExpr: Expr {
 	explicit InitializerExpr(const std::vector<ExprPtr> &children_, bool is_constructor):
 		children(children_), isConstructor(is_constructor) {}
 	Expr * copy() const override;
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	void fullCompile(const VregPtr &start, Function &function, const Context &context);
 };
 
 struct ConstructorExpr: HasArguments {
 	size_t stackOffset;
-	std::string structName;
+	const std::string *structName;
 	std::vector<ExprPtr> arguments;
-	explicit ConstructorExpr(size_t stack_offset, std::string struct_name, const std::vector<ExprPtr> &arguments_ = {}):
-		HasArguments(arguments_), stackOffset(stack_offset), structName(std::move(struct_name)) {}
-	explicit ConstructorExpr(size_t stack_offset, std::string struct_name, std::vector<ExprPtr> &&arguments_):
-		HasArguments(std::move(arguments_)), stackOffset(stack_offset), structName(std::move(struct_name)) {}
+	explicit ConstructorExpr(size_t stack_offset, const std::string *struct_name,
+	                         const std::vector<ExprPtr> &arguments_ = {}):
+		HasArguments(arguments_), stackOffset(stack_offset), structName(struct_name) {}
+	explicit ConstructorExpr(size_t stack_offset, const std::string *struct_name, std::vector<ExprPtr> &&arguments_):
+		HasArguments(std::move(arguments_)), stackOffset(stack_offset), structName(struct_name) {}
 	Expr * copy() const override;
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	explicit operator std::string() const override;
 	size_t getSize(const Context &) const override;
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 	FunctionPtr findFunction(const Context &) const;
 	ConstructorExpr * addToScope(const Context &);
 };
@@ -941,20 +962,21 @@ struct NewExpr: Expr {
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	explicit operator std::string() const override;
 	size_t getSize(const Context &) const override;
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 	FunctionPtr findFunction(const Context &) const;
 };
 
 struct StaticFieldExpr: Expr {
-	std::string structName, fieldName;
-	explicit StaticFieldExpr(std::string struct_name, std::string field_name);
+	const std::string *structName;
+	std::string fieldName;
+	explicit StaticFieldExpr(const std::string *struct_name, std::string field_name);
 	Expr * copy() const override;
 	void compile(VregPtr, Function &, const Context &, size_t) override;
 	bool compileAddress(const VregPtr &, Function &, const Context &) override;
 	bool isLvalue(const Context &) const override { return true; }
 	explicit operator std::string() const override;
 	size_t getSize(const Context &) const override;
-	std::unique_ptr<Type> getType(const Context &) const override;
+	std::unique_ptr<Type> computeType(const Context &) const override;
 	std::shared_ptr<StructType> getStruct(const Context &) const;
 	std::string mangle(const Context &) const;
 };
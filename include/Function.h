@@ -4,17 +4,20 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <set>
 #include <string>
 #include <vector>
 
 #include "ASTNode.h"
 #include "BasicBlock.h"
+#include "Bitset.h"
 #include "DebugData.h"
 #include "Graph.h"
 #include "Makeable.h"
 #include "Type.h"
 #include "Variable.h"
+#include "VregTable.h"
 
 class ASTNode;
 struct BlockScope;
@@ -23,6 +26,7 @@ struct Instruction;
 struct Program;
 struct Scope;
 struct WhyInstruction;
+class Writer;
 
 using ExprPtr = std::shared_ptr<Expr>;
 using ScopePtr = std::shared_ptr<Scope>;
@@ -30,8 +34,21 @@ using WhyPtr = std::shared_ptr<WhyInstruction>;
 
 class Function: public Makeable<Function> {
 	private:
+		/** Backs the function's instructions and anonymous vregs. It's declared before everything that refers to them
+		 *  so that it's destroyed last. */
+		std::pmr::monotonic_buffer_resource arena;
+		/** Owns the vregs made by newVar() and precolored(). Instructions only hold handles to them. */
+		std::pmr::deque<VirtualRegister> registerPool{&arena};
 		int nextBlock = 0, nextScope = 0, anons = 0;
 		bool thisAdded = false;
+		/** Whether instructions have been inserted or removed since the last reindex(). */
+		bool indicesStale = false;
+		/** The result of mangle(), or empty if it needs to be recomputed. Cleared by the setters that change the name's
+		 *  inputs. */
+		mutable std::string mangledName;
+		/** Analyses of the CFG, computed on first use and dropped by makeCFG(). */
+		std::unique_ptr<DominatorTree> dominatorCache, postDominatorCache;
+		std::unique_ptr<LoopForest> loopCache;
 
 		void compile(const ASTNode &, const std::string &break_label = "", const std::string &continue_label = "",
 		             const ScopePtr &parent_scope = nullptr);
@@ -42,9 +59,10 @@ class Function: public Makeable<Function> {
 		Program &program;
 		std::string name = "???";
 		std::list<WhyPtr> instructions;
-		std::map<std::string, VariablePtr> variables;
+		/** Keyed by interned name. */
+		std::unordered_map<const std::string *, VariablePtr> variables;
 		std::vector<VariablePtr> variableOrder;
-		std::set<VregPtr> virtualRegisters;
+		VregSet virtualRegisters;
 		/** Offsets are relative to the value in the frame pointer right after the stack pointer is written to it in the
 		 *  prologue. */
 		std::map<VregPtr, size_t> stackOffsets;
@@ -64,9 +82,17 @@ class Function: public Makeable<Function> {
 		std::shared_ptr<Scope> selfScope;
 		/** Maps basic blocks to their corresponding CFG nodes. */
 		std::unordered_map<const BasicBlock *, Node *> bbNodeMap;
+		/** Maps vreg IDs to vregs for the bitsets filled in by computeLiveness() and to their definitions and uses,
+		 *  which are filled in by updateVregs() and kept up to date by spilling. */
+		VregTable vregTable;
 		std::vector<std::shared_ptr<Scope>> scopeStack;
 		std::shared_ptr<StructType> structParent;
 		bool isStatic = false;
+		/** Statistics from the last register allocation. */
+		int spillCount = 0, allocationAttempts = 0, coalescedMoves = 0, removedMoves = 0, rematerializedCount = 0;
+		/** The number of basic blocks the function had when register allocation succeeded. */
+		size_t blockCount = 0;
+		bool usedLinearScan = false;
 
 		Function(Program &, const ASTNode *);
 
@@ -80,10 +106,24 @@ class Function: public Makeable<Function> {
 
 		std::vector<std::string> stringify(const std::map<DebugData, size_t> &debug_map, bool colored = false) const;
 
-		std::string mangle() const;
+		/** Writes the function's instructions to a writer one line at a time, each indented by a tab. */
+		void emit(Writer &, const std::map<DebugData, size_t> &debug_map) const;
 
+		/** Returns the mangled name, which is computed on the first call and cached. */
+		const std::string & mangle() const;
+
+		/** Lowers and finalizes the function. */
 		void compile();
 
+		/** Lowers the function's AST into Why instructions. This can touch program-wide state (string IDs, struct
+		 *  types, inline assembly parsing), so functions must be lowered one at a time. */
+		void lower();
+
+		/** Performs block extraction, register allocation and prologue/epilogue insertion on the lowered
+		 *  instructions. Only state owned by this function is modified, so different functions can be finalized
+		 *  concurrently. */
+		void finalize();
+
 		std::set<int> usedGPRegisters() const;
 
 		VregPtr newVar(const TypePtr & = nullptr);
@@ -104,15 +144,50 @@ class Function: public Makeable<Function> {
 
 		/** If any blocks have more unique variables than the number of temporary registers supported by the ISA, this
 		 *  function will split the blocks until all blocks can fit their variables in temporary registers. Returns
-		 *  the number of new blocks created. */
+		 *  the number of new blocks created. Does nothing unless the program uses block-clique interference. */
 		int split(std::map<std::string, BasicBlockPtr> * = nullptr);
 
+		/** Computes the live-in and live-out sets of every block with an iterative worklist over the blocks. */
 		void computeLiveness();
 
-		void upAndMark(const BasicBlockPtr &, const VregPtr &);
+		/** Returns whether a vreg takes part in liveness analysis, i.e. whether it belongs to this function and isn't
+		 *  precolored. */
+		bool isTracked(const VregPtr &) const;
+
+		/** Returns the IDs of the vregs live immediately before an instruction. Requires up-to-date liveness. */
+		Bitset liveBefore(const WhyPtr &) const;
+
+		/** Returns the IDs of the vregs live immediately after an instruction. Requires up-to-date liveness. */
+		Bitset liveAfter(const WhyPtr &) const;
+
+		/** Moves locals and arguments into vregs of their own when their stack slots are only ever loaded from and
+		 *  stored to directly, then packs the remaining slots together. Slots whose addresses are used in any other way
+		 *  (taken with &, bound to a reference, passed to inline assembly or offset into) stay on the stack. Must run
+		 *  before blocks are extracted. Returns the new vregs. */
+		std::vector<VregPtr> promoteLocals();
 
-		/** Tries to spill a variable. Returns true if any instructions were inserted. */
-		bool spill(const VregPtr &);
+		/** Gives promoted variables that can be read before they're written a zero at the start of the function, so
+		 *  that no vreg is live into the entry block without a definition. Requires up-to-date liveness. */
+		void initializePromoted(const std::vector<VregPtr> &promoted, const DebugData &);
+
+		/** Puts the function into SSA form, runs the optimization passes on it and takes it back out of SSA form. Must
+		 *  run after blocks are extracted and liveness is computed and before registers are allocated. Does nothing if
+		 *  the program has optimization disabled or the function can't be put into SSA form. */
+		void optimize();
+
+		/** Tries to spill a variable. Returns true if any instructions were inserted. Liveness is recomputed afterwards
+		 *  unless update_liveness is false, which lets callers spill several variables before recomputing it once.
+		 *  Variables with a rematerializer (see getRematerializer()) are recomputed before each use instead of being
+		 *  stored on the stack. */
+		bool spill(const VregPtr &, bool update_liveness = true);
+
+		/** Returns a variable's only definition if it's cheap enough to repeat before each use instead of spilling: an
+		 *  immediate, a label address or an offset from the frame pointer. Returns nullptr otherwise. */
+		WhyPtr getRematerializer(const VregPtr &) const;
+
+		/** Replaces each use of a variable with a new vreg defined by a copy of the given definition inserted right
+		 *  before the use, then removes the original definition if every use was replaced. */
+		bool rematerialize(const VregPtr &, const WhyPtr &definition);
 
 		/** Finds a spill stack location for a variable. */
 		size_t getSpill(const VregPtr &, bool create = false, bool *created = nullptr);
@@ -124,7 +199,7 @@ class Function: public Makeable<Function> {
 		bool canSpill(const VregPtr &);
 
 		std::set<std::shared_ptr<BasicBlock>> getLive(const VregPtr &,
-			const std::function<std::set<VregPtr> &(const std::shared_ptr<BasicBlock> &)> &) const;
+			const std::function<const Bitset &(const std::shared_ptr<BasicBlock> &)> &) const;
 
 		/** Returns a set of all blocks where a given variable or any of its aliases are live-in. */
 		std::set<std::shared_ptr<BasicBlock>> getLiveIn(const VregPtr &) const;
@@ -132,31 +207,58 @@ class Function: public Makeable<Function> {
 		/** Returns a set of all blocks where a given variable or any of its aliases are live-out. */
 		std::set<std::shared_ptr<BasicBlock>> getLiveOut(const VregPtr &) const;
 
-		/** Resets the readingBlocks and writingBlocks fields of all virtual registers used in the function. */
+		/** Rebuilds the table of instructions and blocks that read and write each of the function's vregs. */
 		void updateVregs();
 
 		/** Returns a pointer to the instruction following a given instruction. */
 		WhyPtr after(const WhyPtr &);
 
-		/** Inserts one instruction after another. Returns the inserted instruction. */
-		WhyPtr insertAfter(const WhyPtr &base, WhyPtr new_instruction, bool reindex = true);
+		/** Inserts one instruction after another. Returns the inserted instruction. Takes constant time; instruction
+		 *  indices are renumbered lazily by getIndex(). */
+		WhyPtr insertAfter(const WhyPtr &base, WhyPtr new_instruction);
 
-		/** Inserts one instruction before another. Returns the inserted instruction. */
-		WhyPtr insertBefore(const WhyPtr &base, WhyPtr new_instruction, bool reindex = true, bool linear_warn = true,
+		/** Inserts one instruction before another. Returns the inserted instruction. Takes constant time; instruction
+		 *  indices are renumbered lazily by getIndex(). */
+		WhyPtr insertBefore(const WhyPtr &base, WhyPtr new_instruction, bool linear_warn = true,
 			bool *should_relinearize_out = nullptr);
 
+		/** Removes an instruction from the function and from its parent block. */
+		void remove(const WhyPtr &);
+
+		/** Returns the position of an instruction in the function, renumbering every instruction first if anything was
+		 *  inserted or removed since the last time. */
+		int getIndex(const WhyPtr &);
+
+		/** Returns the number of instructions that aren't labels or comments. */
+		size_t instructionCount() const;
+
+		/** Returns the number of register moves. */
+		size_t moveCount() const;
+
+		/** Deletes moves whose source and destination are the same register with the same type. Returns the number of
+		 *  moves deleted. */
+		int removeRedundantMoves();
+
 		bool isBuiltin() const { return !name.empty() && (name == ".init" || name.front() == '`'); }
 
+		/** Allocates an instruction in the function's arena without inserting it anywhere. */
+		template <typename T, typename... Args>
+		std::shared_ptr<T> newInstruction(Args &&...args) {
+			return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(&arena), std::forward<Args>(args)...);
+		}
+
 		template <typename T, typename... Args>
 		std::shared_ptr<T> add(Args &&...args) {
-			return std::dynamic_pointer_cast<T>(instructions.emplace_back(
-				std::make_shared<T>(std::forward<Args>(args)...)));
+			auto out = newInstruction<T>(std::forward<Args>(args)...);
+			out->functionPosition = instructions.insert(instructions.end(), out);
+			return out;
 		}
 
 		template <typename T, typename... Args>
 		std::shared_ptr<T> addFront(Args &&...args) {
-			return std::dynamic_pointer_cast<T>(instructions.emplace_front(
-				std::make_shared<T>(std::forward<Args>(args)...)));
+			auto out = newInstruction<T>(std::forward<Args>(args)...);
+			out->functionPosition = instructions.insert(instructions.begin(), out);
+			return out;
 		}
 
 		void addComment(const std::string &);
@@ -170,8 +272,19 @@ class Function: public Makeable<Function> {
 
 		void debug() const;
 
+		/** Rebuilds the CFG from the blocks' predecessors. This has to be called whenever blocks are added, removed or
+		 *  relinked, which also drops the cached dominator trees and loops. */
 		Graph & makeCFG();
 
+		/** Returns the dominator tree of the CFG, rooted at the first block. */
+		const DominatorTree & dominators();
+
+		/** Returns the post-dominator tree of the CFG's nodes that are reachable from the first block. */
+		const DominatorTree & postDominators();
+
+		/** Returns the CFG's loop nesting forest. */
+		const LoopForest & loops();
+
 		bool isNaked() const;
 		bool isSaved() const;
 
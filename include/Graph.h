@@ -8,6 +8,8 @@
 #include <vector>
 
 #include "DFSResult.h"
+#include "DominatorTree.h"
+#include "LoopForest.h"
 #include "Node.h"
 
 class Graph {
@@ -141,11 +143,20 @@ class Graph {
 		/** Returns a set of nodes connected to a node. */
 		std::unordered_set<Node *> undirectedSearch(const Label &) const;
 
-		/** Returns a postorder list of nodes. */
+		/** Returns a postorder list of the nodes reachable from a node. */
 		std::vector<Node *> postOrder(Node &) const;
 		/** Returns a reverse-postorder list of nodes. */
 		std::vector<Node *> reversePostOrder(Node &) const;
 
+		/** Returns the dominator tree of the nodes reachable from an entry node. */
+		DominatorTree dominatorTree(Node &entry) const;
+
+		/** Returns the post-dominator tree of the nodes reachable from an entry node. */
+		DominatorTree postDominatorTree(Node &entry) const;
+
+		/** Returns the natural loops among the nodes reachable from an entry node. */
+		LoopForest loops(Node &entry) const;
+
 		/** Finds all bridges in the graph. Assumes the graph is connected. */
 		std::vector<std::pair<Label, Label>> bridges() const;
 
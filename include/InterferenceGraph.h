@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Variable.h"
+
+/** An undirected interference graph over densely numbered vregs. Edges are stored twice: in a lower-triangular bit
+ *  matrix for constant-time membership tests and in per-node adjacency vectors for iterating over neighbors. */
+class InterferenceGraph {
+	private:
+		std::vector<VregPtr> vregs;
+		/** Maps vreg IDs to node indices, or -1 for vregs that aren't in the graph. */
+		std::vector<int> indices;
+		std::vector<uint64_t> matrix;
+		std::vector<std::vector<size_t>> adjacency;
+		std::vector<int> colors;
+		/** Maps each node to the node it was coalesced into, or to itself if it hasn't been coalesced. */
+		std::vector<size_t> aliases;
+		size_t edgeCount = 0;
+
+		static size_t bitIndex(size_t left, size_t right);
+
+	public:
+		InterferenceGraph() = default;
+
+		/** Removes all nodes and edges and prepares for vreg IDs below the given bound. */
+		void clear(size_t id_bound = 0);
+
+		/** Adds a vreg as a node if it isn't already in the graph. Returns its node index. */
+		size_t add(const VregPtr &);
+
+		/** Returns whether the vreg with a given ID has a node in the graph. */
+		bool contains(int id) const;
+
+		/** Returns the node index of the vreg with a given ID. */
+		size_t indexOf(int id) const;
+
+		/** Adds an edge between two nodes. Self-edges and duplicate edges are ignored. Returns whether an edge was
+		 *  added. */
+		bool link(size_t left, size_t right);
+
+		bool interferes(size_t left, size_t right) const;
+
+		/** Returns whether coalescing two non-interfering nodes is conservative with the given number of colors: either
+		 *  the merged node would have fewer than that many neighbors of significant degree (Briggs), or every neighbor
+		 *  of one node already interferes with the other or has insignificant degree (George). */
+		bool canCoalesce(size_t left, size_t right, size_t color_count) const;
+
+		/** Coalesces one node into another: the removed node's edges are moved to the kept node, and the removed node
+		 *  takes the kept node's color from then on. Both indices must be representatives (see find()). */
+		void merge(size_t kept, size_t removed);
+
+		/** Returns the node that a node has been coalesced into, following chains of merges. */
+		size_t find(size_t index);
+
+		bool isMerged(size_t index) const { return aliases[index] != index; }
+
+		size_t size() const { return vregs.size(); }
+		size_t edges() const { return edgeCount; }
+		size_t degree(size_t index) const { return adjacency[index].size(); }
+		const std::vector<size_t> & neighbors(size_t index) const { return adjacency[index]; }
+		const VregPtr & vreg(size_t index) const { return vregs[index]; }
+		int color(size_t index) const { return colors[index]; }
+
+		/** Colors the graph with Chaitin-Briggs simplify/select using colors in [color_min, color_max]. When no node of
+		 *  insignificant degree is left, the node with the lowest cost per neighbor is removed as a potential spill and
+		 *  colored optimistically. Coalesced nodes take the color of the node they were merged into. Returns the indices
+		 *  of the nodes that couldn't be colored, which are left at -1. */
+		std::vector<size_t> colorOptimistic(int color_min, int color_max, const std::vector<double> &costs);
+};
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <cstdio>
-#include <unordered_map>
+#include <string>
 #include <vector>
 
 #include "ASTNode.h"
@@ -12,6 +12,10 @@ using CPMSTYPE = ASTNode *;
 #define WASMSTYPE_IS_DECLARED
 using WASMSTYPE = ASTNode *;
 
+using yyscan_t = void *;
+
+class Parser;
+
 #ifndef NO_YYPARSE
 #include "bison.h"
 #include "wasmbison.h"
@@ -23,44 +27,36 @@ using yysize = size_t;
 using yysize = int;
 #endif
 
-extern FILE *cpmin, *wasmin;
-extern char *cpmtext, *wasmtext;
-extern yysize cpmleng, wasmleng;
-extern int cpm_flex_debug, wasm_flex_debug;
-
-class Parser;
-
 class Lexer {
 	private:
 		Parser *parser;
-		yysize *leng;
-		ASTNode **lval;
 
 	public:
 		ASTLocation location {0, 1};
-		std::string line;
 		yysize lastYylength = 0;
-		std::unordered_map<int, std::string> lines;
 		bool failed = false;
 		std::vector<std::pair<std::string, ASTLocation>> errors;
 
-		Lexer(Parser &, yysize &, ASTNode *&);
+		explicit Lexer(Parser &);
 		const std::string * filename(int fileno);
-		void advance(const char *);
+		void advance(const char *, yysize length);
 		void newline();
 		void badchar(unsigned char);
-		int token(const char *, int symbol);
+		int token(const char *, int symbol, ASTNode *&lval);
 };
 
-extern Lexer cpmLexer, wasmLexer;
-
-int cpmlex();
-int cpmlex_destroy();
-void cpmerror(const std::string &);
-void cpmerror(const std::string &, const ASTLocation &);
-
-int wasmlex();
-int wasmlex_destroy();
-void wasmerror(const char *);
+int cpmlex(CPMSTYPE *, yyscan_t);
+int cpmlex_init_extra(Parser *, yyscan_t *);
+int cpmlex_destroy(yyscan_t);
+void cpmset_in(FILE *, yyscan_t);
+void cpmset_debug(int, yyscan_t);
+void cpmerror(yyscan_t, Parser &, const std::string &);
+
+int wasmlex(WASMSTYPE *, yyscan_t);
+int wasmlex_init_extra(Parser *, yyscan_t *);
+int wasmlex_destroy(yyscan_t);
+void wasmset_in(FILE *, yyscan_t);
+void wasmset_debug(int, yyscan_t);
+void wasmerror(yyscan_t, Parser &, const std::string &);
+/** Reports an error to the WASM parser that's currently running on this thread. */
 void wasmerror(const std::string &);
-void wasmerror(const std::string &, const ASTLocation &);
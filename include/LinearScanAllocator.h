@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "Allocator.h"
+#include "Variable.h"
+
+/** Assigns registers by scanning live intervals in order of their starting instruction, in the style of Poletto and
+ *  Sarkar. It's much cheaper than graph coloring for very large functions at the cost of somewhat worse allocations. */
+class LinearScanAllocator: public Allocator {
+	public:
+		/** A vreg's live range as a single span of instruction positions, without holes. */
+		struct Interval {
+			VregPtr vreg;
+			size_t start = 0;
+			size_t end = 0;
+			/** Whether the first position is only a write and the last position only a read. An interval that ends with a
+			 *  read can share a register with one that starts with a write at the same position. */
+			bool startsWithWrite = false, endsWithRead = false;
+			int reg = -1;
+		};
+
+	private:
+		std::set<int> triedIDs;
+
+		/** Computes the live interval of every unallocated vreg over the function's blocks in layout order. */
+		std::vector<Interval> makeIntervals() const;
+
+		/** Returns whether a vreg can be chosen as a spill victim. The cheap checks come before Function::canSpill(). */
+		bool isSpillable(const VregPtr &);
+
+	public:
+		/** Functions with more instructions or vregs than these use linear scan when the allocator choice is Auto. */
+		constexpr static size_t instructionThreshold = 10'000, vregThreshold = 4'000;
+
+		explicit LinearScanAllocator(Function &function_): Allocator(function_) {}
+
+		/** Returns whether a function is large enough that Auto should choose linear scan for it. */
+		static bool prefers(const Function &);
+
+		/** Makes an attempt to allocate registers. When no register is free at the start of an interval, the interval
+		 *  that ends furthest away is spilled. All spills from one scan are done at once; if there were any, it
+		 *  returns Spilled, or NotSpilled if none of them inserted any code. Otherwise, it returns Success. */
+		Result attempt() override;
+};
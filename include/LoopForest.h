@@ -0,0 +1,58 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+class DominatorTree;
+class Node;
+
+/** The natural loops of a graph, arranged into a tree by nesting. Every back edge (an edge to a node that dominates its
+ *  source) defines a natural loop, and back edges to the same header are merged into one loop. Cycles that aren't
+ *  entered through a single dominating header (irreducible control flow) aren't loops. */
+class LoopForest {
+	public:
+		static constexpr size_t NONE = SIZE_MAX;
+
+		struct Loop {
+			Node *header;
+			/** The index of the innermost loop this one is nested in, or NONE for outermost loops. */
+			size_t parent = NONE;
+			/** 1 for outermost loops. */
+			size_t depth = 1;
+			/** The nodes in the loop that aren't in any loop nested in it. The header comes first. */
+			std::vector<Node *> nodes;
+			/** The indices of the loops directly nested in this one. */
+			std::vector<size_t> children;
+			/** The sources of the loop's back edges. */
+			std::vector<Node *> latches;
+
+			explicit Loop(Node *header_): header(header_) {}
+		};
+
+	private:
+		/** Inner loops come before the loops they're nested in. */
+		std::vector<Loop> loopList;
+		/** Maps nodes to the index of the innermost loop containing them. */
+		std::unordered_map<const Node *, size_t> innermostLoops;
+
+	public:
+		/** Finds the loops of the graph whose dominator tree is given. The tree mustn't be a post-dominator tree. */
+		explicit LoopForest(const DominatorTree &);
+
+		const std::vector<Loop> & loops() const { return loopList; }
+
+		/** Returns the innermost loop containing a node, or nullptr if it's not in any loop. */
+		const Loop * innermost(const Node &) const;
+
+		/** Returns the number of loops containing a node, which is 0 for nodes outside every loop. */
+		size_t depth(const Node &) const;
+
+		/** Returns whether a node is the header of a loop. */
+		bool isHeader(const Node &) const;
+
+		/** Returns whether a node is in a loop or any loop nested in it. */
+		bool contains(const Loop &, const Node &) const;
+
+		/** Returns every node in a loop, including those in nested loops, with the header first. */
+		std::vector<Node *> allNodes(const Loop &) const;
+};
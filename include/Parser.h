@@ -2,15 +2,24 @@
 
 #include <cstdio>
 #include <string>
+#include <string_view>
 
 #include "ASTNode.h"
+#include "Lexer.h"
 
 using YY_BUFFER_STATE = struct yy_buffer_state *;
 
+/** Owns a reentrant flex scanner and drives a pure bison parser over it. Separate instances don't share any state, so
+ *  several inputs can be parsed at once as long as each instance stays on one thread at a time. */
 class Parser {
 	private:
 		std::string filename;
 		char *buffer = nullptr;
+		/** The length of the input in the buffer, not counting the null terminators after it. */
+		size_t bufferSize = 0;
+		/** The length of the mapping if the buffer was mapped by map(), or zero if it was allocated by in(). */
+		size_t mappedSize = 0;
+		yyscan_t scanner = nullptr;
 		YY_BUFFER_STATE bufferState = nullptr;
 
 	public:
@@ -19,18 +28,35 @@ class Parser {
 		ASTNode *root = nullptr;
 		int errorCount = 0;
 		Type type;
+		Lexer lexer;
+
+		explicit Parser(Type type_);
+		Parser(const Parser &) = delete;
+		Parser(Parser &&) = delete;
+		Parser & operator=(const Parser &) = delete;
+		Parser & operator=(Parser &&) = delete;
+		~Parser();
 
-		explicit Parser(Type type_): type(type_) {}
 		void open(const std::string &filename);
 		void in(const std::string &text);
+		/** Maps a file into memory and scans it in place. The mapping is private and padded with the two null
+		 *  terminators flex needs, so the file isn't copied and flex's temporary writes never reach it. Falls back to
+		 *  reading the file into a buffer if it can't be mapped. */
+		void map(const std::string &path);
 		void debug(bool flex, bool bison) const;
-		void parse() const;
+		void parse();
 		void done();
+		void error(const std::string &message);
+		void error(const std::string &message, const ASTLocation &);
 
 		const char * getNameCPM(int symbol);
 		const char * getNameWASM(int symbol);
 		const char * getName(int symbol);
-		[[nodiscard]] std::string getBuffer() const;
-};
+		/** Returns the text of a zero-based line of the input, found by scanning the buffer. Meant for error messages
+		 *  only. Returns an empty view if there's no such line. */
+		[[nodiscard]] std::string_view getLine(size_t) const;
 
-extern Parser cpmParser, wasmParser;
+		/** Returns the parser whose parse() is running on the calling thread. AST nodes that aren't handed a parser
+		 *  explicitly (the WASM nodes, for instance) attach themselves to it. */
+		static Parser & current();
+};
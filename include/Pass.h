@@ -0,0 +1,24 @@
+#pragma once
+
+class Function;
+class SSA;
+
+/** An optimization pass over a function in SSA form. Function::optimize() makes a new instance for each function it
+ *  runs the pass on, so passes can keep per-function state even though functions are finalized concurrently. */
+class Pass {
+	protected:
+		Function &function;
+		SSA &ssa;
+
+	public:
+		Pass(Function &function_, SSA &ssa_): function(function_), ssa(ssa_) {}
+		Pass(const Pass &) = delete;
+		Pass(Pass &&) = delete;
+		Pass & operator=(const Pass &) = delete;
+		Pass & operator=(Pass &&) = delete;
+		virtual ~Pass() = default;
+
+		/** Runs the pass. Returns whether the function changed. Passes must leave the vreg table up to date and keep
+		 *  phis at the start of their blocks with one incoming value per predecessor. */
+		virtual bool run() = 0;
+};
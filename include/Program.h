@@ -1,36 +1,57 @@
 #pragma once
 
 #include <map>
-#include <set>
+#include <ostream>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "Allocator.h"
 #include "Function.h"
 #include "Global.h"
 #include "Signature.h"
 
 class ASTNode;
 class StructType;
+class Writer;
 
+/** Tables keyed by identifiers use the pointers returned by StringSet::intern. The lexer interns every identifier
+ *  already, so a lookup hashes and compares a pointer instead of a string. */
 struct Program {
-	std::map<std::string, GlobalPtr> globals;
-	std::vector<decltype(globals)::iterator> globalOrder;
-	std::map<std::string, Signature> signatures;
-	/** Maps mangled names to functions. */
+	std::unordered_map<const std::string *, GlobalPtr> globals;
+	/** Points to the entries of globals in declaration order. Unlike iterators, pointers survive rehashing. */
+	std::vector<decltype(globals)::value_type *> globalOrder;
+	std::unordered_map<std::string, Signature> signatures;
+	/** Maps mangled names to functions. This stays ordered because functions are emitted in this order. */
 	std::map<std::string, FunctionPtr> functions;
 	/** Maps mangled names to function declarations. */
-	std::map<std::string, FunctionPtr> functionDeclarations;
-	/** Maps unmangled names to functions. */
-	std::multimap<std::string, FunctionPtr> bareFunctions;
-	/** Maps unmangled names to function declarations. */
-	std::multimap<std::string, FunctionPtr> bareFunctionDeclarations;
-	std::multimap<int, FunctionPtr> operators;
+	std::unordered_map<std::string, FunctionPtr> functionDeclarations;
+	/** Maps unmangled names to functions in declaration order. */
+	std::unordered_map<const std::string *, std::vector<FunctionPtr>> bareFunctions;
+	/** Maps unmangled names to function declarations in declaration order. */
+	std::unordered_map<const std::string *, std::vector<FunctionPtr>> bareFunctionDeclarations;
+	/** Maps operator tokens and argument counts to operator overloads in declaration order. */
+	std::map<std::pair<int, size_t>, std::vector<FunctionPtr>> operators;
+	/** Caches the candidates found by function lookups and operator resolution, keyed by the kind of lookup, the name
+	 *  or operator, the struct name and the types involved. Lookups only happen once every function has been
+	 *  registered, but compile() clears the caches anyway. */
+	std::unordered_map<std::string, std::vector<FunctionPtr>> lookupCache;
+	mutable std::unordered_map<std::string, std::vector<FunctionPtr>> operatorCache;
+	/** Incremented whenever a scope of this program is created or gains a variable. Anything derived from name lookups,
+	 *  such as the types memoized by Expr::getType, stays valid for as long as this doesn't change. */
+	size_t scopeGeneration = 0;
 	std::map<std::string, size_t> stringIDs;
-	std::vector<std::string> lines;
 	std::string name, author, orcid, version;
-	std::set<std::string> forwardDeclarations;
-	std::map<std::string, std::shared_ptr<StructType>> structs;
+	std::unordered_set<const std::string *> forwardDeclarations;
+	std::unordered_map<const std::string *, std::shared_ptr<StructType>> structs;
 	std::string filename;
+	InterferenceMode interferenceMode = InterferenceMode::Precise;
+	AllocatorChoice allocatorChoice = AllocatorChoice::Auto;
+	/** Whether functions are put into SSA form and optimized before register allocation. */
+	bool optimize = true;
+	/** Whether compile() should print each function's spill and instruction counts to stderr. */
+	bool allocationReport = false;
 
 	Program() = delete;
 
@@ -41,10 +62,15 @@ struct Program {
 		globals(std::move(globals_)), globalOrder(std::move(global_order)), signatures(std::move(signatures_)),
 		functions(std::move(functions_)), filename(std::move(filename_)) {}
 
-	void compile();
+	/** Compiles all functions and streams the output to a writer. Functions are lowered in order and then finalized on
+	 *  up to the given number of worker threads; the output doesn't depend on the number of jobs. Nothing is written if
+	 *  compilation fails. */
+	void compile(Writer &, size_t jobs = 1);
+	/** Writes per-function statistics from the last compile() as JSON. Builtins other than .init are left out. */
+	void writeStats(std::ostream &) const;
 	size_t getStringID(const std::string &);
 
-	[[nodiscard]] FunctionPtr getOperator(const std::vector<Type *> &, int, const ASTLocation & = {}) const;
+	[[nodiscard]] FunctionPtr getOperator(const std::vector<const Type *> &, int, const ASTLocation & = {}) const;
 };
 
 Program compileRoot(const ASTNode &, const std::string &filename);
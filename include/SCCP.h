@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Pass.h"
+#include "Variable.h"
+
+struct BasicBlock;
+struct WhyInstruction;
+
+/** Sparse conditional constant propagation (Wegman and Zadeck). Finds the vregs that hold the same constant whenever
+ *  they're read, assuming that only the CFG edges shown to be taken are, and then replaces their definitions with
+ *  immediates, turns conditional jumps on constants into unconditional jumps or removes them and deletes the blocks
+ *  that can't be reached. A constant is the value a vreg holds as seen through its operand type, and arithmetic is only
+ *  folded when its exact result fits every operand type involved, so wrapping and truncation never need to be
+ *  modeled. */
+class SCCP: public Pass {
+	public:
+		/** Wide enough for both signed and unsigned 64-bit values. */
+		using Wide = __int128;
+
+		struct Value {
+			enum class Kind: uint8_t {Top, Constant, Bottom};
+			Kind kind = Kind::Top;
+			Wide constant = 0;
+
+			static Value top() { return {}; }
+			static Value bottom() { return {Kind::Bottom, 0}; }
+			static Value of(Wide constant_) { return {Kind::Constant, constant_}; }
+
+			bool isTop() const { return kind == Kind::Top; }
+			bool isConstant() const { return kind == Kind::Constant; }
+			bool isBottom() const { return kind == Kind::Bottom; }
+		};
+
+	private:
+		static constexpr size_t NONE = SIZE_MAX;
+
+		/** Indexed by vreg ID. */
+		std::vector<Value> values;
+		std::vector<std::shared_ptr<BasicBlock>> order;
+		std::unordered_map<const BasicBlock *, size_t> blockIndices;
+		std::unordered_map<std::string, size_t> labelIndices;
+		std::vector<bool> executable;
+		std::set<std::pair<size_t, size_t>> executableEdges;
+		std::vector<std::pair<size_t, size_t>> edgeWork;
+		std::vector<WhyInstruction *> instructionWork;
+
+		Value valueOf(const VregPtr &) const;
+
+		/** Moves a vreg down the lattice and queues the instructions that read it. */
+		void lower(const VregPtr &, Value);
+
+		void markEdge(size_t from, size_t to);
+
+		/** Reevaluates an instruction in an executable block. */
+		void visit(WhyInstruction &);
+
+		/** Marks the edges out of a block that can be taken. */
+		void visitBranch(size_t block_index);
+
+		/** Returns the value an instruction writes to its only destination. */
+		Value evaluate(WhyInstruction &);
+
+		void solve();
+
+		/** Applies the results. Returns whether anything changed. */
+		bool rewrite();
+
+	public:
+		using Pass::Pass;
+
+		bool run() override;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+class Function;
+struct BasicBlock;
+struct VirtualRegister;
+struct WhyInstruction;
+
+/** Converts a function's vregs to static single assignment form and back. construct() inserts phis at the iterated
+ *  dominance frontiers of each multiply defined vreg wherever it's live and renames every definition to a fresh
+ *  version; destruct() replaces the phis with copies and merges the versions of each vreg back together wherever
+ *  that's still possible. Optimization passes (see Pass) run in between. Precolored vregs and vregs used by
+ *  instructions that can't have their operands replaced keep their names and may still have several definitions. */
+class SSA {
+	private:
+		Function &function;
+		bool active = false;
+		/** The value of the function's nextVariable before construction. */
+		int firstVersion = 0;
+		/** Maps vreg IDs to the IDs of the vregs they're versions of. Vregs that weren't renamed map to themselves, or
+		 *  to -1 if they're not part of the function. */
+		std::vector<int> originals;
+		/** Whether each vreg ID belongs to a vreg that was renamed. */
+		std::vector<bool> renamed;
+
+		/** Returns whether every instruction that reads or writes a vreg can have it replaced. */
+		bool canRename(const VirtualRegister &) const;
+
+		/** Places phis for the renamed vregs. */
+		void insertPhis(const std::vector<std::vector<size_t>> &frontiers,
+		                const std::vector<std::shared_ptr<BasicBlock>> &order);
+
+		/** Renames definitions and uses in dominator tree preorder. */
+		void rename(const std::vector<std::vector<size_t>> &children,
+		            const std::vector<std::shared_ptr<BasicBlock>> &order);
+
+		/** Merges each vreg's versions back into it unless two of them are live at the same time with different
+		 *  values. */
+		void coalesce(const std::vector<std::shared_ptr<WhyInstruction>> &copies);
+
+		/** Undoes construct() for a function that hasn't changed since. */
+		void restore();
+
+	public:
+		explicit SSA(Function &);
+		SSA(const SSA &) = delete;
+		SSA & operator=(const SSA &) = delete;
+
+		/** Puts the function into SSA form. Requires extracted blocks, an up-to-date CFG, vreg table and liveness.
+		 *  Returns false and leaves the function alone if its control flow can't be followed, such as when it branches
+		 *  on flags or to a register. The vreg table is up to date afterwards; liveness isn't. */
+		bool construct();
+
+		/** Takes the function out of SSA form. If nothing changed since construct(), the phis are dropped and the
+		 *  original names are put back without any copies. Recomputes the vreg table and liveness. */
+		void destruct(bool changed = true);
+
+		bool isActive() const { return active; }
+
+		/** Returns the ID of the vreg a version was made from, or the ID itself for vregs that weren't renamed. */
+		int getOriginal(int id) const;
+};
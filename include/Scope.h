@@ -3,6 +3,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "ASTNode.h"
@@ -29,23 +30,24 @@ struct Scope: Checkable, std::enable_shared_from_this<Scope> {
 		Scope & operator=(Scope &&) = delete;
 		~Scope() override = default;
 
-		virtual VariablePtr lookup(const std::string &) const = 0;
+		/** Names passed to the lookup functions and to doesConflict must be interned with StringSet::intern. */
+		virtual VariablePtr lookup(const std::string *) const = 0;
 
-		virtual Functions lookupFunctions(const std::string &function_name, const TypePtr &, const Types &,
+		virtual Functions lookupFunctions(const std::string *function_name, const TypePtr &, const Types &,
 			const std::string &struct_name) const { (void) function_name; (void) struct_name; return {}; }
-		FunctionPtr lookupFunction(const std::string &function_name, const TypePtr &, const Types &,
+		FunctionPtr lookupFunction(const std::string *function_name, const TypePtr &, const Types &,
 			const std::string &struct_name, const ASTLocation & = {}) const;
 
-		virtual Functions lookupFunctions(const std::string &function_name, const Types &,
+		virtual Functions lookupFunctions(const std::string *function_name, const Types &,
 			const std::string &struct_name) const { (void) function_name; (void) struct_name; return {}; }
-		FunctionPtr lookupFunction(const std::string &function_name, const Types &, const std::string &struct_name,
+		FunctionPtr lookupFunction(const std::string *function_name, const Types &, const std::string &struct_name,
 			const ASTLocation & = {}) const;
 
-		virtual Functions lookupFunctions(const std::string &) const { return {}; }
-		FunctionPtr lookupFunction(const std::string &, const ASTLocation & = {}) const;
+		virtual Functions lookupFunctions(const std::string *) const { return {}; }
+		FunctionPtr lookupFunction(const std::string *, const ASTLocation & = {}) const;
 
-		virtual TypePtr lookupType(const std::string &) const { return nullptr; }
-		virtual bool doesConflict(const std::string &) const = 0;
+		virtual TypePtr lookupType(const std::string *) const { return nullptr; }
+		virtual bool doesConflict(const std::string *) const = 0;
 		/** Returns whether the insertion was successful. Insertion can fail due to conflicts. */
 		virtual bool insert(VariablePtr) = 0;
 		Scope & setProgram(Program &program_) { program = &program_; return *this; }
@@ -74,20 +76,21 @@ struct Scope: Checkable, std::enable_shared_from_this<Scope> {
 		}
 
 	protected:
-		explicit Scope(Program *program_ = nullptr): program(program_) {}
+		/** Bumps the program's scope generation, as does inserting a variable. */
+		explicit Scope(Program *program_ = nullptr);
 } __attribute__((packed));
 
 using ScopePtr = std::shared_ptr<Scope>;
 
 struct GlobalScope: Scope, Makeable<GlobalScope> {
 	Program &program;
-	explicit GlobalScope(Program &program_): program(program_) {}
-	VariablePtr lookup(const std::string &) const override;
-	Functions lookupFunctions(const std::string &, const TypePtr &, const Types &, const std::string &) const override;
-	Functions lookupFunctions(const std::string &, const Types &, const std::string &) const override;
-	Functions lookupFunctions(const std::string &) const override;
-	TypePtr lookupType(const std::string &) const override;
-	bool doesConflict(const std::string &) const override;
+	explicit GlobalScope(Program &program_): Scope(&program_), program(program_) {}
+	VariablePtr lookup(const std::string *) const override;
+	Functions lookupFunctions(const std::string *, const TypePtr &, const Types &, const std::string &) const override;
+	Functions lookupFunctions(const std::string *, const Types &, const std::string &) const override;
+	Functions lookupFunctions(const std::string *) const override;
+	TypePtr lookupType(const std::string *) const override;
+	bool doesConflict(const std::string *) const override;
 	bool insert(VariablePtr) override;
 	std::string partialStringify() const override { return "global"; }
 } __attribute__((packed));
@@ -96,12 +99,12 @@ struct FunctionScope: Scope, Makeable<FunctionScope> {
 	Function &function;
 	std::shared_ptr<GlobalScope> parent;
 	explicit FunctionScope(Function &function_, const std::shared_ptr<GlobalScope> &parent_);
-	VariablePtr lookup(const std::string &) const override;
-	Functions lookupFunctions(const std::string &, const TypePtr &, const Types &, const std::string &) const override;
-	Functions lookupFunctions(const std::string &, const Types &, const std::string &) const override;
-	Functions lookupFunctions(const std::string &) const override;
-	TypePtr lookupType(const std::string &) const override;
-	bool doesConflict(const std::string &) const override;
+	VariablePtr lookup(const std::string *) const override;
+	Functions lookupFunctions(const std::string *, const TypePtr &, const Types &, const std::string &) const override;
+	Functions lookupFunctions(const std::string *, const Types &, const std::string &) const override;
+	Functions lookupFunctions(const std::string *) const override;
+	TypePtr lookupType(const std::string *) const override;
+	bool doesConflict(const std::string *) const override;
 	bool insert(VariablePtr) override;
 	std::string partialStringify() const override;
 	Function & getFunction() const override { return function; }
@@ -109,17 +112,18 @@ struct FunctionScope: Scope, Makeable<FunctionScope> {
 };
 
 struct BlockScope: Scope, Makeable<BlockScope> {
-	std::map<std::string, VariablePtr> variables;
+	std::unordered_map<const std::string *, VariablePtr> variables;
 	std::vector<VariablePtr> variableOrder;
 	ScopePtr parent;
 	std::string name;
-	explicit BlockScope(const ScopePtr &parent_, const std::string &name_ = ""): parent(parent_), name(name_) {}
-	VariablePtr lookup(const std::string &) const override;
-	Functions lookupFunctions(const std::string &, const TypePtr &, const Types &, const std::string &) const override;
-	Functions lookupFunctions(const std::string &, const Types &, const std::string &) const override;
-	Functions lookupFunctions(const std::string &) const override;
-	TypePtr lookupType(const std::string &) const override;
-	bool doesConflict(const std::string &) const override;
+	explicit BlockScope(const ScopePtr &parent_, const std::string &name_ = ""):
+		Scope(&parent_->getProgram()), parent(parent_), name(name_) {}
+	VariablePtr lookup(const std::string *) const override;
+	Functions lookupFunctions(const std::string *, const TypePtr &, const Types &, const std::string &) const override;
+	Functions lookupFunctions(const std::string *, const Types &, const std::string &) const override;
+	Functions lookupFunctions(const std::string *) const override;
+	TypePtr lookupType(const std::string *) const override;
+	bool doesConflict(const std::string *) const override;
 	bool insert(VariablePtr) override;
 	Program & getProgram() const override { return parent->getProgram(); }
 	Function & getFunction() const override { return parent->getFunction(); }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <mutex>
 #include <string>
 #include <unordered_set>
 
@@ -7,6 +8,7 @@ struct StringSet {
 	StringSet();
 
 	static std::unordered_set<std::string> set;
+	static std::mutex mutex;
 	static const std::string * intern(const char *);
 	static const std::string * intern(const std::string &);
 };
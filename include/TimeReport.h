@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/** Accumulates wall time, CPU time and allocation counts for each compiler phase when --time-report is given. Phases
+ *  can nest (liveness is also computed during allocation attempts, for instance), so their times needn't add up to the
+ *  total. Timers can run on several threads at once. */
+class TimeReport {
+	public:
+		enum class Phase {Parse, CompileRoot, Lower, ExtractBlocks, Split, Liveness, SSA, Optimize, Allocate,
+		                  ReplacePlaceholders, Emit, Count};
+
+		/** Measures one run of a phase, from construction to destruction. Does nothing unless the report is enabled. */
+		class Timer {
+			private:
+				Phase phase;
+				bool active;
+				std::chrono::steady_clock::time_point wallStart;
+				uint64_t cpuStart = 0, allocationsStart = 0;
+
+			public:
+				explicit Timer(Phase);
+				Timer(const Timer &) = delete;
+				Timer & operator=(const Timer &) = delete;
+				~Timer();
+		};
+
+		static std::atomic_bool enabled;
+
+		/** Prints a table with one row per phase that has run at least once. */
+		static void print(std::ostream &);
+
+	private:
+		struct Totals {
+			std::atomic_uint64_t calls = 0, wallNanoseconds = 0, cpuNanoseconds = 0, allocations = 0;
+		};
+
+		static std::array<Totals, size_t(Phase::Count)> totals;
+
+		static uint64_t threadCPUTime();
+		static const char * getName(Phase);
+};
@@ -1,20 +1,21 @@
 #pragma once
 
+#include <compare>
+#include <concepts>
+#include <cstddef>
 #include <memory>
 #include <ostream>
+#include <set>
 #include <string>
 
 #include "Checkable.h"
 #include "Makeable.h"
-#include "WeakSet.h"
 
 class Function;
-struct BasicBlock;
 struct Scope;
 struct Type;
-struct WhyInstruction;
 
-struct VirtualRegister: Checkable, std::enable_shared_from_this<VirtualRegister> {
+struct VirtualRegister: Checkable {
 	private:
 		int reg = -1;
 
@@ -28,7 +29,8 @@ struct VirtualRegister: Checkable, std::enable_shared_from_this<VirtualRegister>
 
 		explicit VirtualRegister(Function &, const std::shared_ptr<Type> & = nullptr);
 		explicit VirtualRegister(int id_, const std::shared_ptr<Type> & = nullptr);
-		std::shared_ptr<VirtualRegister> init();
+		/** Registers the vreg with its function, if it has one. */
+		VirtualRegister * init();
 
 		VirtualRegister(const VirtualRegister &) = delete;
 		VirtualRegister(VirtualRegister &&) = delete;
@@ -39,9 +41,6 @@ struct VirtualRegister: Checkable, std::enable_shared_from_this<VirtualRegister>
 		std::string regOrID(bool colored = false, bool with_type = true) const;
 		bool special() const;
 
-		WeakSet<BasicBlock> readingBlocks, writingBlocks;
-		WeakSet<WhyInstruction> readers, writers;
-
 		size_t getSize() const;
 		virtual explicit operator std::string() const { return regOrID(true); }
 		VirtualRegister & setReg(int, bool bypass = false);
@@ -62,7 +61,29 @@ struct Variable: VirtualRegister, Makeable<Variable> {
 	VirtualRegister * setType(const Type &type_) override;
 };
 
-using VregPtr = std::shared_ptr<VirtualRegister>;
+/** A non-owning handle to a virtual register. Anonymous vregs are owned by their function and variables by their
+ *  scopes, so instructions can copy their operands without touching a reference count. */
+class VregPtr {
+	private:
+		VirtualRegister *pointer = nullptr;
+
+	public:
+		VregPtr() = default;
+		VregPtr(std::nullptr_t) {}
+		VregPtr(VirtualRegister *pointer_): pointer(pointer_) {}
+
+		template <std::derived_from<VirtualRegister> T>
+		VregPtr(const std::shared_ptr<T> &shared): pointer(shared.get()) {}
+
+		VirtualRegister * get() const { return pointer; }
+		VirtualRegister * operator->() const { return pointer; }
+		VirtualRegister & operator*() const { return *pointer; }
+		explicit operator bool() const { return pointer != nullptr; }
+
+		bool operator==(const VregPtr &) const = default;
+		std::strong_ordering operator<=>(const VregPtr &) const = default;
+};
+
 using VariablePtr = std::shared_ptr<Variable>;
 
 struct VregLess {
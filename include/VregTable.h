@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Variable.h"
+
+struct BasicBlock;
+struct WhyInstruction;
+
+/** Per-function information about vregs, stored as parallel vectors indexed by vreg ID: the vreg itself, the
+ *  instructions that read and write it and the blocks those instructions are in. Instruction and block lists are in
+ *  program order at the time they were built and have no duplicates. */
+class VregTable {
+	private:
+		std::vector<VregPtr> vregs;
+		std::vector<std::vector<WhyInstruction *>> readers, writers;
+		std::vector<std::vector<BasicBlock *>> readingBlocks, writingBlocks;
+
+		void grow(size_t id);
+
+	public:
+		VregTable() = default;
+
+		/** Removes everything and prepares for vreg IDs below the given bound. */
+		void clear(size_t id_bound = 0);
+
+		/** Records a vreg under its ID. */
+		void set(const VregPtr &);
+
+		/** Forgets the recorded vregs and makes room for IDs below the given bound. The def/use lists are kept. */
+		void clearVregs(size_t id_bound);
+
+		/** Returns the vreg with a given ID, or nullptr if there isn't one. */
+		const VregPtr & vreg(size_t id) const;
+
+		void addReader(const VirtualRegister &, WhyInstruction &);
+		void addWriter(const VirtualRegister &, WhyInstruction &);
+		void addReadingBlock(const VirtualRegister &, BasicBlock &);
+		void addWritingBlock(const VirtualRegister &, BasicBlock &);
+
+		/** Removes an instruction from the reader and writer lists of every vreg it uses. */
+		void removeInstruction(WhyInstruction &);
+
+		const std::vector<WhyInstruction *> & getReaders(const VirtualRegister &) const;
+		const std::vector<WhyInstruction *> & getWriters(const VirtualRegister &) const;
+		const std::vector<BasicBlock *> & getReadingBlocks(const VirtualRegister &) const;
+		const std::vector<BasicBlock *> & getWritingBlocks(const VirtualRegister &) const;
+
+		size_t size() const { return vregs.size(); }
+};
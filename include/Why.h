@@ -41,6 +41,7 @@ struct Why {
 	static bool isSpecialPurpose(int);
 	static bool isGeneralPurpose(int);
 	static bool isArgumentRegister(int);
+	static bool isReturnValueRegister(int);
 	static std::string registerName(int);
 	static std::string coloredRegister(int);
 };
@@ -2,6 +2,9 @@
 
 #include <cassert>
 #include <climits>
+#include <concepts>
+#include <list>
+#include <optional>
 
 #include "Checkable.h"
 #include "Enums.h"
@@ -15,20 +18,89 @@ static inline std::string o(const std::string &str) {
 	return " \e[2m" + str + "\e[22m ";
 }
 
+/** One tag per concrete instruction type, so that type tests on concrete types compare tags instead of calling
+ *  dynamic_cast. Only tests on the abstract bases (RType, IType and so on) still need dynamic_cast. */
+enum class WhyOpcode {
+	Move, MultR, BareMultR, MultI, BareMultI, StoreI, StoreR, SetI, LuiI, LoadI, LoadIndirectI, LoadR, CopyR, StackPush,
+	StackPop, StackStore, StackLoad, SizedStackPush, SizedStackPop, Jump, Label, Comment, JumpRegister,
+	JumpRegisterConditional, JumpConditional, Sext, SlR, SleR, SeqR, AddR, SubR, AndR, OrR, XorR, NandR, NorR, XnorR,
+	LandR, LorR, LxorR, LnandR, LnorR, LxnorR, DivR, ModR, ShiftLeftLogicalR, ShiftRightArithmeticR, ShiftRightLogicalR,
+	SneqR, AddI, SubI, AndI, OrI, XorI, NandI, NorI, XnorI, LandI, LorI, LxorI, LnandI, LnorI, LxnorI, DivI, ModI,
+	ShiftLeftLogicalI, ShiftRightArithmeticI, ShiftRightLogicalI, SgR, SgeR, SguR, SgeuR, NotR, LnotR, ComparisonR,
+	ComparisonI, Memset, CompareR, CompareI, Select, DiviI, ShiftLeftLogicalInverseI, ShiftRightLogicalInverseI,
+	ShiftRightArithmeticInverseI, DivuiI, Nop, IntI, RitI, TimeI, RingI, SetptI, IntR, RitR, TimeR, RingR, SvtimeR,
+	SvringR, SvpgR, PrintR, HaltR, RestR, SleepR, PageR, QueryR, PrintPseudoinstruction, IO, Interrupts,
+	TranslateAddressR, PageStack, SetptR, CallPushPlaceholder, CallPopPlaceholder, Phi
+};
+
+struct BasicBlock;
+struct WhyInstruction;
+
+/** Instruction types with a static classof() can be recognized by their opcode without a dynamic_cast. */
+template <typename T>
+concept HasOpcode = requires(const WhyInstruction *instruction) {
+	{ T::classof(instruction) } -> std::same_as<bool>;
+};
+
+/** Gives a concrete instruction type its opcode and the classof() that recognizes it. */
+#define WHY_OPCODE(name) \
+	WhyOpcode getOpcode() const override { return WhyOpcode::name; } \
+	static bool classof(const WhyInstruction *instruction) { return instruction->getOpcode() == WhyOpcode::name; } \
+	static constexpr WhyOpcode opcode = WhyOpcode::name
+
 struct WhyInstruction: Instruction, Checkable, std::enable_shared_from_this<WhyInstruction> {
 	virtual std::vector<VregPtr> getRead() { return {}; }
 	virtual std::vector<VregPtr> getWritten() { return {}; }
 	virtual bool isTerminal() const { return false; }
 	virtual bool enableDebug() const { return true; }
+	/** Returns whether the instruction does anything besides writing its destinations. Instructions that don't can
+	 *  be deleted once nothing reads what they write. */
+	virtual bool hasSideEffects() const { return true; }
+	virtual WhyOpcode getOpcode() const = 0;
+
+	template <typename T>
+	[[nodiscard]] bool is() const {
+		if constexpr (HasOpcode<T>)
+			return T::classof(this);
+		else
+			return Checkable::is<T>();
+	}
+
+	template <typename T>
+	[[nodiscard]] T * cast() {
+		if constexpr (HasOpcode<T>)
+			return T::classof(this)? static_cast<T *>(this) : nullptr;
+		else
+			return Checkable::cast<T>();
+	}
+
+	template <typename T>
+	[[nodiscard]] const T * cast() const {
+		if constexpr (HasOpcode<T>)
+			return T::classof(this)? static_cast<const T *>(this) : nullptr;
+		else
+			return Checkable::cast<T>();
+	}
+
+	using Position = std::list<std::shared_ptr<WhyInstruction>>::iterator;
+	/** Where the instruction is in its function's instruction list and in its parent block's, if it's in them. Kept up
+	 *  to date by Function so that instructions can be found and inserted around in constant time. */
+	std::optional<Position> functionPosition, blockPosition;
 
 	template <typename T>
 	std::shared_ptr<T> ptrcast() {
-		return std::dynamic_pointer_cast<T>(shared_from_this());
+		if constexpr (HasOpcode<T>)
+			return is<T>()? std::static_pointer_cast<T>(shared_from_this()) : nullptr;
+		else
+			return std::dynamic_pointer_cast<T>(shared_from_this());
 	}
 
 	template <typename T>
 	std::shared_ptr<const T> ptrcast() const {
-		return std::dynamic_pointer_cast<const T>(shared_from_this());
+		if constexpr (HasOpcode<T>)
+			return is<T>()? std::static_pointer_cast<const T>(shared_from_this()) : nullptr;
+		else
+			return std::dynamic_pointer_cast<const T>(shared_from_this());
 	}
 
 	/** Attempts to replace a variable read by the instruction with another variable. Should be overridden by any
@@ -200,6 +272,11 @@ struct IType: TwoRegs, HasImmediate {
 };
 
 struct JType: WhyInstruction, HasSource, HasImmediate {
+	static bool classof(const WhyInstruction *instruction) {
+		const WhyOpcode opcode = instruction->getOpcode();
+		return opcode == WhyOpcode::Jump || opcode == WhyOpcode::JumpConditional;
+	}
+
 	bool link;
 
 	explicit JType(TypedImmediate imm_, bool link_ = false, VregPtr source_ = nullptr):
@@ -210,12 +287,31 @@ struct JType: WhyInstruction, HasSource, HasImmediate {
 			return {source};
 		return {};
 	}
+
+	bool replaceRead(const VregPtr &from, const VregPtr &to) override {
+		if (!source || source != from)
+			return false;
+		source = to;
+		return true;
+	}
+
+	bool canReplaceRead(const VregPtr &var) const override {
+		return source && source == var;
+	}
+
+	bool doesRead(const VregPtr &var) const override {
+		return source && source == var;
+	}
 };
 
 struct MoveInstruction: RType {
+	WHY_OPCODE(Move);
+
 	MoveInstruction(VregPtr source_, VregPtr destination_):
 		RType(std::move(source_), nullptr, std::move(destination_)) {}
 
+	bool hasSideEffects() const override { return false; }
+
 	explicit operator std::vector<std::string>() const override {
 		return {leftSource->regOrID() + " -> " + destination->regOrID()};
 	}
@@ -226,7 +322,10 @@ struct MoveInstruction: RType {
 };
 
 struct MultRInstruction: RType {
+	WHY_OPCODE(MultR);
+
 	using RType::RType;
+	bool hasSideEffects() const override { return false; }
 
 	explicit operator std::vector<std::string>() const override;
 
@@ -234,6 +333,8 @@ struct MultRInstruction: RType {
 };
 
 struct BareMultRInstruction: RType {
+	WHY_OPCODE(BareMultR);
+
 	BareMultRInstruction(const VregPtr &rs_, const VregPtr &rt_): RType(rs_, rt_, nullptr) {}
 	explicit operator std::vector<std::string>() const override {
 		return {leftSource->regOrID() + " * " + rightSource->regOrID()};
@@ -244,12 +345,17 @@ struct BareMultRInstruction: RType {
 };
 
 struct MultIInstruction: IType {
+	WHY_OPCODE(MultI);
+
 	using IType::IType;
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override;
 	std::vector<std::string> colored() const override;
 };
 
 struct BareMultIInstruction: IType {
+	WHY_OPCODE(BareMultI);
+
 	BareMultIInstruction(VregPtr rs_, TypedImmediate imm_):
 		IType(std::move(rs_), nullptr, std::move(imm_)) {}
 
@@ -263,6 +369,8 @@ struct BareMultIInstruction: IType {
 };
 
 struct StoreIInstruction: IType {
+	WHY_OPCODE(StoreI);
+
 	StoreIInstruction(VregPtr source_, TypedImmediate imm_):
 		IType(std::move(source_), nullptr, std::move(imm_)) {}
 
@@ -276,6 +384,8 @@ struct StoreIInstruction: IType {
 };
 
 struct StoreRInstruction: RType {
+	WHY_OPCODE(StoreR);
+
 	StoreRInstruction(VregPtr source_, VregPtr address_):
 		RType(std::move(source_), std::move(address_), nullptr) {}
 
@@ -291,9 +401,13 @@ struct StoreRInstruction: RType {
 };
 
 struct SetIInstruction: IType {
+	WHY_OPCODE(SetI);
+
 	SetIInstruction(VregPtr destination_, TypedImmediate imm_):
 		IType(nullptr, std::move(destination_), std::move(imm_)) {}
 
+	bool hasSideEffects() const override { return false; }
+
 	explicit operator std::vector<std::string>() const override {
 		return {stringify(imm) + " -> " + destination->regOrID()};
 	}
@@ -304,9 +418,31 @@ struct SetIInstruction: IType {
 };
 
 struct LuiIInstruction: IType {
+	WHY_OPCODE(LuiI);
+
 	LuiIInstruction(VregPtr destination_, TypedImmediate imm_):
 		IType(nullptr, std::move(destination_), std::move(imm_)) {}
 
+	bool hasSideEffects() const override { return false; }
+
+	// Only the upper half of the destination is replaced, so the lower half written before this is read. The
+	// destination can't be swapped for another vreg on just one side.
+	std::vector<VregPtr> getRead() override {
+		return {destination};
+	}
+
+	bool canReplaceRead(const VregPtr &) const override {
+		return false;
+	}
+
+	bool canReplaceWritten(const VregPtr &) const override {
+		return false;
+	}
+
+	bool doesRead(const VregPtr &var) const override {
+		return destination == var;
+	}
+
 	explicit operator std::vector<std::string>() const override {
 		return {"lui: " + stringify(imm) + " -> " + destination->regOrID()};
 	}
@@ -317,9 +453,13 @@ struct LuiIInstruction: IType {
 };
 
 struct LoadIInstruction: IType {
+	WHY_OPCODE(LoadI);
+
 	LoadIInstruction(VregPtr destination_, TypedImmediate imm_):
 		IType(nullptr, std::move(destination_), std::move(imm_)) {}
 
+	bool hasSideEffects() const override { return false; }
+
 	explicit operator std::vector<std::string>() const override {
 		return {"[" + stringify(imm) + "] -> " + destination->regOrID()};
 	}
@@ -330,6 +470,8 @@ struct LoadIInstruction: IType {
 };
 
 struct LoadIndirectIInstruction: IType {
+	WHY_OPCODE(LoadIndirectI);
+
 	LoadIndirectIInstruction(VregPtr destination_, TypedImmediate imm_):
 		IType(nullptr, std::move(destination_), std::move(imm_)) {}
 
@@ -342,18 +484,54 @@ struct LoadIndirectIInstruction: IType {
 			"\e[2m[\e[22m" + stringify(imm, true) + "\e[2m] -> [\e[22m" + destination->regOrID(true) + "\e[2m]\e[22m"
 		};
 	}
+	// The destination holds an address, so it's read rather than written.
+	std::vector<VregPtr> getRead() override { return {destination}; }
+	std::vector<VregPtr> getWritten() override { return {}; }
+
+	bool replaceRead(const VregPtr &from, const VregPtr &to) override {
+		if (destination != from)
+			return false;
+		destination = to;
+		return true;
+	}
+
+	bool canReplaceRead(const VregPtr &vreg) const override {
+		return doesRead(vreg);
+	}
+
+	bool replaceWritten(const VregPtr &, const VregPtr &) override {
+		return false;
+	}
+
+	bool canReplaceWritten(const VregPtr &) const override {
+		return false;
+	}
+
+	bool doesRead(const VregPtr &vreg) const override {
+		return vreg == destination;
+	}
+
+	bool doesWrite(const VregPtr &) const override {
+		return false;
+	}
 };
 
 struct LoadRInstruction: RType {
+	WHY_OPCODE(LoadR);
+
 	LoadRInstruction(VregPtr source_, VregPtr destination_):
 		RType(std::move(source_), nullptr, std::move(destination_)) {}
 
+	bool hasSideEffects() const override { return false; }
+
 	explicit operator std::vector<std::string>() const override;
 
 	std::vector<std::string> colored() const override;
 };
 
 struct CopyRInstruction: RType {
+	WHY_OPCODE(CopyR);
+
 	CopyRInstruction(VregPtr source_, VregPtr destination_):
 		RType(std::move(source_), nullptr, std::move(destination_)) {}
 
@@ -367,9 +545,47 @@ struct CopyRInstruction: RType {
 				"\e[2m]\e[22m"
 		};
 	}
+	// The destination holds an address, so it's read rather than written.
+	std::vector<VregPtr> getRead() override { return {leftSource, destination}; }
+	std::vector<VregPtr> getWritten() override { return {}; }
+
+	bool replaceRead(const VregPtr &from, const VregPtr &to) override {
+		bool changed = false;
+		if (leftSource == from) {
+			leftSource = to;
+			changed = true;
+		}
+		if (destination == from) {
+			destination = to;
+			changed = true;
+		}
+		return changed;
+	}
+
+	bool canReplaceRead(const VregPtr &vreg) const override {
+		return doesRead(vreg);
+	}
+
+	bool replaceWritten(const VregPtr &, const VregPtr &) override {
+		return false;
+	}
+
+	bool canReplaceWritten(const VregPtr &) const override {
+		return false;
+	}
+
+	bool doesRead(const VregPtr &vreg) const override {
+		return vreg == leftSource || vreg == destination;
+	}
+
+	bool doesWrite(const VregPtr &) const override {
+		return false;
+	}
 };
 
 struct StackPushInstruction: RType {
+	WHY_OPCODE(StackPush);
+
 	explicit StackPushInstruction(const VregPtr &source_): RType(source_, nullptr, nullptr) {}
 	explicit operator std::vector<std::string>() const override {
 		return {"[ " + leftSource->regOrID()};
@@ -380,6 +596,8 @@ struct StackPushInstruction: RType {
 };
 
 struct StackPopInstruction: RType {
+	WHY_OPCODE(StackPop);
+
 	explicit StackPopInstruction(const VregPtr &destination_): RType(nullptr, nullptr, destination_) {}
 	explicit operator std::vector<std::string>() const override {
 		return {"] " + destination->regOrID()};
@@ -390,6 +608,8 @@ struct StackPopInstruction: RType {
 };
 
 struct StackStoreInstruction: RType {
+	WHY_OPCODE(StackStore);
+
 	int offset;
 	StackStoreInstruction(const VregPtr &source_, int offset_): RType(source_, nullptr, nullptr), offset(offset_) {}
 	explicit operator std::vector<std::string>() const override {
@@ -427,11 +647,15 @@ struct StackStoreInstruction: RType {
 };
 
 struct StackLoadInstruction: RType {
+	WHY_OPCODE(StackLoad);
+
 	int offset;
 
 	StackLoadInstruction(const VregPtr &destination_, int offset_):
 		RType(nullptr, nullptr, destination_), offset(offset_) {}
 
+	bool hasSideEffects() const override { return false; }
+
 	explicit operator std::vector<std::string>() const override {
 		if (offset == 0)
 			return {"[$fp] -> " + destination->regOrID()};
@@ -462,6 +686,8 @@ struct StackLoadInstruction: RType {
 };
 
 struct SizedStackPushInstruction: IType {
+	WHY_OPCODE(SizedStackPush);
+
 	SizedStackPushInstruction(const VregPtr &source_, const TypedImmediate &imm_): IType(source_, nullptr, imm_) {}
 	explicit operator std::vector<std::string>() const override {
 		return {"[:" + stringify(imm) + " " + source->regOrID()};
@@ -472,6 +698,8 @@ struct SizedStackPushInstruction: IType {
 };
 
 struct SizedStackPopInstruction: IType {
+	WHY_OPCODE(SizedStackPop);
+
 	SizedStackPopInstruction(const VregPtr &destination_, const TypedImmediate &imm_): IType(nullptr, destination_, imm_) {}
 	explicit operator std::vector<std::string>() const override {
 		return {"]:" + stringify(imm) + " " + destination->regOrID()};
@@ -496,6 +724,8 @@ struct Conditional {
 };
 
 struct JumpInstruction: JType, Conditional {
+	WHY_OPCODE(Jump);
+
 	explicit JumpInstruction(TypedImmediate addr, bool link_ = false, Condition condition_ = Condition::None):
 		JType(std::move(addr), link_), Conditional(condition_) {}
 
@@ -511,6 +741,8 @@ struct JumpInstruction: JType, Conditional {
 };
 
 struct Label: WhyInstruction {
+	WHY_OPCODE(Label);
+
 	std::string name;
 	bool enableDebug() const override { return false; }
 	explicit Label(const std::string &name_): name(name_) {}
@@ -522,7 +754,9 @@ struct Label: WhyInstruction {
 	}
 };
 
-struct Comment: WhyInstruction, Makeable<Comment> {
+struct Comment: WhyInstruction {
+	WHY_OPCODE(Comment);
+
 	std::string comment;
 	explicit Comment(const std::string &comment_): comment(comment_) {}
 	explicit operator std::vector<std::string>() const override {
@@ -534,6 +768,8 @@ struct Comment: WhyInstruction, Makeable<Comment> {
 };
 
 struct JumpRegisterInstruction: RType, Conditional {
+	WHY_OPCODE(JumpRegister);
+
 	bool link;
 	explicit JumpRegisterInstruction(const VregPtr &target, bool link_ = false, Condition condition_ = Condition::None):
 		RType(target, nullptr, nullptr), Conditional(condition_), link(link_) {}
@@ -547,6 +783,8 @@ struct JumpRegisterInstruction: RType, Conditional {
 };
 
 struct JumpRegisterConditionalInstruction: RType {
+	WHY_OPCODE(JumpRegisterConditional);
+
 	bool link;
 
 	JumpRegisterConditionalInstruction(VregPtr target, VregPtr condition, bool link_ = false):
@@ -565,6 +803,8 @@ struct JumpRegisterConditionalInstruction: RType {
 };
 
 struct JumpConditionalInstruction: JType {
+	WHY_OPCODE(JumpConditional);
+
 	JumpConditionalInstruction(TypedImmediate addr, VregPtr condition, bool link_ = false):
 		JType(std::move(addr), link_, std::move(condition)) {}
 
@@ -580,6 +820,8 @@ struct JumpConditionalInstruction: JType {
 };
 
 struct SextInstruction: RType {
+	WHY_OPCODE(Sext);
+
 	public:
 		OperandType destinationType;
 
@@ -589,6 +831,8 @@ struct SextInstruction: RType {
 		SextInstruction(VregPtr source_, VregPtr destination_, int width):
 			RType(std::move(source_), nullptr, std::move(destination_)), destinationType(getType(leftSource, width)) {}
 
+		bool hasSideEffects() const override { return false; }
+
 		explicit operator std::vector<std::string>() const override {
 			return {"sext " + leftSource->regOrID() + " -> " + destination->regOrID(false, false) +
 				std::string(destinationType)};
@@ -607,6 +851,7 @@ struct SextInstruction: RType {
 template <fixstr::fixed_string O>
 struct BinaryRType: RType {
 	using RType::RType;
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override {
 		return {
 			leftSource->regOrID() + " " + std::string(O) + " " + rightSource->regOrID() + " -> " +
@@ -621,31 +866,43 @@ struct BinaryRType: RType {
 	}
 };
 
-struct SlRInstruction:    BinaryRType<"<">   { using BinaryRType::BinaryRType; };
-struct SleRInstruction:   BinaryRType<"<=">  { using BinaryRType::BinaryRType; };
-struct SeqRInstruction:   BinaryRType<"==">  { using BinaryRType::BinaryRType; };
-struct AddRInstruction:   BinaryRType<"+">   { using BinaryRType::BinaryRType; };
-struct SubRInstruction:   BinaryRType<"-">   { using BinaryRType::BinaryRType; };
-struct AndRInstruction:   BinaryRType<"&">   { using BinaryRType::BinaryRType; };
-struct OrRInstruction:    BinaryRType<"|">   { using BinaryRType::BinaryRType; };
-struct XorRInstruction:   BinaryRType<"x">   { using BinaryRType::BinaryRType; };
-struct NandRInstruction:  BinaryRType<"~&">  { using BinaryRType::BinaryRType; };
-struct NorRInstruction:   BinaryRType<"~|">  { using BinaryRType::BinaryRType; };
-struct XnorRInstruction:  BinaryRType<"~x">  { using BinaryRType::BinaryRType; };
-struct LandRInstruction:  BinaryRType<"&&">  { using BinaryRType::BinaryRType; };
-struct LorRInstruction:   BinaryRType<"||">  { using BinaryRType::BinaryRType; };
-struct LxorRInstruction:  BinaryRType<"xx">  { using BinaryRType::BinaryRType; };
-struct LnandRInstruction: BinaryRType<"~&&"> { using BinaryRType::BinaryRType; };
-struct LnorRInstruction:  BinaryRType<"~||"> { using BinaryRType::BinaryRType; };
-struct LxnorRInstruction: BinaryRType<"~xx"> { using BinaryRType::BinaryRType; };
-struct DivRInstruction:   BinaryRType<"/">   { using BinaryRType::BinaryRType; };
-struct ModRInstruction:   BinaryRType<"%">   { using BinaryRType::BinaryRType; };
-struct ShiftLeftLogicalRInstruction:     BinaryRType<"<<">  { using BinaryRType::BinaryRType; };
-struct ShiftRightArithmeticRInstruction: BinaryRType<">>">  { using BinaryRType::BinaryRType; };
-struct ShiftRightLogicalRInstruction:    BinaryRType<">>>"> { using BinaryRType::BinaryRType; };
+struct SlRInstruction:    BinaryRType<"<">   { WHY_OPCODE(SlR); using BinaryRType::BinaryRType; };
+struct SleRInstruction:   BinaryRType<"<=">  { WHY_OPCODE(SleR); using BinaryRType::BinaryRType; };
+struct SeqRInstruction:   BinaryRType<"==">  { WHY_OPCODE(SeqR); using BinaryRType::BinaryRType; };
+struct AddRInstruction:   BinaryRType<"+">   { WHY_OPCODE(AddR); using BinaryRType::BinaryRType; };
+struct SubRInstruction:   BinaryRType<"-">   { WHY_OPCODE(SubR); using BinaryRType::BinaryRType; };
+struct AndRInstruction:   BinaryRType<"&">   { WHY_OPCODE(AndR); using BinaryRType::BinaryRType; };
+struct OrRInstruction:    BinaryRType<"|">   { WHY_OPCODE(OrR); using BinaryRType::BinaryRType; };
+struct XorRInstruction:   BinaryRType<"x">   { WHY_OPCODE(XorR); using BinaryRType::BinaryRType; };
+struct NandRInstruction:  BinaryRType<"~&">  { WHY_OPCODE(NandR); using BinaryRType::BinaryRType; };
+struct NorRInstruction:   BinaryRType<"~|">  { WHY_OPCODE(NorR); using BinaryRType::BinaryRType; };
+struct XnorRInstruction:  BinaryRType<"~x">  { WHY_OPCODE(XnorR); using BinaryRType::BinaryRType; };
+struct LandRInstruction:  BinaryRType<"&&">  { WHY_OPCODE(LandR); using BinaryRType::BinaryRType; };
+struct LorRInstruction:   BinaryRType<"||">  { WHY_OPCODE(LorR); using BinaryRType::BinaryRType; };
+struct LxorRInstruction:  BinaryRType<"xx">  { WHY_OPCODE(LxorR); using BinaryRType::BinaryRType; };
+struct LnandRInstruction: BinaryRType<"~&&"> { WHY_OPCODE(LnandR); using BinaryRType::BinaryRType; };
+struct LnorRInstruction:  BinaryRType<"~||"> { WHY_OPCODE(LnorR); using BinaryRType::BinaryRType; };
+struct LxnorRInstruction: BinaryRType<"~xx"> { WHY_OPCODE(LxnorR); using BinaryRType::BinaryRType; };
+struct DivRInstruction:   BinaryRType<"/">   { WHY_OPCODE(DivR); using BinaryRType::BinaryRType; };
+struct ModRInstruction:   BinaryRType<"%">   { WHY_OPCODE(ModR); using BinaryRType::BinaryRType; };
+struct ShiftLeftLogicalRInstruction: BinaryRType<"<<"> {
+	WHY_OPCODE(ShiftLeftLogicalR);
+	using BinaryRType::BinaryRType;
+};
+struct ShiftRightArithmeticRInstruction: BinaryRType<">>"> {
+	WHY_OPCODE(ShiftRightArithmeticR);
+	using BinaryRType::BinaryRType;
+};
+struct ShiftRightLogicalRInstruction: BinaryRType<">>>"> {
+	WHY_OPCODE(ShiftRightLogicalR);
+	using BinaryRType::BinaryRType;
+};
 
 struct SneqRInstruction: RType {
+	WHY_OPCODE(SneqR);
+
 	using RType::RType;
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override {
 		return {
 			leftSource->regOrID() + " == " + rightSource->regOrID() + " -> " + destination->regOrID(),
@@ -663,6 +920,7 @@ struct SneqRInstruction: RType {
 template <fixstr::fixed_string O>
 struct BinaryIType: IType {
 	using IType::IType;
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override {
 		return {source->regOrID() + " " + std::string(O) + " " + stringify(imm) + " -> " + destination->regOrID()};
 	}
@@ -673,29 +931,39 @@ struct BinaryIType: IType {
 	}
 };
 
-struct AddIInstruction:   BinaryIType<"+">   { using BinaryIType::BinaryIType; };
-struct SubIInstruction:   BinaryIType<"-">   { using BinaryIType::BinaryIType; };
-struct AndIInstruction:   BinaryIType<"&">   { using BinaryIType::BinaryIType; };
-struct OrIInstruction:    BinaryIType<"|">   { using BinaryIType::BinaryIType; };
-struct XorIInstruction:   BinaryIType<"^">   { using BinaryIType::BinaryIType; };
-struct NandIInstruction:  BinaryIType<"~&">  { using BinaryIType::BinaryIType; };
-struct NorIInstruction:   BinaryIType<"~|">  { using BinaryIType::BinaryIType; };
-struct XnorIInstruction:  BinaryIType<"~^">  { using BinaryIType::BinaryIType; };
-struct LandIInstruction:  BinaryIType<"&&">  { using BinaryIType::BinaryIType; };
-struct LorIInstruction:   BinaryIType<"||">  { using BinaryIType::BinaryIType; };
-struct LxorIInstruction:  BinaryIType<"^^">  { using BinaryIType::BinaryIType; };
-struct LnandIInstruction: BinaryIType<"~&&"> { using BinaryIType::BinaryIType; };
-struct LnorIInstruction:  BinaryIType<"~||"> { using BinaryIType::BinaryIType; };
-struct LxnorIInstruction: BinaryIType<"~^^"> { using BinaryIType::BinaryIType; };
-struct DivIInstruction:   BinaryIType<"/">   { using BinaryIType::BinaryIType; };
-struct ModIInstruction:   BinaryIType<"%">   { using BinaryIType::BinaryIType; };
-struct ShiftLeftLogicalIInstruction:     BinaryIType<"<<">  { using BinaryIType::BinaryIType; };
-struct ShiftRightArithmeticIInstruction: BinaryIType<">>">  { using BinaryIType::BinaryIType; };
-struct ShiftRightLogicalIInstruction:    BinaryIType<">>>"> { using BinaryIType::BinaryIType; };
+struct AddIInstruction:   BinaryIType<"+">   { WHY_OPCODE(AddI); using BinaryIType::BinaryIType; };
+struct SubIInstruction:   BinaryIType<"-">   { WHY_OPCODE(SubI); using BinaryIType::BinaryIType; };
+struct AndIInstruction:   BinaryIType<"&">   { WHY_OPCODE(AndI); using BinaryIType::BinaryIType; };
+struct OrIInstruction:    BinaryIType<"|">   { WHY_OPCODE(OrI); using BinaryIType::BinaryIType; };
+struct XorIInstruction:   BinaryIType<"^">   { WHY_OPCODE(XorI); using BinaryIType::BinaryIType; };
+struct NandIInstruction:  BinaryIType<"~&">  { WHY_OPCODE(NandI); using BinaryIType::BinaryIType; };
+struct NorIInstruction:   BinaryIType<"~|">  { WHY_OPCODE(NorI); using BinaryIType::BinaryIType; };
+struct XnorIInstruction:  BinaryIType<"~^">  { WHY_OPCODE(XnorI); using BinaryIType::BinaryIType; };
+struct LandIInstruction:  BinaryIType<"&&">  { WHY_OPCODE(LandI); using BinaryIType::BinaryIType; };
+struct LorIInstruction:   BinaryIType<"||">  { WHY_OPCODE(LorI); using BinaryIType::BinaryIType; };
+struct LxorIInstruction:  BinaryIType<"^^">  { WHY_OPCODE(LxorI); using BinaryIType::BinaryIType; };
+struct LnandIInstruction: BinaryIType<"~&&"> { WHY_OPCODE(LnandI); using BinaryIType::BinaryIType; };
+struct LnorIInstruction:  BinaryIType<"~||"> { WHY_OPCODE(LnorI); using BinaryIType::BinaryIType; };
+struct LxnorIInstruction: BinaryIType<"~^^"> { WHY_OPCODE(LxnorI); using BinaryIType::BinaryIType; };
+struct DivIInstruction:   BinaryIType<"/">   { WHY_OPCODE(DivI); using BinaryIType::BinaryIType; };
+struct ModIInstruction:   BinaryIType<"%">   { WHY_OPCODE(ModI); using BinaryIType::BinaryIType; };
+struct ShiftLeftLogicalIInstruction: BinaryIType<"<<"> {
+	WHY_OPCODE(ShiftLeftLogicalI);
+	using BinaryIType::BinaryIType;
+};
+struct ShiftRightArithmeticIInstruction: BinaryIType<">>"> {
+	WHY_OPCODE(ShiftRightArithmeticI);
+	using BinaryIType::BinaryIType;
+};
+struct ShiftRightLogicalIInstruction: BinaryIType<">>>"> {
+	WHY_OPCODE(ShiftRightLogicalI);
+	using BinaryIType::BinaryIType;
+};
 
 template <fixstr::fixed_string O>
 struct InverseBinaryRType: RType {
 	using RType::RType;
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override {
 		return {
 			rightSource->regOrID() + " " + std::string(O) + " " + leftSource->regOrID() + " -> " +
@@ -710,12 +978,13 @@ struct InverseBinaryRType: RType {
 	}
 };
 
-struct SgRInstruction:  InverseBinaryRType<"<">  { using InverseBinaryRType::InverseBinaryRType; };
-struct SgeRInstruction: InverseBinaryRType<"<="> { using InverseBinaryRType::InverseBinaryRType; };
+struct SgRInstruction:  InverseBinaryRType<"<">  { WHY_OPCODE(SgR); using InverseBinaryRType::InverseBinaryRType; };
+struct SgeRInstruction: InverseBinaryRType<"<="> { WHY_OPCODE(SgeR); using InverseBinaryRType::InverseBinaryRType; };
 
 template <fixstr::fixed_string O>
 struct InverseUnsignedBinaryRType: RType {
 	using RType::RType;
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override {
 		return {
 			rightSource->regOrID() + " " + std::string(O) + " " + leftSource->regOrID() + " -> " +
@@ -730,17 +999,20 @@ struct InverseUnsignedBinaryRType: RType {
 	}
 };
 
-struct SguRInstruction: InverseUnsignedBinaryRType<"<">  {
+struct SguRInstruction: InverseUnsignedBinaryRType<"<"> {
+	WHY_OPCODE(SguR);
 	using InverseUnsignedBinaryRType::InverseUnsignedBinaryRType;
 };
 
 struct SgeuRInstruction: InverseUnsignedBinaryRType<"<="> {
+	WHY_OPCODE(SgeuR);
 	using InverseUnsignedBinaryRType::InverseUnsignedBinaryRType;
 };
 
 template <char O>
 struct UnaryRType: RType {
 	UnaryRType(VregPtr source_, VregPtr destination_): RType(source_, nullptr, destination_) {}
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override {
 		return {std::string(1, O) + leftSource->regOrID() + " -> " + destination->regOrID()};
 	}
@@ -751,12 +1023,13 @@ struct UnaryRType: RType {
 	}
 };
 
-struct NotRInstruction:  UnaryRType<'~'> { using UnaryRType::UnaryRType; };
-struct LnotRInstruction: UnaryRType<'!'> { using UnaryRType::UnaryRType; };
+struct NotRInstruction:  UnaryRType<'~'> { WHY_OPCODE(NotR); using UnaryRType::UnaryRType; };
+struct LnotRInstruction: UnaryRType<'!'> { WHY_OPCODE(LnotR); using UnaryRType::UnaryRType; };
 
 template <fixstr::fixed_string O>
 struct UnsignedBinaryRType: RType {
 	using RType::RType;
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override {
 		return {
 			leftSource->regOrID() + " " + std::string(O) + " " + rightSource->regOrID() + " -> " +
@@ -787,8 +1060,11 @@ struct ComparisonInstruction {
 
 /** $rs == (<=, <...) $rt -> $rd (/u) */
 struct ComparisonRInstruction: RType, ComparisonInstruction {
+	WHY_OPCODE(ComparisonR);
+
 	ComparisonRInstruction(const VregPtr &rs_, const VregPtr &rt_, const VregPtr &rd_, Comparison comparison_):
 		RType(rs_, rt_, rd_), ComparisonInstruction(comparison_) {}
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override {
 		return {
 			leftSource->regOrID() + " " + oper() + " " + rightSource->regOrID() + " -> " + destination->regOrID()
@@ -803,8 +1079,11 @@ struct ComparisonRInstruction: RType, ComparisonInstruction {
 };
 
 struct ComparisonIInstruction: IType, ComparisonInstruction {
+	WHY_OPCODE(ComparisonI);
+
 	ComparisonIInstruction(const VregPtr &rs_, const VregPtr &rd_, const TypedImmediate &imm_, Comparison comparison_):
 		IType(rs_, rd_, imm_), ComparisonInstruction(comparison_) {}
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override {
 		return {
 			source->regOrID() + " " + oper() + " " + stringify(imm) + " -> " + destination->regOrID()
@@ -819,6 +1098,8 @@ struct ComparisonIInstruction: IType, ComparisonInstruction {
 };
 
 struct MemsetInstruction: RType {
+	WHY_OPCODE(Memset);
+
 	using RType::RType;
 	explicit operator std::vector<std::string>() const override {
 		return {
@@ -873,6 +1154,8 @@ struct MemsetInstruction: RType {
 };
 
 struct CompareRInstruction: RType {
+	WHY_OPCODE(CompareR);
+
 	CompareRInstruction(const VregPtr &rs_, const VregPtr &rt_): RType(rs_, rt_, nullptr) {}
 	explicit operator std::vector<std::string>() const override {
 		return {leftSource->regOrID() + " ~ " + rightSource->regOrID()};
@@ -883,6 +1166,8 @@ struct CompareRInstruction: RType {
 };
 
 struct CompareIInstruction: IType {
+	WHY_OPCODE(CompareI);
+
 	CompareIInstruction(const VregPtr &rs_, const TypedImmediate &imm_): IType(rs_, nullptr, imm_) {}
 	explicit operator std::vector<std::string>() const override {
 		return {source->regOrID() + " ~ " + stringify(imm)};
@@ -893,6 +1178,9 @@ struct CompareIInstruction: IType {
 };
 
 class SelectInstruction: public RType {
+	public:
+		WHY_OPCODE(Select);
+
 	private:
 		static const std::unordered_map<Condition, const char *> operMap;
 
@@ -902,6 +1190,8 @@ class SelectInstruction: public RType {
 		SelectInstruction(const VregPtr &rs_, const VregPtr &rt_, const VregPtr &rd_, Condition condition_):
 			RType(rs_, rt_, rd_), condition(condition_) {}
 
+		bool hasSideEffects() const override { return false; }
+
 		explicit operator std::vector<std::string>() const override {
 			return {
 				"[" + leftSource->regOrID() + " " + std::string(operMap.at(condition)) + " " + rightSource->regOrID() +
@@ -920,6 +1210,7 @@ class SelectInstruction: public RType {
 template <fixstr::fixed_string O>
 struct InverseBinaryIType: IType {
 	using IType::IType;
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override {
 		return {stringify(imm) + " " + std::string(O) + " " + source->regOrID() + " -> " + destination->regOrID()};
 	}
@@ -930,16 +1221,24 @@ struct InverseBinaryIType: IType {
 	}
 };
 
-struct DiviIInstruction: InverseBinaryIType<"/"> { using InverseBinaryIType::InverseBinaryIType; };
-struct ShiftLeftLogicalInverseIInstruction: InverseBinaryIType<"<<"> { using InverseBinaryIType::InverseBinaryIType; };
+struct DiviIInstruction: InverseBinaryIType<"/"> { WHY_OPCODE(DiviI); using InverseBinaryIType::InverseBinaryIType; };
+struct ShiftLeftLogicalInverseIInstruction: InverseBinaryIType<"<<"> {
+	WHY_OPCODE(ShiftLeftLogicalInverseI);
+	using InverseBinaryIType::InverseBinaryIType;
+};
 struct ShiftRightLogicalInverseIInstruction: InverseBinaryIType<">>>"> {
-	using InverseBinaryIType::InverseBinaryIType; };
+	WHY_OPCODE(ShiftRightLogicalInverseI);
+	using InverseBinaryIType::InverseBinaryIType;
+};
 struct ShiftRightArithmeticInverseIInstruction: InverseBinaryIType<">>"> {
-	using InverseBinaryIType::InverseBinaryIType; };
+	WHY_OPCODE(ShiftRightArithmeticInverseI);
+	using InverseBinaryIType::InverseBinaryIType;
+};
 
 template <fixstr::fixed_string O>
 struct InverseUnsignedBinaryIType: IType {
 	using IType::IType;
+	bool hasSideEffects() const override { return false; }
 	explicit operator std::vector<std::string>() const override {
 		return {
 			stringify(imm) + " " + std::string(O) + " " + source->regOrID() + " -> " + destination->regOrID() + " /u"
@@ -954,9 +1253,13 @@ struct InverseUnsignedBinaryIType: IType {
 };
 
 struct DivuiIInstruction: InverseUnsignedBinaryIType<"/"> {
-	using InverseUnsignedBinaryIType::InverseUnsignedBinaryIType; };
+	WHY_OPCODE(DivuiI);
+	using InverseUnsignedBinaryIType::InverseUnsignedBinaryIType;
+};
 
 struct Nop: WhyInstruction {
+	WHY_OPCODE(Nop);
+
 	Nop() = default;
 	explicit operator std::vector<std::string>() const override { return {"<>"}; }
 	std::vector<std::string> colored() const override { return {"<>"}; }
@@ -973,11 +1276,11 @@ struct SimpleIType: IType {
 	}
 };
 
-struct IntIInstruction:   SimpleIType<"int">   { using SimpleIType::SimpleIType; };
-struct RitIInstruction:   SimpleIType<"rit">   { using SimpleIType::SimpleIType; };
-struct TimeIInstruction:  SimpleIType<"time">  { using SimpleIType::SimpleIType; };
-struct RingIInstruction:  SimpleIType<"ring">  { using SimpleIType::SimpleIType; };
-struct SetptIInstruction: SimpleIType<"setpt"> { using SimpleIType::SimpleIType; };
+struct IntIInstruction:   SimpleIType<"int">   { WHY_OPCODE(IntI); using SimpleIType::SimpleIType; };
+struct RitIInstruction:   SimpleIType<"rit">   { WHY_OPCODE(RitI); using SimpleIType::SimpleIType; };
+struct TimeIInstruction:  SimpleIType<"time">  { WHY_OPCODE(TimeI); using SimpleIType::SimpleIType; };
+struct RingIInstruction:  SimpleIType<"ring">  { WHY_OPCODE(RingI); using SimpleIType::SimpleIType; };
+struct SetptIInstruction: SimpleIType<"setpt"> { WHY_OPCODE(SetptI); using SimpleIType::SimpleIType; };
 
 template <fixstr::fixed_string N>
 struct SimpleRType: RType {
@@ -990,10 +1293,10 @@ struct SimpleRType: RType {
 	}
 };
 
-struct IntRInstruction:   SimpleRType<"int">   { using SimpleRType::SimpleRType; };
-struct RitRInstruction:   SimpleRType<"rit">   { using SimpleRType::SimpleRType; };
-struct TimeRInstruction:  SimpleRType<"time">  { using SimpleRType::SimpleRType; };
-struct RingRInstruction:  SimpleRType<"ring">  { using SimpleRType::SimpleRType; };
+struct IntRInstruction:   SimpleRType<"int">   { WHY_OPCODE(IntR); using SimpleRType::SimpleRType; };
+struct RitRInstruction:   SimpleRType<"rit">   { WHY_OPCODE(RitR); using SimpleRType::SimpleRType; };
+struct TimeRInstruction:  SimpleRType<"time">  { WHY_OPCODE(TimeR); using SimpleRType::SimpleRType; };
+struct RingRInstruction:  SimpleRType<"ring">  { WHY_OPCODE(RingR); using SimpleRType::SimpleRType; };
 
 template <fixstr::fixed_string N>
 struct SaveRInstruction: RType {
@@ -1006,11 +1309,13 @@ struct SaveRInstruction: RType {
 	}
 };
 
-struct SvtimeRInstruction: SaveRInstruction<"time"> { using SaveRInstruction::SaveRInstruction; };
-struct SvringRInstruction: SaveRInstruction<"ring"> { using SaveRInstruction::SaveRInstruction; };
-struct SvpgRInstruction:   SaveRInstruction<"page"> { using SaveRInstruction::SaveRInstruction; };
+struct SvtimeRInstruction: SaveRInstruction<"time"> { WHY_OPCODE(SvtimeR); using SaveRInstruction::SaveRInstruction; };
+struct SvringRInstruction: SaveRInstruction<"ring"> { WHY_OPCODE(SvringR); using SaveRInstruction::SaveRInstruction; };
+struct SvpgRInstruction:   SaveRInstruction<"page"> { WHY_OPCODE(SvpgR); using SaveRInstruction::SaveRInstruction; };
 
 struct PrintRInstruction: RType {
+	WHY_OPCODE(PrintR);
+
 	PrintType type;
 
 	PrintRInstruction(const VregPtr &rs_, PrintType type_): RType(rs_, nullptr, nullptr), type(type_) {}
@@ -1044,12 +1349,18 @@ struct TrivialExternalInstruction: RType {
 };
 
 struct HaltRInstruction: TrivialExternalInstruction<"halt"> {
-	using TrivialExternalInstruction::TrivialExternalInstruction; };
+	WHY_OPCODE(HaltR);
+	using TrivialExternalInstruction::TrivialExternalInstruction;
+};
 
 struct RestRInstruction: TrivialExternalInstruction<"rest"> {
-	using TrivialExternalInstruction::TrivialExternalInstruction; };
+	WHY_OPCODE(RestR);
+	using TrivialExternalInstruction::TrivialExternalInstruction;
+};
 
 struct SleepRInstruction: RType {
+	WHY_OPCODE(SleepR);
+
 	explicit SleepRInstruction(const VregPtr &rs_): RType(rs_, nullptr, nullptr) {}
 	explicit operator std::vector<std::string>() const override {
 		return {"<sleep " + leftSource->regOrID() + ">"};
@@ -1060,6 +1371,8 @@ struct SleepRInstruction: RType {
 };
 
 struct PageRInstruction: RType {
+	WHY_OPCODE(PageR);
+
 	bool on;
 	explicit PageRInstruction(bool on_): RType(nullptr, nullptr, nullptr), on(on_) {}
 	explicit operator std::vector<std::string>() const override {
@@ -1071,6 +1384,8 @@ struct PageRInstruction: RType {
 };
 
 struct QueryRInstruction: RType {
+	WHY_OPCODE(QueryR);
+
 	QueryType type;
 	QueryRInstruction(const VregPtr &rd_, QueryType type_): RType(nullptr, nullptr, rd_), type(type_) {}
 	explicit operator std::vector<std::string>() const override {
@@ -1082,6 +1397,8 @@ struct QueryRInstruction: RType {
 };
 
 struct PrintPseudoinstruction: IType {
+	WHY_OPCODE(PrintPseudoinstruction);
+
 	std::string text;
 	bool useText = false;
 
@@ -1100,6 +1417,8 @@ struct PrintPseudoinstruction: IType {
 };
 
 struct IOInstruction: RType {
+	WHY_OPCODE(IO);
+
 	std::string type;
 	explicit IOInstruction(const std::string &type_): RType(nullptr, nullptr, nullptr), type(type_) {}
 	explicit operator std::vector<std::string>() const override {
@@ -1111,6 +1430,8 @@ struct IOInstruction: RType {
 };
 
 struct InterruptsInstruction: RType {
+	WHY_OPCODE(Interrupts);
+
 	bool enable;
 	explicit InterruptsInstruction(bool enable_): RType(nullptr, nullptr, nullptr), enable(enable_) {}
 	explicit operator std::vector<std::string>() const override {
@@ -1122,6 +1443,8 @@ struct InterruptsInstruction: RType {
 };
 
 struct TranslateAddressRInstruction: RType {
+	WHY_OPCODE(TranslateAddressR);
+
 	TranslateAddressRInstruction(const VregPtr &rs_, const VregPtr &rd_): RType(rs_, nullptr, rd_) {}
 	explicit operator std::vector<std::string>() const override {
 		return {"translate " + leftSource->regOrID() + " -> " + destination->regOrID()};
@@ -1132,6 +1455,8 @@ struct TranslateAddressRInstruction: RType {
 };
 
 struct PageStackInstruction: RType {
+	WHY_OPCODE(PageStack);
+
 	bool isPush;
 	PageStackInstruction(bool is_push, const VregPtr &rs_): RType(rs_, nullptr, nullptr), isPush(is_push) {}
 	explicit operator std::vector<std::string>() const override {
@@ -1147,6 +1472,8 @@ struct PageStackInstruction: RType {
 };
 
 struct SetptRInstruction: RType {
+	WHY_OPCODE(SetptR);
+
 	SetptRInstruction(const VregPtr &rs_, const VregPtr &rt_): RType(rs_, rt_, nullptr) {}
 	explicit operator std::vector<std::string>() const override {
 		if (!rightSource)
@@ -1161,13 +1488,124 @@ struct SetptRInstruction: RType {
 };
 
 struct CallPushPlaceholder: WhyInstruction {
+	WHY_OPCODE(CallPushPlaceholder);
+
 	bool enableDebug() const override { return false; }
 	explicit operator std::vector<std::string>() const override { return {"//! Untranslated CallPushPlaceholder"};   }
 	std::vector<std::string> colored() const override { return {"\e[31m//! Untranslated CallPushPlaceholder\e[39m"}; }
 };
 
 struct CallPopPlaceholder: WhyInstruction {
+	WHY_OPCODE(CallPopPlaceholder);
+
 	bool enableDebug() const override { return false; }
 	explicit operator std::vector<std::string>() const override { return {"//! Untranslated CallPopPlaceholder"};   }
 	std::vector<std::string> colored() const override { return {"\e[31m//! Untranslated CallPopPlaceholder\e[39m"}; }
 };
+
+/** Merges one value per predecessor of its block into its destination. Phis only exist while a function is in SSA form
+ *  (see SSA) and always come first in their block, right after its label. */
+struct PhiInstruction: WhyInstruction, HasDestination {
+	WHY_OPCODE(Phi);
+
+	struct Incoming {
+		VregPtr value;
+		std::weak_ptr<BasicBlock> block;
+	};
+
+	std::vector<Incoming> incoming;
+
+	explicit PhiInstruction(VregPtr destination_): HasDestination(std::move(destination_)) {}
+
+	bool hasSideEffects() const override { return false; }
+
+	/** Returns the incoming value for a predecessor, or nullptr if the predecessor isn't one of the phi's. */
+	VregPtr * find(const BasicBlock *);
+
+	explicit operator std::vector<std::string>() const override;
+	std::vector<std::string> colored() const override;
+
+	std::vector<VregPtr> getRead() override {
+		std::vector<VregPtr> out;
+		out.reserve(incoming.size());
+		for (const Incoming &entry: incoming)
+			out.push_back(entry.value);
+		return out;
+	}
+
+	std::vector<VregPtr> getWritten() override { return {destination}; }
+
+	bool replaceRead(const VregPtr &from, const VregPtr &to) override {
+		bool changed = false;
+		for (Incoming &entry: incoming)
+			if (entry.value == from) {
+				entry.value = to;
+				changed = true;
+			}
+		return changed;
+	}
+
+	bool canReplaceRead(const VregPtr &var) const override {
+		return doesRead(var);
+	}
+
+	bool replaceWritten(const VregPtr &from, const VregPtr &to) override {
+		if (destination != from)
+			return false;
+		destination = to;
+		return true;
+	}
+
+	bool canReplaceWritten(const VregPtr &var) const override {
+		return destination == var;
+	}
+
+	bool doesRead(const VregPtr &var) const override {
+		for (const Incoming &entry: incoming)
+			if (entry.value == var)
+				return true;
+		return false;
+	}
+
+	bool doesWrite(const VregPtr &var) const override {
+		return destination == var;
+	}
+};
+
+/** LLVM-style type tests for instructions. Types with an opcode are checked by comparing tags; others fall back to
+ *  dynamic_cast. */
+template <typename T>
+bool isa(const WhyInstruction *instruction) {
+	return instruction != nullptr && instruction->is<T>();
+}
+
+template <typename T>
+bool isa(const std::shared_ptr<WhyInstruction> &instruction) {
+	return isa<T>(instruction.get());
+}
+
+/** Casts an instruction to a type it's known to have. */
+template <typename T>
+T * cast(WhyInstruction *instruction) {
+	assert(isa<T>(instruction));
+	if constexpr (HasOpcode<T>)
+		return static_cast<T *>(instruction);
+	else
+		return dynamic_cast<T *>(instruction);
+}
+
+template <typename T>
+T * cast(const std::shared_ptr<WhyInstruction> &instruction) {
+	return cast<T>(instruction.get());
+}
+
+/** Casts an instruction to a type if it has it. Returns nullptr otherwise. */
+template <typename T>
+T * dyn_cast(WhyInstruction *instruction) {
+	return instruction == nullptr? nullptr : instruction->cast<T>();
+}
+
+template <typename T>
+T * dyn_cast(const std::shared_ptr<WhyInstruction> &instruction) {
+	return dyn_cast<T>(instruction.get());
+}
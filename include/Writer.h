@@ -0,0 +1,48 @@
+#pragma once
+
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+/** A buffered writer over a file descriptor. Output is collected in a large buffer that's written out whenever it
+ *  fills up, when flush() is called and when the writer is destroyed, so callers can stream output piece by piece
+ *  without building it up in memory first. */
+class Writer {
+	private:
+		int fd;
+		std::vector<char> buffer;
+		size_t used = 0;
+
+	public:
+		static constexpr size_t DEFAULT_CAPACITY = 1 << 20;
+
+		explicit Writer(int fd_ = 1, size_t capacity = DEFAULT_CAPACITY);
+		Writer(const Writer &) = delete;
+		Writer & operator=(const Writer &) = delete;
+
+		/** Flushes any buffered output. Errors are ignored here; call flush() first to have them reported. */
+		~Writer();
+
+		Writer & write(const char *, size_t);
+
+		/** Writes the buffered output to the file descriptor. Throws std::system_error if that fails. */
+		void flush();
+
+		Writer & operator<<(std::string_view string) { return write(string.data(), string.size()); }
+
+		Writer & operator<<(char ch) {
+			if (used == buffer.size())
+				flush();
+			buffer[used++] = ch;
+			return *this;
+		}
+
+		template <std::integral I>
+		Writer & operator<<(I value) {
+			char digits[24];
+			const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+			return write(digits, size_t(result.ptr - digits));
+		}
+};
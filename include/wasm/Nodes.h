@@ -6,6 +6,7 @@
 #include "ASTNode.h"
 #include "Enums.h"
 #include "Immediate.h"
+#include "Variable.h"
 
 enum class WASMNodeType {
 	Immediate, RType, IType, Copy, Load, Store, Set, Li, Si, Lni, Cmp, Cmpi, Sel, J, Jc, Jr, Jrc, Mv,
@@ -15,11 +16,9 @@ enum class WASMNodeType {
 };
 
 class Function;
-struct Variable;
-struct VirtualRegister;
 struct WhyInstruction;
 
-using VarMap = std::unordered_map<std::string, std::shared_ptr<VirtualRegister>>;
+using VarMap = std::unordered_map<std::string, VregPtr>;
 
 struct WASMBaseNode: ASTNode {
 	explicit WASMBaseNode(int sym);
@@ -30,8 +29,8 @@ struct WASMBaseNode: ASTNode {
 struct WASMInstructionNode: WASMBaseNode {
 	using WASMBaseNode::WASMBaseNode;
 
-	static std::shared_ptr<VirtualRegister> convertVariable(Function &, VarMap &, const std::string *);
-	virtual std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) { return nullptr; }
+	static VregPtr convertVariable(Function &, VarMap &, const std::string *);
+	virtual std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) { return nullptr; }
 };
 
 struct WASMImmediateNode: WASMBaseNode {
@@ -51,7 +50,7 @@ struct WASMLabelNode: WASMInstructionNode { // Not technically an instruction, b
 	WASMNodeType nodeType() const override { return WASMNodeType::Label; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct RNode: WASMInstructionNode {
@@ -62,7 +61,7 @@ struct RNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::RType; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct INode: WASMInstructionNode {
@@ -76,7 +75,7 @@ struct INode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::IType; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMMemoryNode: WASMInstructionNode {
@@ -91,7 +90,7 @@ struct WASMCopyNode: WASMMemoryNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Copy; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMLoadNode: WASMMemoryNode {
@@ -99,7 +98,7 @@ struct WASMLoadNode: WASMMemoryNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Load; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMStoreNode: WASMMemoryNode {
@@ -107,7 +106,7 @@ struct WASMStoreNode: WASMMemoryNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Store; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMSetNode: WASMInstructionNode {
@@ -118,7 +117,7 @@ struct WASMSetNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Set; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMLiNode: WASMInstructionNode {
@@ -129,7 +128,7 @@ struct WASMLiNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Li; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMSiNode: WASMInstructionNode {
@@ -140,7 +139,7 @@ struct WASMSiNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Si; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMLniNode: WASMLiNode {
@@ -148,7 +147,7 @@ struct WASMLniNode: WASMLiNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Lni; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMMidMemoryNode: WASMInstructionNode {
@@ -164,7 +163,7 @@ struct WASMCmpNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Cmp; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMCmpiNode: WASMInstructionNode {
@@ -175,7 +174,7 @@ struct WASMCmpiNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Cmpi; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMSelNode: WASMInstructionNode {
@@ -186,7 +185,7 @@ struct WASMSelNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Sel; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMJNode: WASMInstructionNode {
@@ -198,7 +197,7 @@ struct WASMJNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::J; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMJcNode: WASMInstructionNode {
@@ -210,7 +209,7 @@ struct WASMJcNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Jc; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 // Used for both jr and jrl.
@@ -223,7 +222,7 @@ struct WASMJrNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Jr; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 // Used for both jrc and jrlc.
@@ -235,7 +234,7 @@ struct WASMJrcNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Jrc; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMMultRNode: WASMInstructionNode {
@@ -245,7 +244,7 @@ struct WASMMultRNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::MultR; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMMultINode: WASMInstructionNode {
@@ -256,7 +255,7 @@ struct WASMMultINode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::MultI; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMDiviINode: WASMInstructionNode {
@@ -267,7 +266,7 @@ struct WASMDiviINode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::DiviI; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMLuiNode: WASMInstructionNode {
@@ -278,7 +277,7 @@ struct WASMLuiNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Lui; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMStackNode: WASMInstructionNode {
@@ -289,7 +288,7 @@ struct WASMStackNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Stack; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMNopNode: WASMInstructionNode {
@@ -297,7 +296,7 @@ struct WASMNopNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Nop; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMIntINode: WASMInstructionNode {
@@ -307,7 +306,7 @@ struct WASMIntINode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::IntI; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMRitINode: WASMInstructionNode {
@@ -317,7 +316,7 @@ struct WASMRitINode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::RitI; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMTimeINode: WASMInstructionNode {
@@ -327,7 +326,7 @@ struct WASMTimeINode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::TimeI; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMTimeRNode: WASMInstructionNode {
@@ -337,7 +336,7 @@ struct WASMTimeRNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::TimeR; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMSvtimeNode: WASMInstructionNode {
@@ -347,7 +346,7 @@ struct WASMSvtimeNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Svtime; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMRingINode: WASMInstructionNode {
@@ -357,7 +356,7 @@ struct WASMRingINode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::RingI; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMRingRNode: WASMInstructionNode {
@@ -367,7 +366,7 @@ struct WASMRingRNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::RingR; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMSvringNode: WASMInstructionNode {
@@ -377,7 +376,7 @@ struct WASMSvringNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Svring; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMPrintNode: WASMInstructionNode {
@@ -388,7 +387,7 @@ struct WASMPrintNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Print; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMHaltNode: WASMInstructionNode {
@@ -396,7 +395,7 @@ struct WASMHaltNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Halt; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMSleepRNode: WASMInstructionNode {
@@ -406,7 +405,7 @@ struct WASMSleepRNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::SleepR; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMPageNode: WASMInstructionNode {
@@ -416,7 +415,7 @@ struct WASMPageNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Page; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMSetptINode: WASMInstructionNode {
@@ -426,7 +425,7 @@ struct WASMSetptINode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::SetptI; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMSetptRNode: WASMInstructionNode {
@@ -437,7 +436,7 @@ struct WASMSetptRNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::SetptR; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMMvNode: WASMInstructionNode {
@@ -447,7 +446,7 @@ struct WASMMvNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Mv; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMSvpgNode: WASMInstructionNode {
@@ -457,7 +456,7 @@ struct WASMSvpgNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Svpg; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMQueryNode: WASMInstructionNode {
@@ -468,7 +467,7 @@ struct WASMQueryNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Query; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMPseudoPrintNode: WASMInstructionNode {
@@ -480,7 +479,7 @@ struct WASMPseudoPrintNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::PseudoPrint; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMRestNode: WASMInstructionNode {
@@ -488,7 +487,7 @@ struct WASMRestNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Rest; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMIONode: WASMInstructionNode {
@@ -498,7 +497,7 @@ struct WASMIONode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::IO; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMInterruptsNode: WASMInstructionNode {
@@ -508,7 +507,7 @@ struct WASMInterruptsNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::Interrupts; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMInverseShiftNode: WASMInstructionNode {
@@ -520,7 +519,7 @@ struct WASMInverseShiftNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::InverseShift; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMTransNode: WASMInstructionNode {
@@ -530,7 +529,7 @@ struct WASMTransNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::TranslateAddress; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
 
 struct WASMPageStackNode: WASMInstructionNode {
@@ -541,5 +540,5 @@ struct WASMPageStackNode: WASMInstructionNode {
 	WASMNodeType nodeType() const override { return WASMNodeType::PageStack; }
 	std::string debugExtra() const override;
 	explicit operator std::string() const override;
-	std::unique_ptr<WhyInstruction> convert(Function &, VarMap &) override;
+	std::shared_ptr<WhyInstruction> convert(Function &, VarMap &) override;
 };
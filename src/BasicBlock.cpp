@@ -1,8 +1,14 @@
 #include "BasicBlock.h"
+#include "Function.h"
 #include "Global.h"
 #include "Variable.h"
 #include "WhyInstructions.h"
 
+BasicBlock & BasicBlock::operator+=(const WhyPtr &instruction) {
+	instruction->blockPosition = instructions.insert(instructions.end(), instruction);
+	return *this;
+}
+
 std::set<VregPtr> BasicBlock::gatherVariables() const {
 	std::set<VregPtr> out;
 
@@ -22,15 +28,26 @@ size_t BasicBlock::countVariables() const {
 	return gatherVariables().size();
 }
 
-void BasicBlock::cacheReadWritten() {
-	readCache.clear();
-	writtenCache.clear();
+void BasicBlock::computeUsesAndDefs() {
+	uses = Bitset(size_t(function.nextVariable));
+	defs = Bitset(size_t(function.nextVariable));
 	for (const auto &instruction: instructions) {
 		for (const auto &var: instruction->getRead())
-			if (!var->precolored)
-				readCache.insert(var);
+			if (function.isTracked(var) && !defs.test(var->id))
+				uses.set(var->id);
 		for (const auto &var: instruction->getWritten())
-			if (!var->precolored)
-				readCache.insert(var);
+			if (function.isTracked(var))
+				defs.set(var->id);
 	}
 }
+
+bool BasicBlock::fallsThrough() const {
+	if (instructions.empty())
+		return true;
+	const auto &last = instructions.back();
+	if (!last->isTerminal())
+		return true;
+	if (const auto *conditional = dynamic_cast<const Conditional *>(last.get()))
+		return conditional->condition != Condition::None;
+	return false;
+}
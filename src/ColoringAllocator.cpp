@@ -1,9 +1,16 @@
 #include <algorithm>
 #include <climits>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <numeric>
 #include <optional>
+#include <unordered_map>
+#include <vector>
 
+#include "Bitset.h"
 #include "ColoringAllocator.h"
 #include "Errors.h"
 #include "Function.h"
@@ -16,139 +23,393 @@ ColoringAllocator::Result ColoringAllocator::attempt() {
 	++attempts;
 	makeInterferenceGraph();
 
-	try {
-		interference.color(Graph::ColoringAlgorithm::Greedy, Why::temporaryOffset,
-			Why::savedOffset + Why::savedCount - 1);
-	} catch (const UncolorableError &err) {
-		VregPtr to_spill = selectMostLive();
-		if (!to_spill)
-			throw std::runtime_error("to_spill is null");
+	// Vregs given a precolored register stay in it. Spill code only introduces new vregs, so their live ranges don't
+	// change in later rounds.
+	if (attempts == 1) {
+		const int fixed = coalescePrecolored();
+		if (0 < fixed) {
+			coalescedCount += fixed;
+			makeInterferenceGraph();
+		}
+	}
+
+	std::vector<double> costs = spillCosts();
+	const int coalesced = coalesce(costs);
+	const std::vector<size_t> uncolored = interference.colorOptimistic(firstRegister, lastRegister, costs);
+
+	if (uncolored.empty()) {
+		coalescedCount += coalesced;
+		for (size_t index = 0; index < interference.size(); ++index) {
+			const auto &ptr = interference.vreg(index);
+			if (ptr->getReg() == -1)
+				ptr->setReg(interference.color(index));
+		}
+
+		return Result::Success;
+	}
+
+	// Spill every actual spill from this round at once and only then recompute liveness.
+	bool spilled = false;
+	auto try_spill = [&](const VregPtr &to_spill) {
 		triedIDs.insert(to_spill->id);
 		lastSpillAttempt = to_spill;
-		triedIDs.insert(to_spill->id);
-
-		if (function.spill(to_spill)) {
+		if (function.spill(to_spill, false)) {
 			lastSpill = to_spill;
 			++spillCount;
-			if (0 < function.split()) {
-				for (auto &block: function.blocks)
-					block->cacheReadWritten();
-				function.makeCFG();
-				function.computeLiveness();
-			}
-			return Result::Spilled;
+			spilled = true;
 		}
+	};
 
-		return Result::NotSpilled;
-	}
+	for (const size_t index: uncolored)
+		if (std::isfinite(costs[index]) && function.canSpill(interference.vreg(index)))
+			try_spill(interference.vreg(index));
 
-	for (const std::pair<const std::string, Node *> &pair: interference) {
-		auto ptr = pair.second->get<VregPtr>();
-		if (ptr->getReg() == -1)
-			ptr->setReg(*pair.second->colors.begin());
+	// If none of the uncolored vregs are worth spilling, spill the cheapest vreg that interferes with one of them.
+	if (!spilled) {
+		VregPtr to_spill = selectCheapest(costs, uncolored);
+		if (!to_spill)
+			throw std::runtime_error("to_spill is null");
+		try_spill(to_spill);
 	}
 
-	return Result::Success;
+	if (0 < function.split())
+		function.makeCFG();
+	function.computeLiveness();
+	return spilled? Result::Spilled : Result::NotSpilled;
 }
 
-VregPtr ColoringAllocator::selectMostLive(int *liveness_out) const {
-	VregPtr ptr;
-	int highest = -1;
-	for (const auto &var: function.virtualRegisters) {
-		if (Why::isSpecialPurpose(var->getReg()) || !function.canSpill(var))
-			continue;
+std::vector<double> ColoringAllocator::spillCosts() const {
+	constexpr double LOOP_WEIGHT = 10.;
+	constexpr size_t MAX_DEPTH = 8;
+
+	const LoopForest *loops = nullptr;
+	if (!function.blocks.empty() && function.blocks.front()->node != nullptr)
+		loops = &function.loops();
+
+	const size_t node_count = interference.size();
+	std::vector<double> weights(node_count, 0.);
+	// Whether every read of a vreg comes right after an instruction that defines it. Spilling such a vreg would only
+	// replace it with a reload that's live for just as long.
+	std::vector<bool> adjacent(node_count, true);
 
-		const int sum = int(function.getLiveIn(var).size() + function.getLiveOut(var).size());
-		if (highest < sum && triedIDs.count(var->id) == 0) {
-			highest = sum;
-			ptr = var;
+	auto index_of = [this](const VregPtr &var) -> std::optional<size_t> {
+		if (var->getReg() != -1 || !interference.contains(var->id))
+			return std::nullopt;
+		return interference.indexOf(var->id);
+	};
+
+	for (const auto &block: function.blocks) {
+		size_t depth = 0;
+		if (loops != nullptr && block->node != nullptr)
+			depth = std::min(loops->depth(*block->node), MAX_DEPTH);
+		const double weight = std::pow(LOOP_WEIGHT, double(depth));
+
+		const WhyInstruction *previous = nullptr;
+		for (const WhyPtr &instruction: block->instructions) {
+			if (instruction->is<Comment>())
+				continue;
+			for (const VregPtr &var: instruction->getRead())
+				if (const auto index = index_of(var)) {
+					weights[*index] += weight;
+					if (previous == nullptr || !previous->doesWrite(var))
+						adjacent[*index] = false;
+				}
+			for (const VregPtr &var: instruction->getWritten())
+				if (const auto index = index_of(var))
+					weights[*index] += weight;
+			previous = instruction.get();
 		}
 	}
 
-	if (!ptr) {
-		function.debug();
-		throw std::runtime_error("Couldn't select variable with highest liveness");
+	std::vector<double> costs;
+	costs.reserve(node_count);
+	for (size_t index = 0; index < node_count; ++index) {
+		const VregPtr &var = interference.vreg(index);
+		if (function.vregTable.getWriters(*var).empty() || function.isSpilled(var) || adjacent[index])
+			costs.push_back(std::numeric_limits<double>::infinity());
+		else if (function.getRematerializer(var))
+			// Rematerializing needs no store and no memory access on reload.
+			costs.push_back(weights[index] / 2.);
+		else
+			costs.push_back(weights[index]);
 	}
+	return costs;
+}
+
+VregPtr ColoringAllocator::selectCheapest(const std::vector<double> &costs, const std::vector<size_t> &uncolored) {
+	auto cheapest = [&](const std::vector<size_t> &candidates) -> VregPtr {
+		std::vector<std::pair<double, size_t>> ordered;
+		for (const size_t index: candidates)
+			if (!interference.isMerged(index) && std::isfinite(costs[index]) &&
+			    triedIDs.count(interference.vreg(index)->id) == 0)
+				ordered.emplace_back(costs[index] / double(interference.degree(index) + 1), index);
+		std::stable_sort(ordered.begin(), ordered.end(), [](const auto &left, const auto &right) {
+			return left.first < right.first;
+		});
+		for (const auto &[cost, index]: ordered)
+			if (function.canSpill(interference.vreg(index)))
+				return interference.vreg(index);
+		return nullptr;
+	};
+
+	std::vector<size_t> neighbors;
+	Bitset seen(interference.size());
+	for (const size_t index: uncolored)
+		for (const size_t neighbor: interference.neighbors(index))
+			if (!seen.test(neighbor)) {
+				seen.set(neighbor);
+				neighbors.push_back(neighbor);
+			}
+
+	if (VregPtr found = cheapest(neighbors))
+		return found;
 
-	if (liveness_out != nullptr)
-		*liveness_out = highest;
+	std::vector<size_t> everything(interference.size());
+	std::iota(everything.begin(), everything.end(), 0);
+	if (VregPtr found = cheapest(everything))
+		return found;
 
-	if (!function.canSpill(ptr))
-		warn() << "Impossibility detected: can't spill " << ptr->regOrID(true) << '\n';
+	// Spilling a vreg that's only read right after its definition rarely helps, but with block cliques it can still
+	// break up a clique, so try that before giving up.
+	for (const size_t index: everything)
+		if (!interference.isMerged(index) && triedIDs.count(interference.vreg(index)->id) == 0 &&
+		    function.canSpill(interference.vreg(index)))
+			return interference.vreg(index);
 
-	return ptr;
+	function.debug();
+	throw std::runtime_error("Couldn't select a vreg to spill in function " + function.name);
 }
 
-void ColoringAllocator::makeInterferenceGraph() {
-	interference.clear();
-	size_t links = 0;
+static bool isCall(const WhyPtr &instruction) {
+	if (const auto *jump = instruction->cast<JumpInstruction>())
+		return jump->link;
+	if (const auto *jump = instruction->cast<JumpRegisterInstruction>())
+		return jump->link;
+	if (const auto *jump = instruction->cast<JumpRegisterConditionalInstruction>())
+		return jump->link;
+	return false;
+}
 
-	for (const auto &var: function.virtualRegisters) {
-		if (var->getReg() == -1) {
-			const std::string id = std::to_string(var->id);
-			if (!interference.hasLabel(id)) {
-				Node &node = interference.addNode(id);
-				node.data = var;
-				node.colorsNeeded = 1; // TODO: update if variables can span more than one register
-			}
+int ColoringAllocator::coalescePrecolored() {
+	struct Range {
+		int block = -1;
+		bool local = true;
+		size_t first = 0, last = 0;
+	};
+
+	std::vector<Range> ranges(size_t(function.nextVariable));
+	std::vector<std::vector<WhyPtr>> block_instructions;
+	block_instructions.reserve(function.blocks.size());
+
+	auto candidate = [this](const VregPtr &var) {
+		return function.isTracked(var) && var->getReg() == -1 && interference.contains(var->id);
+	};
+
+	for (const auto &block: function.blocks) {
+		const int block_index = int(block_instructions.size());
+		auto &list = block_instructions.emplace_back(block->instructions.begin(), block->instructions.end());
+		for (size_t position = 0; position < list.size(); ++position) {
+			auto note = [&](const VregPtr &var) {
+				if (!candidate(var))
+					return;
+				Range &range = ranges[var->id];
+				if (range.block == -1) {
+					range.block = block_index;
+					range.first = position;
+				} else if (range.block != block_index)
+					range.local = false;
+				range.last = position;
+			};
+			for (const VregPtr &var: list[position]->getRead())
+				note(var);
+			for (const VregPtr &var: list[position]->getWritten())
+				note(var);
 		}
+		block->liveIn.forEach([&](size_t id) { ranges[id].local = false; });
+		block->liveOut.forEach([&](size_t id) { ranges[id].local = false; });
 	}
 
-	std::vector<std::string> labels;
-	labels.reserve(function.virtualRegisters.size());
-	for (const auto &var: function.virtualRegisters)
-		labels.push_back(std::to_string(var->id));
+	auto coalescable = [](const VregPtr &var) {
+		return var->precolored && (Why::isArgumentRegister(var->getReg()) || Why::isReturnValueRegister(var->getReg()));
+	};
 
-	std::unordered_map<int, std::vector<int>> vecs;
-	std::unordered_map<int, std::set<int>> sets;
+	std::map<int, std::vector<size_t>> assigned;
+	int count = 0;
 
-	for (const auto &var: function.virtualRegisters) {
-		const int id = var->id;
-		if (var->getReg() != -1)
-			continue;
-		for (const std::weak_ptr<BasicBlock> &bptr: var->writingBlocks) {
-			const auto index = bptr.lock()->index;
-			if (sets[index].count(id) == 0) {
-				vecs[index].push_back(id);
-				sets[index].insert(id);
-			}
-		}
-		for (const std::weak_ptr<BasicBlock> &bptr: var->readingBlocks) {
-			const auto index = bptr.lock()->index;
-			if (sets[index].count(id) == 0) {
-				vecs[index].push_back(id);
-				sets[index].insert(id);
+	for (size_t block_index = 0; block_index < block_instructions.size(); ++block_index) {
+		const auto &list = block_instructions[block_index];
+		for (size_t position = 0; position < list.size(); ++position) {
+			const auto *move = list[position]->cast<MoveInstruction>();
+			if (move == nullptr)
+				continue;
+
+			// When the vreg is copied from the register, it has to stay a copy of it; when it's copied into the
+			// register, the register's old value must not be needed before the move.
+			VregPtr var;
+			bool into = false;
+			if (coalescable(move->leftSource) && candidate(move->destination)) {
+				var = move->destination;
+			} else if (coalescable(move->destination) && candidate(move->leftSource)) {
+				var = move->leftSource;
+				into = true;
+			} else
+				continue;
+
+			const int reg = (into? move->destination : move->leftSource)->getReg();
+			const Range &range = ranges[var->id];
+			if (!range.local || range.block != int(block_index))
+				continue;
+
+			bool safe = true;
+			for (size_t other = range.first; safe && other <= range.last; ++other) {
+				if (other == position)
+					continue;
+				const WhyPtr &instruction = list[other];
+				if (isCall(instruction)) {
+					safe = false;
+					break;
+				}
+				for (const VregPtr &written: instruction->getWritten())
+					if (written->getReg() == reg || (written == var && (!into || position < other)))
+						safe = false;
+				if (into && other < position)
+					for (const VregPtr &read: instruction->getRead())
+						if (read->getReg() == reg)
+							safe = false;
 			}
+
+			if (!safe)
+				continue;
+
+			const size_t index = interference.indexOf(var->id);
+			auto &others = assigned[reg];
+			if (std::any_of(others.begin(), others.end(), [&](size_t other) {
+				return interference.interferes(index, other);
+			}))
+				continue;
+
+			others.push_back(index);
+			var->setReg(reg);
+			++count;
 		}
 	}
 
+	return count;
+}
+
+int ColoringAllocator::coalesce(std::vector<double> &costs) {
+	const size_t color_count = size_t(lastRegister - firstRegister + 1);
+	int count = 0;
+
+	for (const WhyPtr &instruction: function.instructions) {
+		const auto *move = instruction->cast<MoveInstruction>();
+		if (move == nullptr)
+			continue;
+
+		const VregPtr &source = move->leftSource, &destination = move->destination;
+		if (source->getReg() != -1 || destination->getReg() != -1 || !interference.contains(source->id) ||
+		    !interference.contains(destination->id))
+			continue;
+
+		const size_t kept = interference.find(interference.indexOf(source->id));
+		const size_t removed = interference.find(interference.indexOf(destination->id));
+		if (kept == removed || interference.interferes(kept, removed) ||
+		    !interference.canCoalesce(kept, removed, color_count))
+			continue;
+
+		interference.merge(kept, removed);
+		costs[kept] += costs[removed];
+		++count;
+	}
+
+	return count;
+}
+
+void ColoringAllocator::makeInterferenceGraph() {
+	interference.clear(size_t(function.nextVariable));
+
+	for (const auto &var: function.virtualRegisters)
+		if (var->getReg() == -1)
+			interference.add(var);
+
+	if (mode == InterferenceMode::BlockCliques)
+		addBlockCliqueInterference();
+	else
+		addPreciseInterference();
+}
+
+void ColoringAllocator::addPreciseInterference() {
+	auto allocatable = [this](const VregPtr &var) {
+		return function.isTracked(var) && var->getReg() == -1 && interference.contains(var->id);
+	};
+
 	for (const std::shared_ptr<BasicBlock> &block: function.blocks) {
-		auto &vec = vecs[block->index];
-		auto &set = sets[block->index];
-		for (const VregPtr &var: block->liveIn) {
-			const int id = var->id;
-			if (var->getReg() == -1 && set.count(id) == 0) {
-				vec.push_back(id);
-				set.insert(id);
+		Bitset live = block->liveOut;
+		for (auto iter = block->instructions.rbegin(), rend = block->instructions.rend(); iter != rend; ++iter) {
+			const WhyPtr &instruction = *iter;
+			const auto written = instruction->getWritten();
+			const auto read = instruction->getRead();
+			// The source of a move doesn't interfere with the destination: both can share a register.
+			const VregPtr move_source = instruction->is<MoveInstruction>() && !read.empty()? read.front() : nullptr;
+
+			for (const VregPtr &def: written) {
+				if (!allocatable(def))
+					continue;
+				const size_t def_index = interference.indexOf(def->id);
+				live.forEach([&](size_t id) {
+					const VregPtr &other = function.vregTable.vreg(id);
+					if (other && other != move_source && allocatable(other))
+						interference.link(def_index, interference.indexOf(other->id));
+				});
+				for (const VregPtr &other_def: written)
+					if (other_def != def && allocatable(other_def))
+						interference.link(def_index, interference.indexOf(other_def->id));
 			}
+
+			for (const VregPtr &def: written)
+				if (function.isTracked(def))
+					live.reset(size_t(def->id));
+			for (const VregPtr &use: read)
+				if (function.isTracked(use))
+					live.set(size_t(use->id));
 		}
-		for (const VregPtr &var: block->liveOut) {
-			const int id = var->id;
-			if (var->getReg() == -1 && set.count(id) == 0) {
-				vec.push_back(id);
-				set.insert(id);
-			}
+	}
+}
+
+void ColoringAllocator::addBlockCliqueInterference() {
+	std::unordered_map<int, std::vector<size_t>> vecs;
+	std::unordered_map<int, Bitset> sets;
+
+	auto include = [&](int block_index, const VregPtr &var) {
+		if (var->getReg() != -1 || !interference.contains(var->id))
+			return;
+		Bitset &set = sets[block_index];
+		if (!set.test(size_t(var->id))) {
+			set.set(size_t(var->id));
+			vecs[block_index].push_back(interference.indexOf(var->id));
 		}
+	};
+
+	for (const auto &var: function.virtualRegisters) {
+		for (const BasicBlock *block: function.vregTable.getWritingBlocks(*var))
+			include(block->index, var);
+		for (const BasicBlock *block: function.vregTable.getReadingBlocks(*var))
+			include(block->index, var);
+	}
+
+	for (const std::shared_ptr<BasicBlock> &block: function.blocks) {
+		Bitset live = block->liveIn;
+		live.unite(block->liveOut);
+		live.forEach([&](size_t id) {
+			if (const VregPtr &var = function.vregTable.vreg(id))
+				include(block->index, var);
+		});
 	}
 
 	for (const auto &[block_id, vec]: vecs) {
 		const size_t size = vec.size();
-		if (size < 2)
-			continue;
-		for (size_t i = 0; i < size - 1; ++i)
-			for (size_t j = i + 1; j < size; ++j) {
-				interference.link(std::to_string(vec[i]), std::to_string(vec[j]), true);
-				++links;
-			}
+		for (size_t i = 0; i + 1 < size; ++i)
+			for (size_t j = i + 1; j < size; ++j)
+				interference.link(vec[i], vec[j]);
 	}
 }
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <unordered_set>
+
+#include "DCE.h"
+#include "DominatorTree.h"
+#include "Function.h"
+#include "WhyInstructions.h"
+
+/** Returns whether any block other than the entry has its label used for something other than a branch to it, in
+ *  which case it could be reached in ways the CFG doesn't show. */
+static bool labelsEscape(const Function &function) {
+	std::unordered_set<std::string> labels;
+	for (auto iter = std::next(function.blocks.begin()), end = function.blocks.end(); iter != end; ++iter)
+		labels.insert((*iter)->label);
+
+	for (const BasicBlockPtr &block: function.blocks)
+		for (const WhyPtr &instruction: block->instructions) {
+			if (const auto *jump = instruction->cast<JType>(); jump && !jump->link)
+				continue;
+			if (const auto *immediate = instruction->cast<HasImmediate>(); immediate && immediate->imm.is<std::string>())
+				if (labels.contains(immediate->imm.get<std::string>()))
+					return true;
+		}
+
+	return false;
+}
+
+/** Returns whether an instruction can be deleted when nothing reads what it writes. Writes to precolored vregs are
+ *  read in ways the vreg table doesn't see, such as by calls and returns. */
+static bool isRemovable(Function &function, WhyInstruction &instruction) {
+	if (instruction.hasSideEffects())
+		return false;
+	const std::vector<VregPtr> written = instruction.getWritten();
+	if (written.empty())
+		return false;
+	return std::all_of(written.begin(), written.end(), [&](const VregPtr &vreg) { return function.isTracked(vreg); });
+}
+
+bool DCE::removeUnreachable() {
+	if (function.blocks.empty() || labelsEscape(function))
+		return false;
+
+	const DominatorTree &dominators = function.dominators();
+	std::unordered_set<const BasicBlock *> unreachable;
+	for (const BasicBlockPtr &block: function.blocks)
+		if (block->node == nullptr || !dominators.contains(*block->node))
+			unreachable.insert(block.get());
+
+	if (unreachable.empty())
+		return false;
+
+	// Reachable blocks can't have unreachable successors, only unreachable predecessors.
+	for (const BasicBlockPtr &block: function.blocks) {
+		if (unreachable.contains(block.get()))
+			continue;
+
+		std::vector<BasicBlockPtr> dropped;
+		for (const auto &weak_predecessor: block->predecessors)
+			if (const auto predecessor = weak_predecessor.lock(); predecessor && unreachable.contains(predecessor.get()))
+				dropped.push_back(predecessor);
+
+		for (const BasicBlockPtr &predecessor: dropped)
+			block->predecessors.erase(predecessor);
+
+		if (dropped.empty())
+			continue;
+
+		for (const WhyPtr &instruction: block->instructions) {
+			if (instruction->is<Label>())
+				continue;
+			auto *phi = instruction->cast<PhiInstruction>();
+			if (phi == nullptr)
+				break;
+			std::erase_if(phi->incoming, [&](const PhiInstruction::Incoming &entry) {
+				const auto predecessor = entry.block.lock();
+				return !predecessor || unreachable.contains(predecessor.get());
+			});
+		}
+	}
+
+	std::erase_if(function.blocks, [&](const BasicBlockPtr &block) {
+		return unreachable.contains(block.get());
+	});
+
+	int last_index = -1;
+	for (const BasicBlockPtr &block: function.blocks)
+		block->index = ++last_index;
+
+	return true;
+}
+
+bool DCE::removeDead() {
+	std::unordered_set<WhyInstruction *> live;
+	std::vector<WhyInstruction *> work;
+
+	auto mark = [&](WhyInstruction *instruction) {
+		if (live.insert(instruction).second)
+			work.push_back(instruction);
+	};
+
+	for (const BasicBlockPtr &block: function.blocks)
+		for (const WhyPtr &instruction: block->instructions)
+			if (!isRemovable(function, *instruction))
+				mark(instruction.get());
+
+	// Every definition of a vreg read by a live instruction could be the one it reads.
+	while (!work.empty()) {
+		WhyInstruction *instruction = work.back();
+		work.pop_back();
+		for (const VregPtr &vreg: instruction->getRead())
+			if (function.isTracked(vreg))
+				for (WhyInstruction *writer: function.vregTable.getWriters(*vreg))
+					mark(writer);
+	}
+
+	bool changed = false;
+	for (const BasicBlockPtr &block: function.blocks)
+		if (0 < std::erase_if(block->instructions, [&](const WhyPtr &instruction) {
+			return !live.contains(instruction.get());
+		}))
+			changed = true;
+
+	return changed;
+}
+
+bool DCE::run() {
+	bool changed = false;
+
+	if (removeUnreachable()) {
+		function.relinearize();
+		function.makeCFG();
+		function.updateVregs();
+		changed = true;
+	}
+
+	if (removeDead()) {
+		function.relinearize();
+		function.updateVregs();
+		changed = true;
+	}
+
+	if (changed)
+		for (const VregPtr &vreg: function.virtualRegisters)
+			if (function.isTracked(vreg))
+				function.vregTable.set(vreg);
+
+	return changed;
+}
@@ -0,0 +1,190 @@
+#include <stdexcept>
+#include <unordered_set>
+
+#include "DominatorTree.h"
+#include "Graph.h"
+
+DominatorTree::DominatorTree(const Graph &, Node &entry, bool post_): post(post_) {
+	// Find the nodes reachable from the entry. For post-dominators, the walk over the reversed graph then starts from
+	// the virtual exit and only follows edges within that set.
+	std::vector<Node *> reachable;
+	std::unordered_set<const Node *> seen {&entry};
+	{
+		std::vector<Node *> work {&entry};
+		while (!work.empty()) {
+			Node *node = work.back();
+			work.pop_back();
+			reachable.push_back(node);
+			for (Node *successor: node->out())
+				if (seen.insert(successor).second)
+					work.push_back(successor);
+		}
+	}
+
+	auto forward = [&](const Node &node) -> const Node::Set & { return post? node.in() : node.out(); };
+	auto backward = [&](const Node &node) -> const Node::Set & { return post? node.out() : node.in(); };
+
+	std::vector<Node *> starts;
+	if (post) {
+		for (Node *node: reachable)
+			if (node->out().empty())
+				starts.push_back(node);
+	} else
+		starts.push_back(&entry);
+
+	// Iterative postorder walk from the virtual root.
+	std::vector<Node *> postorder;
+	postorder.reserve(reachable.size());
+	std::unordered_set<const Node *> visited;
+	visited.reserve(reachable.size());
+	std::vector<std::pair<Node *, Node::Set::const_iterator>> stack;
+	for (Node *start: starts) {
+		if (!visited.insert(start).second)
+			continue;
+		stack.emplace_back(start, forward(*start).cbegin());
+		while (!stack.empty()) {
+			auto &[node, iter] = stack.back();
+			if (iter == forward(*node).cend()) {
+				postorder.push_back(node);
+				stack.pop_back();
+				continue;
+			}
+			Node *next = *iter++;
+			if (seen.contains(next) && visited.insert(next).second)
+				stack.emplace_back(next, forward(*next).cbegin());
+		}
+	}
+
+	const size_t count = postorder.size() + 1;
+	nodes.reserve(count);
+	nodes.push_back(nullptr);
+	nodes.insert(nodes.end(), postorder.rbegin(), postorder.rend());
+	ordered.assign(nodes.begin() + 1, nodes.end());
+	indices.reserve(count);
+	for (size_t i = 1; i < count; ++i)
+		indices.emplace(nodes[i], i);
+
+	predecessors.assign(count, {});
+	for (size_t i = 1; i < count; ++i) {
+		for (const Node *predecessor: backward(*nodes[i]))
+			if (const auto found = indices.find(predecessor); found != indices.end())
+				predecessors[i].push_back(found->second);
+		if (post? nodes[i]->out().empty() : nodes[i] == &entry)
+			predecessors[i].push_back(0);
+	}
+
+	idoms.assign(count, NONE);
+	idoms[0] = 0;
+
+	auto intersect = [&](size_t left, size_t right) {
+		while (left != right) {
+			while (right < left)
+				left = idoms[left];
+			while (left < right)
+				right = idoms[right];
+		}
+		return left;
+	};
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (size_t i = 1; i < count; ++i) {
+			size_t new_idom = NONE;
+			for (const size_t predecessor: predecessors[i])
+				if (idoms[predecessor] != NONE)
+					new_idom = new_idom == NONE? predecessor : intersect(predecessor, new_idom);
+			if (idoms[i] != new_idom) {
+				idoms[i] = new_idom;
+				changed = true;
+			}
+		}
+	}
+
+	childLists.assign(count, {});
+	for (size_t i = 1; i < count; ++i)
+		childLists[idoms[i]].push_back(nodes[i]);
+
+	preorder.assign(count, 0);
+	lastDescendant.assign(count, 0);
+	size_t next_number = 0;
+	std::vector<std::pair<size_t, size_t>> tree_stack {{0, 0}};
+	preorder[0] = next_number++;
+	while (!tree_stack.empty()) {
+		auto &[index, next_child] = tree_stack.back();
+		if (next_child < childLists[index].size()) {
+			const size_t child = indices.at(childLists[index][next_child++]);
+			preorder[child] = next_number++;
+			tree_stack.emplace_back(child, 0);
+			continue;
+		}
+		lastDescendant[index] = next_number - 1;
+		tree_stack.pop_back();
+	}
+}
+
+void DominatorTree::computeFrontiers() const {
+	const size_t count = nodes.size();
+
+	// A join point is in the frontier of everything on the tree path from each of its predecessors up to (but not
+	// including) its immediate dominator.
+	frontiers.assign(count, {});
+	std::vector<size_t> last_added(count, NONE);
+	for (size_t i = 1; i < count; ++i) {
+		if (predecessors[i].size() < 2)
+			continue;
+		for (const size_t predecessor: predecessors[i])
+			for (size_t runner = predecessor; runner != idoms[i]; runner = idoms[runner])
+				if (last_added[runner] != i) {
+					last_added[runner] = i;
+					frontiers[runner].push_back(nodes[i]);
+				}
+	}
+	frontiersComputed = true;
+}
+
+size_t DominatorTree::indexOf(const Node &node) const {
+	const auto found = indices.find(&node);
+	return found == indices.end()? NONE : found->second;
+}
+
+bool DominatorTree::contains(const Node &node) const {
+	return indices.contains(&node);
+}
+
+Node * DominatorTree::immediateDominator(const Node &node) const {
+	const size_t index = indexOf(node);
+	return index == NONE? nullptr : nodes[idoms[index]];
+}
+
+bool DominatorTree::dominates(const Node &dominator, const Node &node) const {
+	const size_t dominator_index = indexOf(dominator), node_index = indexOf(node);
+	if (dominator_index == NONE || node_index == NONE)
+		return false;
+	return preorder[dominator_index] <= preorder[node_index] &&
+		preorder[node_index] <= lastDescendant[dominator_index];
+}
+
+bool DominatorTree::strictlyDominates(const Node &dominator, const Node &node) const {
+	return &dominator != &node && dominates(dominator, node);
+}
+
+const std::vector<Node *> & DominatorTree::children(const Node &node) const {
+	const size_t index = indexOf(node);
+	if (index == NONE)
+		throw std::out_of_range("Node " + node.label() + " isn't in the dominator tree");
+	return childLists[index];
+}
+
+const std::vector<Node *> & DominatorTree::frontier(const Node &node) const {
+	const size_t index = indexOf(node);
+	if (index == NONE)
+		throw std::out_of_range("Node " + node.label() + " isn't in the dominator tree");
+	if (!frontiersComputed)
+		computeFrontiers();
+	return frontiers[index];
+}
+
+const std::vector<Node *> & DominatorTree::roots() const {
+	return childLists[0];
+}
@@ -13,6 +13,7 @@
 #include "Parser.h"
 #include "Program.h"
 #include "Scope.h"
+#include "StringSet.h"
 #include "WhyInstructions.h"
 
 static TypedImmediate makeAddress(const std::string &address) {
@@ -104,6 +105,25 @@ std::string stringify(const Expr *expr) {
 
 void Expr::compile(VregPtr, Function &, const Context &, size_t) {}
 
+std::unique_ptr<Type> Expr::getType(const Context &context) const {
+	return std::unique_ptr<Type>(getTypeRef(context).copy());
+}
+
+const Type & Expr::getTypeRef(const Context &context) const {
+	const Scope *scope = context.scope.get();
+	if (!cachedType || cachedGeneration != context.program->scopeGeneration || cachedScope != scope ||
+	    cachedProgram != context.program || cachedStructName != context.structName) {
+		// Type checking a node checks its whole subtree, so recomputing on every call makes nested expressions take
+		// time exponential in their depth.
+		cachedType = computeType(context);
+		cachedGeneration = context.program->scopeGeneration;
+		cachedScope = scope;
+		cachedProgram = context.program;
+		cachedStructName = context.structName;
+	}
+	return *cachedType;
+}
+
 Expr * Expr::setFunction(const Function &function) {
 	debug.mangledFunction = function.mangle();
 	return this;
@@ -193,17 +213,17 @@ Expr * Expr::get(const ASTNode &node, Function *function) {
 			break;
 		case CPMTOK_SIZEOF:
 			if (node.size() == 2)
-				out = new SizeofMemberExpr(*node.front()->text, *node.at(1)->text);
+				out = new SizeofMemberExpr(node.front()->text, *node.at(1)->text);
 			else
 				out = new SizeofExpr(TypePtr(Type::get(*node.front(), function->program)));
 			break;
 		case CPMTOK_OFFSETOF:
-			out = new OffsetofExpr(*node.front()->text, *node.at(1)->text);
+			out = new OffsetofExpr(node.front()->text, *node.at(1)->text);
 			break;
 		case CPMTOK_IDENT:
 			if (function == nullptr)
 				throw GenericError(node.location, "Variable expression encountered in functionless context");
-			out = new VariableExpr(*node.text);
+			out = new VariableExpr(node.text);
 			break;
 		case CPMTOK_LPAREN: {
 			std::vector<ExprPtr> arguments;
@@ -215,10 +235,10 @@ Expr * Expr::get(const ASTNode &node, Function *function) {
 				if (function == nullptr)
 					throw GenericError(node.location, "Cannot find struct in functionless context");
 
-				const std::string &struct_name = *node.front()->front()->text;
+				const std::string *struct_name = node.front()->front()->text;
 
 				if (function->program.structs.count(struct_name) == 0)
-					throw ResolutionError(struct_name, function->selfScope, node.location);
+					throw ResolutionError(*struct_name, function->selfScope, node.location);
 
 				auto struct_type = function->program.structs.at(struct_name);
 				const size_t stack_offset = function->stackUsage += struct_type->getSize();
@@ -401,15 +421,15 @@ Expr * Expr::get(const ASTNode &node, Function *function) {
 			std::vector<ExprPtr> exprs;
 			for (const ASTNode *child: node)
 				exprs.emplace_back(Expr::get(*child, function));
-			out = new InitializerExpr(std::move(exprs), node.attributes.count("constructor") != 0);
+			out = new InitializerExpr(std::move(exprs), node.hasAttribute(ASTNode::Attribute::Constructor));
 			break;
 		}
 		case CPMTOK_SCOPE:
-			out = new StaticFieldExpr(*node.front()->front()->text, *node.at(1)->text);
+			out = new StaticFieldExpr(node.front()->front()->text, *node.at(1)->text);
 			break;
 		default:
 			throw GenericError(node.location, "Unrecognized symbol in Expr::get: " +
-				std::string(cpmParser.getName(node.symbol)));
+				std::string(node.getName()));
 	}
 
 	if (function != nullptr)
@@ -461,18 +481,18 @@ std::optional<ssize_t> PlusExpr::evaluate(const Context &context) const {
 	return std::nullopt;
 }
 
-std::unique_ptr<Type> PlusExpr::getType(const Context &context) const {
+std::unique_ptr<Type> PlusExpr::computeType(const Context &context) const {
 	if (auto fnptr = getOperator(context))
 		return std::unique_ptr<Type>(fnptr->returnType->copy());
-	auto left_type  = left->getType(context);
-	auto right_type = right->getType(context);
-	if (left_type->isPointer() && right_type->isInt())
-		return left_type;
-	if (left_type->isInt() && right_type->isPointer())
-		return right_type;
-	if (!(*left_type && *right_type) || !(*right_type && *left_type))
-		throw ImplicitConversionError(*left_type, *right_type, getLocation());
-	return left_type;
+	const Type &left_type  = left->getTypeRef(context);
+	const Type &right_type = right->getTypeRef(context);
+	if (left_type.isPointer() && right_type.isInt())
+		return std::unique_ptr<Type>(left_type.copy());
+	if (left_type.isInt() && right_type.isPointer())
+		return std::unique_ptr<Type>(right_type.copy());
+	if (!(left_type && right_type) || !(right_type && left_type))
+		throw ImplicitConversionError(left_type, right_type, getLocation());
+	return std::unique_ptr<Type>(left_type.copy());
 }
 
 void MinusExpr::compile(VregPtr destination, Function &function, const Context &context, size_t multiplier) {
@@ -504,18 +524,18 @@ void MinusExpr::compile(VregPtr destination, Function &function, const Context &
 	}
 }
 
-std::unique_ptr<Type> MinusExpr::getType(const Context &context) const {
+std::unique_ptr<Type> MinusExpr::computeType(const Context &context) const {
 	if (auto fnptr = getOperator(context))
 		return std::unique_ptr<Type>(fnptr->returnType->copy());
-	auto left_type  = left->getType(context);
-	auto right_type = right->getType(context);
-	if (left_type->isPointer() && right_type->isInt())
-		return left_type;
-	if (left_type->isPointer() && right_type->isPointer())
+	const Type &left_type  = left->getTypeRef(context);
+	const Type &right_type = right->getTypeRef(context);
+	if (left_type.isPointer() && right_type.isInt())
+		return std::unique_ptr<Type>(left_type.copy());
+	if (left_type.isPointer() && right_type.isPointer())
 		return std::make_unique<SignedType>(64);
-	if (!(*left_type && *right_type) || !(*right_type && *left_type))
-		throw ImplicitConversionError(*left_type, *right_type, getLocation());
-	return left_type;
+	if (!(left_type && right_type) || !(right_type && left_type))
+		throw ImplicitConversionError(left_type, right_type, getLocation());
+	return std::unique_ptr<Type>(left_type.copy());
 }
 
 void MultExpr::compile(VregPtr destination, Function &function, const Context &context, size_t multiplier) {
@@ -566,7 +586,7 @@ void ShiftRightExpr::compile(VregPtr destination, Function &function, const Cont
 		VregPtr temp_var = function.newVar(TypePtr(left->getType(context)));
 		left->compile(temp_var, function, context, multiplier);
 		right->compile(destination, function, context, 1);
-		if (left->getType(context)->isUnsigned(0))
+		if (left->isUnsigned(context))
 			function.add<ShiftRightLogicalRInstruction>(temp_var, destination, destination)->setDebug(*this);
 		else
 			function.add<ShiftRightArithmeticRInstruction>(temp_var, destination, destination)->setDebug(*this);
@@ -581,7 +601,7 @@ std::optional<ssize_t> ShiftRightExpr::evaluate(const Context &context) const {
 	auto left_value  = left?  left->evaluate(context)  : std::nullopt;
 	auto right_value = right? right->evaluate(context) : std::nullopt;
 	if (left_value && right_value) {
-		if (left->getType(context)->isUnsigned(0))
+		if (left->isUnsigned(context))
 			return size_t(*left_value) << size_t(*right_value);
 		return *left_value << *right_value;
 	}
@@ -758,7 +778,7 @@ std::optional<ssize_t> DivExpr::evaluate(const Context &context) const {
 	auto left_value  = left?  left->evaluate(context)  : std::nullopt;
 	auto right_value = right? right->evaluate(context) : std::nullopt;
 	if (left_value && right_value) {
-		if (left->getType(context)->isUnsigned(0))
+		if (left->isUnsigned(context))
 			return size_t(*left_value) / size_t(*right_value);
 		return *left_value / *right_value;
 	}
@@ -786,7 +806,7 @@ std::optional<ssize_t> ModExpr::evaluate(const Context &context) const {
 	auto left_value  = left?  left->evaluate(context)  : std::nullopt;
 	auto right_value = right? right->evaluate(context) : std::nullopt;
 	if (left_value && right_value) {
-		if (left->getType(context)->isUnsigned(0))
+		if (left->isUnsigned(context))
 			return size_t(*left_value) % size_t(*right_value);
 		return *left_value % *right_value;
 	}
@@ -803,7 +823,7 @@ void NumberExpr::compile(VregPtr destination, Function &function, const Context
 	getSize();
 	if (!destination)
 		return;
-	destination->setType(*getType(context));
+	destination->setType(getTypeRef(context));
 	if (Util::inRange(multiplied)) {
 		function.add<SetIInstruction>(destination, immLikeReg(destination, int(multiplied)))->setDebug(*this);
 	} else {
@@ -870,7 +890,7 @@ size_t NumberExpr::getSize() const {
 	return size;
 }
 
-std::unique_ptr<Type> NumberExpr::getType(const Context &context) const {
+std::unique_ptr<Type> NumberExpr::computeType(const Context &context) const {
 	const size_t bits = getSize(context) * 8;
 	if (literal.find('u') != std::string::npos)
 		return std::make_unique<UnsignedType>(bits);
@@ -906,7 +926,7 @@ size_t VregExpr::getSize(const Context &) const {
 	return 8;
 }
 
-std::unique_ptr<Type> VregExpr::getType(const Context &) const {
+std::unique_ptr<Type> VregExpr::computeType(const Context &) const {
 	if (auto vreg_type = virtualRegister->getType())
 		return std::unique_ptr<Type>(vreg_type->copy());
 	return nullptr;
@@ -922,11 +942,11 @@ void VariableExpr::compile(VregPtr destination, Function &function, const Contex
 			throw NotOnStackError(var);
 		} else {
 			const size_t offset = function.stackOffsets.at(var);
-			function.addComment("Load variable " + name);
+			function.addComment("Load variable " + *name);
 			auto temp = function.newVar(PointerType::make(getType(context).release()));
 			function.add<SubIInstruction>(function.precolored(Why::framePointerOffset), temp, immLikeReg(temp, offset))
 				->setDebug(*this);
-			destination->setType(*getType(context));
+			destination->setType(getTypeRef(context));
 			function.add<LoadRInstruction>(temp, destination)->setDebug(*this);
 		}
 		if (multiplier != 1)
@@ -936,7 +956,7 @@ void VariableExpr::compile(VregPtr destination, Function &function, const Contex
 		function.add<SetIInstruction>(destination, TypedImmediate(OperandType::VOID_PTR, fn->mangle()))
 			->setDebug(*this);
 	} else
-		throw ResolutionError(name, context.scope, getLocation());
+		throw ResolutionError(*name, context.scope, getLocation());
 }
 
 bool VariableExpr::compileAddress(const VregPtr &destination, Function &function, const Context &context) {
@@ -949,12 +969,12 @@ bool VariableExpr::compileAddress(const VregPtr &destination, Function &function
 			throw NotOnStackError(var, getLocation());
 		} else {
 			const size_t offset = function.stackOffsets.at(var);
-			function.addComment("Get variable lvalue for " + name);
+			function.addComment("Get variable lvalue for " + *name);
 			if (var->getType()->isReference()) {
 				auto temp = function.newVar(destination->getType());
 				function.add<SubIInstruction>(function.precolored(Why::framePointerOffset), temp,
 					immLikeReg(temp, static_cast<int>(offset)))->setDebug(*this);
-				function.addComment("Load reference lvalue for " + name);
+				function.addComment("Load reference lvalue for " + *name);
 				function.add<LoadRInstruction>(temp, destination)->setDebug(*this);
 			} else {
 				function.add<SubIInstruction>(function.precolored(Why::framePointerOffset), destination,
@@ -964,7 +984,7 @@ bool VariableExpr::compileAddress(const VregPtr &destination, Function &function
 	} else if (const auto fn = context.scope->lookupFunction(name, getLocation())) {
 		function.add<SetIInstruction>(destination, makeAddress(fn->mangle()))->setDebug(*this);
 	} else
-		throw ResolutionError(name, context.scope, getLocation());
+		throw ResolutionError(*name, context.scope, getLocation());
 	return true;
 }
 
@@ -973,17 +993,17 @@ size_t VariableExpr::getSize(const Context &context) const {
 		return var->getSize();
 	if (context.scope->lookupFunction(name, nullptr, {}, "", getLocation()))
 		return Why::wordSize;
-	throw ResolutionError(name, context, getLocation());
+	throw ResolutionError(*name, context, getLocation());
 }
 
-std::unique_ptr<Type> VariableExpr::getType(const Context &context) const {
+std::unique_ptr<Type> VariableExpr::computeType(const Context &context) const {
 	if (VariablePtr var = context.scope->lookup(name))
 		return std::unique_ptr<Type>(var->getType()->copy()->setLvalue(true));
 	try {
 		if (const auto fn = context.scope->lookupFunction(name, nullptr, {}, context.structName, getLocation()))
 			return std::make_unique<FunctionPointerType>(*fn);
 	} catch (AmbiguousError &) {}
-	throw ResolutionError(name, context, getLocation());
+	throw ResolutionError(*name, context, getLocation());
 }
 
 void AddressOfExpr::compile(VregPtr destination, Function &function, const Context &context, size_t multiplier) {
@@ -1005,7 +1025,7 @@ void AddressOfExpr::compile(VregPtr destination, Function &function, const Conte
 	}
 }
 
-std::unique_ptr<Type> AddressOfExpr::getType(const Context &context) const {
+std::unique_ptr<Type> AddressOfExpr::computeType(const Context &context) const {
 	if (!subexpr->isLvalue(context))
 		throw LvalueError(std::string(*subexpr));
 	auto subexpr_type = subexpr->getType(context);
@@ -1027,11 +1047,11 @@ void NotExpr::compile(VregPtr destination, Function &function, const Context &co
 	}
 }
 
-std::unique_ptr<Type> NotExpr::getType(const Context &context) const {
-	auto type = subexpr->getType(context);
-	if (auto fnptr = context.program->getOperator({type.get()}, CPMTOK_TILDE, getLocation()))
+std::unique_ptr<Type> NotExpr::computeType(const Context &context) const {
+	const Type &type = subexpr->getTypeRef(context);
+	if (auto fnptr = context.program->getOperator({&type}, CPMTOK_TILDE, getLocation()))
 		return std::unique_ptr<Type>(fnptr->returnType->copy());
-	return type;
+	return std::unique_ptr<Type>(type.copy());
 }
 
 void LnotExpr::compile(VregPtr destination, Function &function, const Context &context, size_t multiplier) {
@@ -1047,9 +1067,8 @@ void LnotExpr::compile(VregPtr destination, Function &function, const Context &c
 	}
 }
 
-std::unique_ptr<Type> LnotExpr::getType(const Context &context) const {
-	auto type = subexpr->getType(context);
-	if (auto fnptr = context.program->getOperator({type.get()}, CPMTOK_NOT, getLocation()))
+std::unique_ptr<Type> LnotExpr::computeType(const Context &context) const {
+	if (auto fnptr = context.program->getOperator({&subexpr->getTypeRef(context)}, CPMTOK_NOT, getLocation()))
 		return std::unique_ptr<Type>(fnptr->returnType->copy());
 	return std::make_unique<BoolType>();
 }
@@ -1062,7 +1081,7 @@ void StringExpr::compile(VregPtr destination, Function &function, const Context
 			->setDebug(*this);
 }
 
-std::unique_ptr<Type> StringExpr::getType(const Context &) const {
+std::unique_ptr<Type> StringExpr::computeType(const Context &) const {
 	return std::make_unique<PointerType>((new UnsignedType(8))->setConst(true));
 }
 
@@ -1092,7 +1111,7 @@ size_t DerefExpr::getSize(const Context &context) const {
 	return dynamic_cast<PointerType &>(*type).subtype->getSize();
 }
 
-std::unique_ptr<Type> DerefExpr::getType(const Context &context) const {
+std::unique_ptr<Type> DerefExpr::computeType(const Context &context) const {
 	if (auto fnptr = getOperator(context))
 		return std::unique_ptr<Type>(fnptr->returnType->copy()->setLvalue(true));
 	auto type = checkType(context);
@@ -1122,8 +1141,7 @@ bool DerefExpr::compileAddress(const VregPtr &destination, Function &function, c
 }
 
 FunctionPtr DerefExpr::getOperator(const Context &context) const {
-	auto subexpr_type = subexpr->getType(context);
-	return context.program->getOperator({subexpr_type.get()}, CPMTOK_TIMES, getLocation());
+	return context.program->getOperator({&subexpr->getTypeRef(context)}, CPMTOK_TIMES, getLocation());
 }
 
 Expr * CallExpr::copy() const {
@@ -1294,8 +1312,10 @@ void CallExpr::compile(VregPtr destination, Function &fn, const Context &context
 	fn.add<CallPopPlaceholder>();
 
 	if (!found_return_type->isVoid() && destination) {
+		auto r0 = fn.precolored(Why::returnValueOffset);
+		r0->setType(*found_return_type);
 		if (multiplier == 1)
-			fn.add<MoveInstruction>(fn.precolored(Why::returnValueOffset), destination)->setDebug(*this);
+			fn.add<MoveInstruction>(r0, destination)->setDebug(*this);
 		else
 			fn.add<MultIInstruction>(fn.precolored(Why::returnValueOffset), destination, immLikeReg(destination,
 				static_cast<int>(multiplier)))->setDebug(*this);
@@ -1342,7 +1362,7 @@ CallExpr::operator std::string() const {
 	if (!structName.empty())
 		out << structName << "::";
 	if (auto *var_expr = subexpr->cast<VariableExpr>())
-		out << var_expr->name << '(';
+		out << *var_expr->name << '(';
 	else
 		out << '(' << *subexpr << ")(";
 	bool first = true;
@@ -1358,10 +1378,10 @@ CallExpr::operator std::string() const {
 }
 
 size_t CallExpr::getSize(const Context &context) const {
-	return getType(context)->getSize();
+	return getTypeRef(context).getSize();
 }
 
-std::unique_ptr<Type> CallExpr::getType(const Context &context) const {
+std::unique_ptr<Type> CallExpr::computeType(const Context &context) const {
 	Context subcontext(context);
 	subcontext.structName = getStructName(context);
 	if (auto fnptr = getOperator(subcontext))
@@ -1374,7 +1394,7 @@ std::unique_ptr<Type> CallExpr::getType(const Context &context) const {
 				return std::unique_ptr<Type>(fnptr->returnType->copy());
 			throw FunctionPointerError(std::string(*var->getType()));
 		}
-		throw ResolutionError(var_expr->name, subcontext, getLocation());
+		throw ResolutionError(*var_expr->name, subcontext, getLocation());
 	}
 	auto type = subexpr->getType(subcontext);
 	if (const auto *fnptr = type->cast<FunctionPointerType>())
@@ -1382,7 +1402,7 @@ std::unique_ptr<Type> CallExpr::getType(const Context &context) const {
 	throw FunctionPointerError(std::string(*type));
 }
 
-FunctionPtr HasArguments::findFunction(const std::string &name, const Context &context) const {
+FunctionPtr HasArguments::findFunction(const std::string *name, const Context &context) const {
 	Types arg_types;
 	arg_types.reserve(arguments.size());
 	for (const auto &expr: arguments)
@@ -1417,14 +1437,11 @@ std::string CallExpr::getStructName(const Context &context) const {
 
 FunctionPtr CallExpr::getOperator(const Context &context) const {
 	try {
-		std::vector<std::unique_ptr<Type>> unique_types;
-		unique_types.push_back(subexpr->getType(context));
+		std::vector<const Type *> types;
+		types.reserve(1 + arguments.size());
+		types.push_back(&subexpr->getTypeRef(context));
 		for (const auto &argument: arguments)
-			unique_types.push_back(argument->getType(context));
-		std::vector<Type *> types;
-		types.reserve(unique_types.size());
-		for (auto &unique_type: unique_types)
-			types.push_back(unique_type.get());
+			types.push_back(&argument->getTypeRef(context));
 		return context.program->getOperator(types, CPMTOK_LPAREN, getLocation());
 	} catch (ResolutionError &) {
 		return nullptr;
@@ -1448,7 +1465,7 @@ void AssignExpr::compile(VregPtr destination, Function &function, const Context
 		TypePtr right_type = right->getType(context);
 
 		if (!left->compileAddress(addr_var, function, context))
-			throw LvalueError(std::string(*left->getType(context)));
+			throw LvalueError(std::string(left->getTypeRef(context)));
 
 		if (destination)
 			destination->setType(*addr_var->getType());
@@ -1492,14 +1509,14 @@ void AssignExpr::compile(VregPtr destination, Function &function, const Context
 	}
 }
 
-std::unique_ptr<Type> AssignExpr::getType(const Context &context) const {
+std::unique_ptr<Type> AssignExpr::computeType(const Context &context) const {
 	if (auto fnptr = getOperator(context))
 		return std::unique_ptr<Type>(fnptr->returnType->copy());
-	auto left_type  = left->getType(context);
-	auto right_type = right->getType(context);
-	if (!(*right_type && *left_type))
-			throw ImplicitConversionError(*right_type, *left_type, getLocation());
-	return left_type;
+	const Type &left_type  = left->getTypeRef(context);
+	const Type &right_type = right->getTypeRef(context);
+	if (!(right_type && left_type))
+			throw ImplicitConversionError(right_type, left_type, getLocation());
+	return std::unique_ptr<Type>(left_type.copy());
 }
 
 std::optional<ssize_t> AssignExpr::evaluate(const Context &context) const {
@@ -1513,12 +1530,12 @@ bool AssignExpr::compileAddress(const VregPtr &destination, Function &function,
 void CastExpr::compile(VregPtr destination, Function &function, const Context &context, size_t multiplier) {
 	// TODO: operator overloading
 	subexpr->compile(destination, function, context, multiplier);
-	tryCast(*subexpr->getType(context), *targetType, destination, function, getLocation());
+	tryCast(subexpr->getTypeRef(context), *targetType, destination, function, getLocation());
 	if (destination)
 		destination->setType(*targetType);
 }
 
-std::unique_ptr<Type> CastExpr::getType(const Context &) const {
+std::unique_ptr<Type> CastExpr::computeType(const Context &) const {
 	return std::unique_ptr<Type>(targetType->copy());
 }
 
@@ -1551,13 +1568,13 @@ void AccessExpr::compile(VregPtr destination, Function &function, const Context
 	}
 }
 
-std::unique_ptr<Type> AccessExpr::getType(const Context &context) const {
+std::unique_ptr<Type> AccessExpr::computeType(const Context &context) const {
 	if (auto fnptr = getOperator(context))
 		return std::unique_ptr<Type>(fnptr->returnType->copy());
-	auto array_type = array->getType(context);
-	if (const auto *casted = array_type->cast<const ArrayType>())
+	const Type &array_type = array->getTypeRef(context);
+	if (const auto *casted = array_type.cast<const ArrayType>())
 		return std::unique_ptr<Type>(casted->subtype->copy());
-	if (const auto *casted = array_type->cast<const PointerType>()) {
+	if (const auto *casted = array_type.cast<const PointerType>()) {
 		if (const auto *subarray = casted->subtype->cast<const ArrayType>())
 			return std::unique_ptr<Type>(subarray->subtype->copy());
 		return std::unique_ptr<Type>(casted->subtype->copy());
@@ -1575,7 +1592,7 @@ bool AccessExpr::compileAddress(const VregPtr &destination, Function &function,
 	if (check(context)->isPointer())
 		array->compile(destination, function, context, 1);
 	else if (!array->compileAddress(destination, function, context))
-		throw LvalueError(std::string(*array->getType(context)));
+		throw LvalueError(std::string(array->getTypeRef(context)));
 	const auto element_size = getSize(context);
 	const auto subscript_value = subscript->evaluate(context);
 	if (subscript_value) {
@@ -1591,7 +1608,7 @@ bool AccessExpr::compileAddress(const VregPtr &destination, Function &function,
 		function.add<AddRInstruction>(destination, subscript_variable, destination)->setDebug(*this);
 	}
 	if (destination)
-		destination->setType(*array->getType(context));
+		destination->setType(array->getTypeRef(context));
 	return true;
 }
 
@@ -1614,9 +1631,8 @@ std::unique_ptr<Type> AccessExpr::check(const Context &context) {
 }
 
 FunctionPtr AccessExpr::getOperator(const Context &context) const {
-	auto array_type = array->getType(context);
-	auto subscript_type = subscript->getType(context);
-	return context.program->getOperator({array_type.get(), subscript_type.get()}, CPM_ACCESS, getLocation());
+	return context.program->getOperator({&array->getTypeRef(context), &subscript->getTypeRef(context)}, CPM_ACCESS,
+		getLocation());
 }
 
 void LengthExpr::compile(VregPtr destination, Function &function, const Context &context, size_t multiplier) {
@@ -1643,19 +1659,19 @@ void TernaryExpr::compile(VregPtr destination, Function &function, const Context
 	function.add<Label>(end);
 }
 
-std::unique_ptr<Type> TernaryExpr::getType(const Context &context) const {
-	auto condition_type = condition->getType(context);
-	if (!(*condition_type && BoolType()))
-		throw ImplicitConversionError(*condition_type, BoolType(), getLocation());
-	auto true_type  = ifTrue->getType(context);
-	auto false_type = ifFalse->getType(context);
-	if (!(*true_type && *false_type) || !(*false_type && *true_type))
-		throw ImplicitConversionError(*false_type, *true_type, getLocation());
-	return true_type;
+std::unique_ptr<Type> TernaryExpr::computeType(const Context &context) const {
+	const Type &condition_type = condition->getTypeRef(context);
+	if (!(condition_type && BoolType()))
+		throw ImplicitConversionError(condition_type, BoolType(), getLocation());
+	const Type &true_type  = ifTrue->getTypeRef(context);
+	const Type &false_type = ifFalse->getTypeRef(context);
+	if (!(true_type && false_type) || !(false_type && true_type))
+		throw ImplicitConversionError(false_type, true_type, getLocation());
+	return std::unique_ptr<Type>(true_type.copy());
 }
 
 size_t TernaryExpr::getSize(const Context &context) const {
-	return getType(context)->getSize();
+	return getTypeRef(context).getSize();
 }
 
 void DotExpr::compile(VregPtr destination, Function &function, const Context &context, size_t multiplier) {
@@ -1682,7 +1698,7 @@ void DotExpr::compile(VregPtr destination, Function &function, const Context &co
 		destination->setType(*field_type);
 }
 
-std::unique_ptr<Type> DotExpr::getType(const Context &context) const {
+std::unique_ptr<Type> DotExpr::computeType(const Context &context) const {
 	auto struct_type = checkType(context);
 	const auto &map = struct_type->getMap();
 	if (map.count(ident) == 0)
@@ -1741,7 +1757,7 @@ void ArrowExpr::compile(VregPtr destination, Function &function, const Context &
 		function.add<MultIInstruction>(destination, destination, immLikeReg(destination, multiplier))->setDebug(*this);
 }
 
-std::unique_ptr<Type> ArrowExpr::getType(const Context &context) const {
+std::unique_ptr<Type> ArrowExpr::computeType(const Context &context) const {
 	auto struct_type = checkType(context);
 	const auto &map = struct_type->getMap();
 	if (map.count(ident) == 0)
@@ -1792,7 +1808,7 @@ std::optional<ssize_t> OffsetofExpr::evaluate(const Context &context) const {
 	auto type = context.scope->lookupType(structName);
 	StructType *struct_type = nullptr;
 	if (!type || (struct_type = type->cast<StructType>()) == nullptr)
-		throw GenericError(getLocation(), "Unknown or incomplete struct in offsetof expression: " + structName);
+		throw GenericError(getLocation(), "Unknown or incomplete struct in offsetof expression: " + *structName);
 	ssize_t offset = 0;
 	bool found = false;
 	for (const auto &[field_name, field_type]: struct_type->getOrder()) {
@@ -1803,7 +1819,7 @@ std::optional<ssize_t> OffsetofExpr::evaluate(const Context &context) const {
 		offset += ssize_t(field_type->getSize());
 	}
 	if (!found)
-		throw GenericError(getLocation(), "Struct " + structName + " has no field " + fieldName);
+		throw GenericError(getLocation(), "Struct " + *structName + " has no field " + fieldName);
 	return offset;
 }
 
@@ -1816,10 +1832,10 @@ std::optional<ssize_t> SizeofMemberExpr::evaluate(const Context &context) const
 	auto type = context.scope->lookupType(structName);
 	StructType *struct_type = nullptr;
 	if (!type || (struct_type = type->cast<StructType>()) == nullptr)
-		throw GenericError(getLocation(), "Unknown or incomplete struct in sizeof expression: " + structName);
+		throw GenericError(getLocation(), "Unknown or incomplete struct in sizeof expression: " + *structName);
 	const auto &map = struct_type->getMap();
 	if (map.count(fieldName) == 0)
-		throw GenericError(getLocation(), "Struct " + structName + " has no field " + fieldName);
+		throw GenericError(getLocation(), "Struct " + *structName + " has no field " + fieldName);
 	return map.at(fieldName)->getSize();
 }
 
@@ -1835,7 +1851,7 @@ Expr * InitializerExpr::copy() const {
 	return (new InitializerExpr(children_copy, isConstructor))->setDebug(debug);
 }
 
-std::unique_ptr<Type> InitializerExpr::getType(const Context &context) const {
+std::unique_ptr<Type> InitializerExpr::computeType(const Context &context) const {
 	return std::make_unique<InitializerType>(children, context);
 }
 
@@ -1875,7 +1891,7 @@ void ConstructorExpr::compile(VregPtr destination, Function &function, const Con
 		throw GenericError(getLocation(), "Cannot multiply in ConstructorExpr");
 
 	Context subcontext(context);
-	subcontext.structName = structName;
+	subcontext.structName = *structName;
 	int argument_offset = Why::argumentOffset;
 
 	const size_t registers_used = 1 + arguments.size();
@@ -1889,7 +1905,7 @@ void ConstructorExpr::compile(VregPtr destination, Function &function, const Con
 
 	auto looked_up = subcontext.scope->lookupType(structName);
 	if (!looked_up)
-		throw ResolutionError(structName, subcontext, getLocation());
+		throw ResolutionError(*structName, subcontext, getLocation());
 
 	auto struct_type = looked_up->ptrcast<StructType>();
 	auto this_var = function.precolored(argument_offset++);
@@ -1900,10 +1916,10 @@ void ConstructorExpr::compile(VregPtr destination, Function &function, const Con
 	FunctionPtr found = findFunction(subcontext);
 
 	if (!found)
-		throw GenericError(getLocation(), "Constructor for " + structName + " not found.");
+		throw GenericError(getLocation(), "Constructor for " + *structName + " not found.");
 
 	if (found->argumentCount() != arguments.size())
-		throw GenericError(getLocation(), "Invalid number of arguments in call to " + structName + " constructor at " +
+		throw GenericError(getLocation(), "Invalid number of arguments in call to " + *structName + " constructor at " +
 			std::string(getLocation()) + ": " + std::to_string(arguments.size()) + " (expected " +
 			std::to_string(found->argumentCount()) + ")");
 
@@ -1946,7 +1962,7 @@ void ConstructorExpr::compile(VregPtr destination, Function &function, const Con
 
 ConstructorExpr::operator std::string() const {
 	std::stringstream out;
-	out << '%' << structName << '(';
+	out << '%' << *structName << '(';
 	bool first = true;
 	for (const auto &argument: arguments) {
 		if (first)
@@ -1960,20 +1976,21 @@ ConstructorExpr::operator std::string() const {
 }
 
 size_t ConstructorExpr::getSize(const Context &context) const {
-	return getType(context)->getSize();
+	return getTypeRef(context).getSize();
 }
 
-std::unique_ptr<Type> ConstructorExpr::getType(const Context &context) const {
+std::unique_ptr<Type> ConstructorExpr::computeType(const Context &context) const {
 	return std::make_unique<PointerType>(context.scope->lookupType(structName)->copy());
 }
 
 FunctionPtr ConstructorExpr::findFunction(const Context &context) const {
-	return HasArguments::findFunction("$c", context);
+	static const std::string *constructor_name = StringSet::intern("$c");
+	return HasArguments::findFunction(constructor_name, context);
 }
 
-static std::string newVariableName(const std::map<std::string, VariablePtr> &map) {
+static const std::string * newVariableName(const std::unordered_map<const std::string *, VariablePtr> &map) {
 	for (size_t n = map.size();; ++n) {
-		std::string variable_name = "!t" + std::to_string(n);
+		const std::string *variable_name = StringSet::intern("!t" + std::to_string(n));
 		if (map.count(variable_name) == 0)
 			return variable_name;
 	}
@@ -1982,19 +1999,19 @@ static std::string newVariableName(const std::map<std::string, VariablePtr> &map
 ConstructorExpr * ConstructorExpr::addToScope(const Context &context) {
 	auto type = context.scope->lookupType(structName);
 	if (!type)
-		throw ResolutionError(structName, Context(*context.program, context.scope, structName), getLocation());
+		throw ResolutionError(*structName, Context(*context.program, context.scope, *structName), getLocation());
 
 	if (auto *function_scope = context.scope->cast<FunctionScope>()) {
 		Function &function = function_scope->function;
-		const std::string variable_name = newVariableName(function.variables);
-		auto variable = Variable::make(variable_name, type, function);
+		const std::string *variable_name = newVariableName(function.variables);
+		auto variable = Variable::make(*variable_name, type, function);
 		function.variableOrder.push_back(variable);
 		function.variables.emplace(variable_name, variable);
 		function.stackOffsets.emplace(variable, stackOffset);
 	} else if (auto *block_scope = context.scope->cast<BlockScope>()) {
 		Function &function = block_scope->getFunction();
-		const std::string variable_name = newVariableName(block_scope->variables);
-		auto variable = Variable::make(variable_name, type, function);
+		const std::string *variable_name = newVariableName(block_scope->variables);
+		auto variable = Variable::make(*variable_name, type, function);
 		block_scope->variableOrder.push_back(variable);
 		block_scope->variables.emplace(variable_name, variable);
 		function.stackOffsets.emplace(variable, stackOffset);
@@ -2117,7 +2134,7 @@ size_t NewExpr::getSize(const Context &) const {
 	return type->getSize();
 }
 
-std::unique_ptr<Type> NewExpr::getType(const Context &) const {
+std::unique_ptr<Type> NewExpr::computeType(const Context &) const {
 	return std::make_unique<PointerType>(type->copy());
 }
 
@@ -2126,11 +2143,12 @@ FunctionPtr NewExpr::findFunction(const Context &context) const {
 	arg_types.reserve(arguments.size());
 	for (const auto &expr: arguments)
 		arg_types.push_back(expr->getType(context));
-	return context.scope->lookupFunction("$c", arg_types, context.structName, getLocation());
+	static const std::string *constructor_name = StringSet::intern("$c");
+	return context.scope->lookupFunction(constructor_name, arg_types, context.structName, getLocation());
 }
 
-StaticFieldExpr::StaticFieldExpr(std::string struct_name, std::string field_name):
-	structName(std::move(struct_name)), fieldName(std::move(field_name)) {}
+StaticFieldExpr::StaticFieldExpr(const std::string *struct_name, std::string field_name):
+	structName(struct_name), fieldName(std::move(field_name)) {}
 
 Expr * StaticFieldExpr::copy() const {
 	return (new StaticFieldExpr(structName, fieldName))->setDebug(debug);
@@ -2151,24 +2169,24 @@ bool StaticFieldExpr::compileAddress(const VregPtr &destination, Function &funct
 }
 
 StaticFieldExpr::operator std::string() const {
-	return "%" + structName + "::" + fieldName;
+	return "%" + *structName + "::" + fieldName;
 }
 
 size_t StaticFieldExpr::getSize(const Context &context) const {
-	return getType(context)->getSize();
+	return getTypeRef(context).getSize();
 }
 
-std::unique_ptr<Type> StaticFieldExpr::getType(const Context &context) const {
+std::unique_ptr<Type> StaticFieldExpr::computeType(const Context &context) const {
 	const auto &statics = getStruct(context)->getStatics();
 	if (statics.count(fieldName) == 0)
-		throw ResolutionError(fieldName, Context(*context.program, context.scope, structName), getLocation());
+		throw ResolutionError(fieldName, Context(*context.program, context.scope, *structName), getLocation());
 	return std::unique_ptr<Type>(statics.at(fieldName)->copy());
 }
 
 std::shared_ptr<StructType> StaticFieldExpr::getStruct(const Context &context) const {
 	auto type = context.scope->lookupType(structName);
 	if (!type)
-		throw ResolutionError(structName, context.scope, getLocation());
+		throw ResolutionError(*structName, context.scope, getLocation());
 	if (auto struct_type = type->ptrcast<StructType>())
 		return struct_type;
 	throw NotStructError(type, getLocation());
@@ -2177,6 +2195,6 @@ std::shared_ptr<StructType> StaticFieldExpr::getStruct(const Context &context) c
 std::string StaticFieldExpr::mangle(const Context &context) const {
 	const auto &statics = getStruct(context)->getStatics();
 	if (statics.count(fieldName) == 0)
-		throw ResolutionError(fieldName, Context(*context.program, context.scope, structName), getLocation());
-	return Util::mangleStaticField(structName, statics.at(fieldName), fieldName);
+		throw ResolutionError(fieldName, Context(*context.program, context.scope, *structName), getLocation());
+	return Util::mangleStaticField(*structName, statics.at(fieldName), fieldName);
 }
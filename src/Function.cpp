@@ -1,17 +1,26 @@
+#include <algorithm>
 #include <iostream>
 
 #include "ASTNode.h"
 #include "Casting.h"
 #include "ColoringAllocator.h"
+#include "DCE.h"
 #include "Errors.h"
 #include "Expr.h"
 #include "Function.h"
 #include "Lexer.h"
+#include "LinearScanAllocator.h"
 #include "Parser.h"
+#include "Pass.h"
 #include "Program.h"
+#include "SCCP.h"
+#include "SSA.h"
 #include "Scope.h"
+#include "StringSet.h"
+#include "TimeReport.h"
 #include "Util.h"
 #include "WhyInstructions.h"
+#include "Writer.h"
 #include "wasm/Nodes.h"
 
 #define DEBUG_SPILL
@@ -29,17 +38,15 @@ program(program_), source(source_), selfScope(FunctionScope::make(*this, GlobalS
 	if (source != nullptr) {
 		if (source->symbol == CPMTOK_PLUS) { // Constructor
 			attributes.insert(Attribute::Constructor);
-			const std::string &struct_name = *source->at(0)->text;
+			const std::string *struct_name = source->at(0)->text;
 			if (program.structs.count(struct_name) == 0)
-				throw GenericError(source->location, "Can't define constructor for " + struct_name +
+				throw GenericError(source->location, "Can't define constructor for " + *struct_name +
 					": struct not defined");
-			auto struct_type = program.structs.at(struct_name);
 			name = "$c";
-			returnType = StructType::make(program, struct_name);
+			returnType = StructType::make(program, *struct_name);
 		} else if (source->symbol == CPM_CONSTRUCTORDECL) {
 			attributes.insert(Attribute::Constructor);
-			const std::string &struct_name = source->map.at("StructName");
-			auto struct_type = program.structs.at(struct_name);
+			const std::string &struct_name = *source->structName;
 			name = "$c";
 			returnType = StructType::make(program, struct_name);
 		} else if (isOperator()) {
@@ -50,10 +57,10 @@ program(program_), source(source_), selfScope(FunctionScope::make(*this, GlobalS
 			returnType = TypePtr(Type::get(*source->front(), program));
 		}
 
-		if (source->attributes.count("constructor") != 0)
+		if (source->hasAttribute(ASTNode::Attribute::Constructor))
 			attributes.insert(Attribute::Constructor);
 
-		if (source->attributes.count("destructor") != 0)
+		if (source->hasAttribute(ASTNode::Attribute::Destructor))
 			attributes.insert(Attribute::Destructor);
 
 		if (source->symbol == CPM_CONSTRUCTORDECL)
@@ -87,10 +94,25 @@ std::vector<std::string> Function::stringify(const std::map<DebugData, size_t> &
 	return out;
 }
 
-std::string Function::mangle() const {
+void Function::emit(Writer &writer, const std::map<DebugData, size_t> &debug_map) const {
+	for (const auto &instruction: instructions) {
+		const bool debug = instruction->debug && instruction->enableDebug();
+		for (const std::string &line: std::vector<std::string>(*instruction)) {
+			writer << '\t' << line;
+			if (debug)
+				writer << " !" << debug_map.at(instruction->debug);
+			writer << '\n';
+		}
+	}
+}
+
+const std::string & Function::mangle() const {
 	if (!structParent && (name == "main" || isBuiltin()))
 		return name;
 
+	if (!mangledName.empty())
+		return mangledName;
+
 	std::stringstream out;
 
 	if (structParent) {
@@ -106,11 +128,12 @@ std::string Function::mangle() const {
 		if (argument != "this")
 			out << argumentMap.at(argument)->getType()->mangle();
 
-	return out.str();
+	return mangledName = out.str();
 }
 
 void Function::extractArguments() {
 	arguments.clear();
+	mangledName.clear();
 	argumentMap.clear();
 	if (source == nullptr)
 		return;
@@ -129,15 +152,16 @@ void Function::extractArguments() {
 		VariablePtr argument = Variable::make(argument_name, type, *this);
 		argument->init();
 		argumentMap.emplace(argument_name, argument);
-		if (selfScope->doesConflict(argument_name))
+		if (selfScope->doesConflict(child->text))
 			throw NameConflictError(argument_name);
-		variables.emplace(argument_name, argument);
+		variables.emplace(child->text, argument);
 		variableOrder.push_back(argument);
 	}
 }
 
 void Function::setArguments(const std::vector<std::pair<std::string, TypePtr>> &args) {
 	arguments.clear();
+	mangledName.clear();
 	argumentMap.clear();
 	int i = 0;
 	for (const auto &[argument_name, type]: args) {
@@ -150,9 +174,10 @@ void Function::setArguments(const std::vector<std::pair<std::string, TypePtr>> &
 		} else
 			throw GenericError(getLocation(), "Functions with greater than " + std::to_string(Why::argumentCount) +
 				" arguments are currently unsupported.");
-		if (selfScope->doesConflict(argument_name))
+		const std::string *interned = StringSet::intern(argument_name);
+		if (selfScope->doesConflict(interned))
 			throw NameConflictError(argument_name);
-		variables.emplace(argument_name, argument);
+		variables.emplace(interned, argument);
 		variableOrder.push_back(argument);
 		++i;
 	}
@@ -165,6 +190,12 @@ size_t Function::argumentCount() const {
 }
 
 void Function::compile() {
+	lower();
+	finalize();
+}
+
+void Function::lower() {
+	TimeReport::Timer timer(TimeReport::Phase::Lower);
 	const bool is_init = name == ".init";
 
 	DebugData default_debug = source != nullptr?
@@ -182,10 +213,11 @@ void Function::compile() {
 		if (isOperator());
 		else if (size == 5 || size == 6) {
 			const std::string &struct_name = *source->at(4)->text;
-			if (program.structs.count(struct_name) == 0)
+			const auto struct_iter = program.structs.find(source->at(4)->text);
+			if (struct_iter == program.structs.end())
 				throw GenericError(getLocation(), "Couldn't find struct " + struct_name + " for function " + struct_name
 					+ "::" + name);
-			structParent = program.structs.at(struct_name);
+			structParent = struct_iter->second;
 		} else if (size != 4)
 			throw GenericError(getLocation(), "Expected 4–6 nodes in " + name + "'s source node, found " +
 				std::to_string(size));
@@ -193,13 +225,16 @@ void Function::compile() {
 		if (!isNaked()) {
 			int i = 0;
 			if (!arguments.empty()) {
-				VregPtr temp_var = newVar();
 				VregPtr fp = precolored(Why::framePointerOffset);
-				temp_var->setType(VoidType());
 				for (const std::string &argument_name: arguments) {
 					VariablePtr argument = argumentMap.at(argument_name);
 					const size_t offset = addToStack(argument);
-					add<MoveInstruction>(precolored(Why::argumentOffset + i++), argument)->setDebug(default_debug);
+					// Each argument gets its own address vreg so that promoteLocals() can tell the slots apart.
+					VregPtr temp_var = newVar();
+					temp_var->setType(VoidType());
+					auto argument_register = precolored(Why::argumentOffset + i++);
+					argument_register->setType(*argument->getType());
+					add<MoveInstruction>(argument_register, argument)->setDebug(default_debug);
 					add<SubIInstruction>(fp, temp_var, immLikeReg(temp_var, offset))->setDebug(default_debug);
 					add<StoreRInstruction>(argument, temp_var)->setDebug(default_debug);
 				}
@@ -210,23 +245,50 @@ void Function::compile() {
 			compile(*child, "", "", currentScope());
 	}
 
-	if (!isNaked()) {
-		if (!is_init) {
-			add<Label>("." + mangle() + ".e");
-			closeScope();
-		}
+	if (!isNaked() && !is_init) {
+		add<Label>("." + mangle() + ".e");
+		closeScope();
+	}
+}
+
+void Function::finalize() {
+	const bool is_init = name == ".init";
+
+	if (!is_init && isBuiltin())
+		return;
 
+	DebugData default_debug = source != nullptr?
+		DebugData(source->location, *this) : DebugData(ASTLocation(0, 0), *this);
+
+	if (!isNaked()) {
+		const std::vector<VregPtr> promoted = promoteLocals();
 		extractBlocks();
 		split();
 		updateVregs();
 		makeCFG();
 		computeLiveness();
-		ColoringAllocator allocator(*this);
+		initializePromoted(promoted, default_debug);
+		optimize();
+		usedLinearScan = program.allocatorChoice == AllocatorChoice::LinearScan ||
+			(program.allocatorChoice == AllocatorChoice::Auto && LinearScanAllocator::prefers(*this));
+		rematerializedCount = 0;
+		std::unique_ptr<Allocator> allocator;
+		if (usedLinearScan)
+			allocator = std::make_unique<LinearScanAllocator>(*this);
+		else
+			allocator = std::make_unique<ColoringAllocator>(*this, program.interferenceMode);
 		Allocator::Result result = Allocator::Result::NotSpilled;
-		do
-			result = allocator.attempt();
-		while (result != Allocator::Result::Success);
+		do {
+			TimeReport::Timer timer(TimeReport::Phase::Allocate);
+			result = allocator->attempt();
+		} while (result != Allocator::Result::Success);
+		blockCount = blocks.size();
+		// Rematerializations are counted separately from spills to the stack.
+		spillCount = allocator->getSpillCount() - rematerializedCount;
+		allocationAttempts = allocator->getAttempts();
+		coalescedMoves = allocator->getCoalescedCount();
 		replacePlaceholders();
+		removedMoves = removeRedundantMoves();
 
 		auto rt = precolored(Why::returnAddressOffset);
 		rt->setType(PointerType(new VoidType));
@@ -279,7 +341,7 @@ std::set<int> Function::usedGPRegisters() const {
 }
 
 VregPtr Function::newVar(const TypePtr &type) {
-	return std::make_shared<VirtualRegister>(*this, type)->init();
+	return registerPool.emplace_back(*this, type).init();
 }
 
 std::shared_ptr<BlockScope> Function::newScope(const std::string &name_, int *id_out) {
@@ -292,7 +354,7 @@ std::shared_ptr<BlockScope> Function::newScope(const std::string &name_, int *id
 }
 
 VregPtr Function::precolored(int reg, bool bypass) {
-	auto out = std::make_shared<VirtualRegister>(*this)->init();
+	VregPtr out = registerPool.emplace_back(*this).init();
 	out->setReg(reg, bypass);
 	out->setType(VoidType());
 	out->precolored = true;
@@ -312,7 +374,7 @@ void Function::compile(const ASTNode &node, const std::string &break_label, cons
 		case CPM_DECL: {
 			checkNaked(node);
 			const std::string &var_name = *node.at(1)->text;
-			if (currentScope()->doesConflict(var_name))
+			if (currentScope()->doesConflict(node.at(1)->text))
 				throw NameConflictError(var_name, node.at(1)->location);
 			VariablePtr variable = Variable::make(var_name, TypePtr(Type::get(*node.at(0), program)), *this);
 			variable->init();
@@ -346,7 +408,7 @@ void Function::compile(const ASTNode &node, const std::string &break_label, cons
 							throw NotStructError(variable->getType(), node.location);
 						auto *constructor_expr = new VariableExpr("$c");
 						auto call = std::make_unique<CallExpr>(constructor_expr, initializer->children);
-						call->structExpr = std::make_unique<VariableExpr>(var_name);
+						call->structExpr = std::make_unique<VariableExpr>(node.at(1)->text);
 						call->structExpr->setLocation(node.at(2)->location);
 						call->structExpr->setFunction(*this);
 						call->setLocation(call->structExpr->getLocation());
@@ -372,9 +434,10 @@ void Function::compile(const ASTNode &node, const std::string &break_label, cons
 				if (offset == 0) {
 					add<StoreRInstruction>(variable, fp)->setDebug({node.location, *this});
 				} else {
-					VregPtr m0 = mx(0);
-					add<SubIInstruction>(fp, m0, makeVoid(offset))->setDebug({node.location, *this});
-					add<StoreRInstruction>(variable, m0)->setDebug({node.location, *this});
+					VregPtr address = newVar();
+					address->setType(VoidType());
+					add<SubIInstruction>(fp, address, makeVoid(offset))->setDebug({node.location, *this});
+					add<StoreRInstruction>(variable, address)->setDebug({node.location, *this});
 				}
 			}
 			break;
@@ -523,13 +586,11 @@ void Function::compile(const ASTNode &node, const std::string &break_label, cons
 			break;
 		}
 		case CPMTOK_ASM: {
-			wasmParser.errorCount = 0;
 			const std::string wasm_source = node.front()->unquote();
-			wasmLexer.location = ASTLocation();
-			wasmParser.in(wasm_source);
-			wasmParser.debug(false, false);
-			wasmParser.parse();
-			if (wasmParser.errorCount != 0 || wasmLexer.failed) {
+			Parser wasm_parser(Parser::Type::Wasm);
+			wasm_parser.in(wasm_source);
+			wasm_parser.parse();
+			if (wasm_parser.errorCount != 0 || wasm_parser.lexer.failed) {
 				std::cerr << "\e[31mWASM parsing failed for ASM node at " << node.location << "\e[39m\n";
 				std::cerr << "\e[31mFull text: [\e[1m" << wasm_source << "\e[22m]\e[39m\n";
 			} else {
@@ -566,11 +627,11 @@ void Function::compile(const ASTNode &node, const std::string &break_label, cons
 					}
 				}
 
-				for (ASTNode *child: *wasmParser.root)
+				for (ASTNode *child: *wasm_parser.root)
 					if (auto *wasm_node = dynamic_cast<WASMInstructionNode *>(child)) {
 						WhyPtr converted = wasm_node->convert(*this, map);
 						converted->setDebug({node.location, *this});
-						instructions.push_back(converted);
+						converted->functionPosition = instructions.insert(instructions.end(), converted);
 					}
 
 				if (!out_exprs.empty()) {
@@ -583,7 +644,6 @@ void Function::compile(const ASTNode &node, const std::string &break_label, cons
 					}
 				}
 			}
-			wasmParser.done();
 			break;
 		}
 		case CPMTOK_DELETE: {
@@ -631,25 +691,51 @@ void Function::compile(const ASTNode &node, const std::string &break_label, cons
 	}
 }
 
+/** Returns whether an instruction is a branch that isn't a call. */
+static bool endsBlock(const WhyInstruction &instruction) {
+	if (const auto *conditional = instruction.cast<JumpConditionalInstruction>())
+		return !conditional->link;
+	if (const auto *conditional = instruction.cast<JumpRegisterConditionalInstruction>())
+		return !conditional->link;
+	if (const auto *jump = instruction.cast<JumpInstruction>())
+		return !jump->link;
+	return false;
+}
+
 std::list<BasicBlockPtr> & Function::extractBlocks(std::map<std::string, BasicBlockPtr> *map_out) {
+	TimeReport::Timer timer(TimeReport::Phase::ExtractBlocks);
 	std::map<std::string, BasicBlockPtr> map;
 	std::unordered_set<std::string> found_labels;
 	blocks.clear();
 	anons = 0;
 
 	BasicBlockPtr current = BasicBlock::make(*this, mangle());
+	bool anonymous = false;
 
 	for (const auto &instruction: instructions) {
 		const bool is_label = instruction->is<Label>();
 
 		if (is_label) {
 			const auto label = instruction->ptrcast<Label>();
-			blocks.push_back(current);
-			map.emplace(current->label, current);
+			// The anonymous block started after a branch is dropped if a label follows right away.
+			if (!anonymous || *current) {
+				blocks.push_back(current);
+				map.emplace(current->label, current);
+			}
 			current = BasicBlock::make(*this, label->name);
+			anonymous = false;
 		}
 
 		*current += instruction;
+
+		// A branch ends its block. Otherwise liveness would think that a value defined after a conditional branch but
+		// read at its target is dead across the branch, and code after an unconditional branch would look reachable.
+		if (endsBlock(*instruction)) {
+			blocks.push_back(current);
+			map.emplace(current->label, current);
+			current = BasicBlock::make(*this, "." + mangle() + ".anon." + std::to_string(anons++));
+			anonymous = true;
+		}
 	}
 
 	if (*current && map.count(current->label) == 0) {
@@ -687,6 +773,14 @@ std::list<BasicBlockPtr> & Function::extractBlocks(std::map<std::string, BasicBl
 		}
 	}
 
+	for (auto iter = blocks.begin(), end = blocks.end(); iter != end; ++iter) {
+		auto next = std::next(iter);
+		if (next != end && (*iter)->fallsThrough()) {
+			(*next)->predecessors.insert(*iter);
+			(*iter)->successors.insert(*next);
+		}
+	}
+
 	if (map_out != nullptr)
 		*map_out = std::move(map);
 
@@ -694,14 +788,19 @@ std::list<BasicBlockPtr> & Function::extractBlocks(std::map<std::string, BasicBl
 }
 
 void Function::relinearize(const std::list<BasicBlockPtr> &block_vec) {
+	for (const auto &instruction: instructions)
+		instruction->functionPosition.reset();
 	instructions.clear();
 	int last_index = -1;
 	for (const auto &block: block_vec)
-		for (auto &instruction: block->instructions) {
-			instructions.push_back(instruction);
+		for (auto iter = block->instructions.begin(), end = block->instructions.end(); iter != end; ++iter) {
+			const WhyPtr &instruction = *iter;
+			instruction->functionPosition = instructions.insert(instructions.end(), instruction);
+			instruction->blockPosition = iter;
 			instruction->parent = block;
 			instruction->index = ++last_index;
 		}
+	indicesStale = false;
 }
 
 void Function::relinearize() {
@@ -712,9 +811,20 @@ void Function::reindex() {
 	int last_index = -1;
 	for (auto &instruction: instructions)
 		instruction->index = ++last_index;
+	indicesStale = false;
+}
+
+int Function::getIndex(const WhyPtr &instruction) {
+	if (indicesStale)
+		reindex();
+	return instruction->index;
 }
 
 int Function::split(std::map<std::string, BasicBlockPtr> *map) {
+	TimeReport::Timer timer(TimeReport::Phase::Split);
+	if (program.interferenceMode != InterferenceMode::BlockCliques)
+		return 0;
+
 	bool changed = false;
 	int count = 0;
 	do {
@@ -727,8 +837,9 @@ int Function::split(std::map<std::string, BasicBlockPtr> *map) {
 				BasicBlockPtr new_block = BasicBlock::make(*this, "." + mangle() + ".anon." + std::to_string(anons++));
 
 				for (size_t i = 0, to_remove = block->instructions.size() / 2; i < to_remove; ++i) {
-					new_block->instructions.push_front(block->instructions.back());
-					block->instructions.pop_back();
+					new_block->instructions.splice(new_block->instructions.begin(), block->instructions,
+						std::prev(block->instructions.end()));
+					new_block->instructions.front()->parent = new_block;
 				}
 
 				if (map != nullptr)
@@ -764,78 +875,369 @@ int Function::split(std::map<std::string, BasicBlockPtr> *map) {
 }
 
 void Function::computeLiveness() {
+	TimeReport::Timer timer(TimeReport::Phase::Liveness);
+	const size_t vreg_count = size_t(nextVariable);
+	vregTable.clearVregs(vreg_count);
+	for (const auto &vreg: virtualRegisters)
+		if (isTracked(vreg))
+			vregTable.set(vreg);
+
+	std::vector<BasicBlock *> order;
+	std::unordered_map<const BasicBlock *, size_t> positions;
+	order.reserve(blocks.size());
 	for (auto &block: blocks) {
-		block->liveIn.clear();
-		block->liveOut.clear();
+		block->computeUsesAndDefs();
+		block->liveIn = block->uses;
+		block->liveOut = Bitset(vreg_count);
+		positions.emplace(block.get(), order.size());
+		order.push_back(block.get());
 	}
 
-	for (auto &block: blocks) {
-		block->cacheReadWritten();
-		for (const auto &vreg: block->readCache)
-			upAndMark(block, vreg);
+	// Liveness flows backward, so visiting blocks in reverse order first settles most functions in one pass.
+	std::vector<size_t> worklist;
+	std::vector<bool> queued(order.size(), true);
+	worklist.reserve(order.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		worklist.push_back(i);
+
+	while (!worklist.empty()) {
+		BasicBlock &block = *order[worklist.back()];
+		queued[worklist.back()] = false;
+		worklist.pop_back();
+
+		for (const auto &weak_successor: block.successors)
+			if (auto successor = weak_successor.lock())
+				block.liveOut.unite(successor->liveIn);
+
+		Bitset live_in = block.liveOut;
+		live_in.subtract(block.defs);
+		live_in.unite(block.uses);
+		if (live_in == block.liveIn)
+			continue;
+
+		block.liveIn = std::move(live_in);
+		for (const auto &weak_predecessor: block.predecessors)
+			if (auto predecessor = weak_predecessor.lock()) {
+				const size_t position = positions.at(predecessor.get());
+				if (!queued[position]) {
+					queued[position] = true;
+					worklist.push_back(position);
+				}
+			}
 	}
 }
 
-void Function::upAndMark(const BasicBlockPtr &block, const VregPtr &vreg) {
-	for (const auto &instruction: block->instructions)
-		if (instruction->doesWrite(vreg))
+bool Function::isTracked(const VregPtr &vreg) const {
+	return vreg->function == this && !vreg->precolored && 0 <= vreg->id && vreg->id < nextVariable;
+}
+
+Bitset Function::liveAfter(const WhyPtr &instruction) const {
+	auto block = instruction->parent.lock();
+	if (!block)
+		throw std::runtime_error("Instruction has no parent block");
+
+	Bitset live = block->liveOut;
+	for (auto iter = block->instructions.rbegin(), rend = block->instructions.rend(); iter != rend; ++iter) {
+		if (*iter == instruction)
+			return live;
+		for (const auto &var: (*iter)->getWritten())
+			if (isTracked(var))
+				live.reset(var->id);
+		for (const auto &var: (*iter)->getRead())
+			if (isTracked(var))
+				live.set(var->id);
+	}
+
+	throw std::runtime_error("Instruction not found in its parent block");
+}
+
+Bitset Function::liveBefore(const WhyPtr &instruction) const {
+	Bitset live = liveAfter(instruction);
+	for (const auto &var: instruction->getWritten())
+		if (isTracked(var))
+			live.reset(var->id);
+	for (const auto &var: instruction->getRead())
+		if (isTracked(var))
+			live.set(var->id);
+	return live;
+}
+
+std::vector<VregPtr> Function::promoteLocals() {
+	struct Slot {
+		VregPtr variable;
+		size_t offset = 0;
+		size_t size = 0;
+		bool promotable = false;
+		bool accessed = false;
+		VregPtr home;
+	};
+
+	std::vector<Slot> slots;
+	slots.reserve(stackOffsets.size());
+	for (const auto &[variable, offset]: stackOffsets) {
+		const auto type = variable->getType();
+		const size_t size = type? type->getSize() : 0;
+		const bool scalar = type && !type->isStruct() && !type->isArray() && !type->isReference() &&
+			(size == 1 || size == 2 || size == 4 || size == 8);
+		slots.push_back({variable, offset, size, scalar, false, nullptr});
+	}
+
+	// stackOffsets is ordered by pointer, so sort the slots to keep the output deterministic.
+	std::sort(slots.begin(), slots.end(), [](const Slot &left, const Slot &right) {
+		return left.offset < right.offset;
+	});
+
+	// The slots can only be packed together afterwards if every frame pointer offset is the start of a known slot.
+	bool can_pack = true;
+	for (size_t i = 1; i < slots.size(); ++i)
+		if (slots[i - 1].offset == slots[i].offset) {
+			slots[i - 1].promotable = slots[i].promotable = false;
+			can_pack = false;
+		}
+
+	auto find_slot = [&](int offset) -> int {
+		auto iter = std::lower_bound(slots.begin(), slots.end(), offset, [](const Slot &slot, int value) {
+			return int(slot.offset) < value;
+		});
+		return iter != slots.end() && int(iter->offset) == offset? int(iter - slots.begin()) : -1;
+	};
+
+	auto is_frame_pointer = [](const VregPtr &vreg) {
+		return vreg && vreg->getReg() == Why::framePointerOffset;
+	};
+
+	auto frame_offset = [&](const WhyInstruction &instruction) -> const SubIInstruction * {
+		const auto *sub = instruction.cast<SubIInstruction>();
+		return sub && is_frame_pointer(sub->source) && sub->imm.is<int>()? sub : nullptr;
+	};
+
+	// Maps each vreg to the slot whose address is the only thing ever written to it, or to -1 if it never holds a
+	// slot's address or to -2 if it holds other values too.
+	constexpr int none = -1, mixed = -2;
+	std::vector<int> address_slots(size_t(nextVariable), none);
+
+	auto set_address = [&](const VregPtr &vreg, int slot) {
+		int &current = address_slots[vreg->id];
+		if (current == slot)
 			return;
+		if (0 <= current)
+			slots[current].promotable = false;
+		if (current != none && 0 <= slot)
+			slots[slot].promotable = false;
+		current = current == none? slot : mixed;
+	};
+
+	for (const WhyPtr &instruction: instructions) {
+		// Immediates that name a variable are resolved to stack offsets when they're printed.
+		if (const auto *has_immediate = instruction->cast<HasImmediate>(); has_immediate &&
+		    has_immediate->imm.is<VariablePtr>())
+			return {};
+
+		const SubIInstruction *sub = frame_offset(*instruction);
+		for (const VregPtr &read: instruction->getRead())
+			if (!sub && is_frame_pointer(read))
+				return {};
+
+		if (sub) {
+			const int offset = sub->imm.get<int>();
+			const int slot = find_slot(offset);
+			if (slot == -1) {
+				can_pack = false;
+				// An address inside a slot means the slot is being treated as memory.
+				for (Slot &containing: slots)
+					if (0 < offset && containing.offset - containing.size < size_t(offset) &&
+					    size_t(offset) <= containing.offset)
+						containing.promotable = false;
+			}
+			if (isTracked(sub->destination))
+				set_address(sub->destination, slot == -1? mixed : slot);
+			else if (slot != -1)
+				slots[slot].promotable = false;
+			continue;
+		}
 
-	if (block->liveIn.count(vreg) != 0)
-		return;
+		for (const VregPtr &written: instruction->getWritten())
+			if (isTracked(written))
+				set_address(written, mixed);
+	}
 
-	block->liveIn.insert(vreg);
+	auto address_slot = [&](const VregPtr &vreg) -> int {
+		return vreg && isTracked(vreg)? address_slots[vreg->id] : none;
+	};
+
+	auto has_size = [](const VregPtr &vreg, size_t size) {
+		return vreg && vreg->getType() && vreg->getType()->getSize() == size;
+	};
+
+	// A slot can be promoted if its address is only ever used directly by loads and stores of its full width.
+	for (const WhyPtr &instruction: instructions)
+		for (const VregPtr &read: instruction->getRead()) {
+			const int slot = address_slot(read);
+			if (slot < 0)
+				continue;
+			Slot &info = slots[slot];
+			info.accessed = true;
+			if (const auto *load = instruction->cast<LoadRInstruction>(); load && load->leftSource == read &&
+			    load->destination != read && has_size(load->destination, info.size))
+				continue;
+			if (const auto *store = instruction->cast<StoreRInstruction>(); store && store->rightSource == read &&
+			    store->leftSource != read && has_size(store->leftSource, info.size))
+				continue;
+			info.promotable = false;
+		}
 
-	try {
-		for (const Node *node: bbNodeMap.at(block.get())->in()) {
-			BasicBlockPtr p = node->get<std::weak_ptr<BasicBlock>>().lock();
-			p->liveOut.insert(vreg);
-			upAndMark(p, vreg);
+	std::vector<VregPtr> homes;
+	for (Slot &slot: slots)
+		if (slot.promotable && slot.accessed) {
+			slot.home = newVar(TypePtr(slot.variable->getType()->copy()));
+			homes.push_back(slot.home);
 		}
-	} catch (std::out_of_range &) {
-		debug();
-		std::cerr << "Couldn't find block " << block->label << ". bbNodeMap (" << bbNodeMap.size() << "):";
-		for (const auto &pair: bbNodeMap)
-			std::cerr << " " << pair.first->label;
-		std::cerr << "\n";
-		throw;
+
+	auto promoted_slot = [&](const VregPtr &vreg) -> const Slot * {
+		const int slot = address_slot(vreg);
+		return 0 <= slot && slots[slot].home? &slots[slot] : nullptr;
+	};
+
+	for (auto iter = instructions.begin(); iter != instructions.end();) {
+		WhyPtr &instruction = *iter;
+		WhyPtr replacement;
+		if (const SubIInstruction *sub = frame_offset(*instruction); sub && promoted_slot(sub->destination)) {
+			iter = instructions.erase(iter);
+			continue;
+		}
+		if (const auto *load = instruction->cast<LoadRInstruction>()) {
+			if (const Slot *slot = promoted_slot(load->leftSource))
+				replacement = newInstruction<MoveInstruction>(slot->home, load->destination);
+		} else if (const auto *store = instruction->cast<StoreRInstruction>()) {
+			if (const Slot *slot = promoted_slot(store->rightSource))
+				replacement = newInstruction<MoveInstruction>(store->leftSource, slot->home);
+		}
+		if (replacement) {
+			replacement->setDebug(instruction->debug);
+			replacement->functionPosition = iter;
+			instruction = replacement;
+		}
+		++iter;
 	}
+
+	// Promoted slots and promotable slots that were never used don't need stack space anymore.
+	for (const Slot &slot: slots)
+		if (slot.promotable)
+			stackOffsets.erase(slot.variable);
+
+	if (can_pack) {
+		std::unordered_map<int, int> new_offsets;
+		size_t new_usage = 0;
+		for (const Slot &slot: slots)
+			if (!slot.promotable) {
+				new_usage += slot.size;
+				new_offsets.emplace(int(slot.offset), int(new_usage));
+				stackOffsets[slot.variable] = new_usage;
+			}
+
+		for (const WhyPtr &instruction: instructions)
+			if (frame_offset(*instruction)) {
+				int &offset = instruction->cast<SubIInstruction>()->imm.get<int>();
+				offset = new_offsets.at(offset);
+			}
+
+		stackUsage = new_usage;
+	}
+
+	return homes;
 }
 
-bool Function::spill(const VregPtr &vreg) {
+void Function::initializePromoted(const std::vector<VregPtr> &promoted, const DebugData &debug) {
+	if (promoted.empty() || blocks.empty() || blocks.front()->instructions.empty())
+		return;
+
+	const BasicBlockPtr &entry = blocks.front();
+	const WhyPtr first = entry->instructions.front();
+	bool inserted = false;
+	for (const VregPtr &vreg: promoted)
+		if (entry->liveIn.test(size_t(vreg->id))) {
+			insertBefore(first, newInstruction<SetIInstruction>(vreg, immLikeReg(vreg, 0)))->setDebug(debug);
+			inserted = true;
+		}
+
+	if (inserted) {
+		updateVregs();
+		computeLiveness();
+	}
+}
+
+void Function::optimize() {
+	if (!program.optimize)
+		return;
+
+	SSA ssa(*this);
+
+	// Passes run in this order on every function that could be put into SSA form.
+	std::vector<std::unique_ptr<Pass>> passes;
+	passes.push_back(std::make_unique<SCCP>(*this, ssa));
+	passes.push_back(std::make_unique<DCE>(*this, ssa));
+
+	if (!ssa.construct())
+		return;
+
+	bool changed = false;
+	for (const auto &pass: passes) {
+		TimeReport::Timer timer(TimeReport::Phase::Optimize);
+		changed = pass->run() || changed;
+	}
+
+	ssa.destruct(changed);
+}
+
+bool Function::spill(const VregPtr &vreg, bool update_liveness) {
 	// Right after the definition of the vreg to be spilled, store its value onto the stack in the proper location.
 	// For each use of the original vreg, replace the original vreg with a new vreg, and right before the use insert a
 	// definition for the vreg by loading it from the stack.
 
-	if (vreg->writers.empty()) {
+	if (vregTable.getWriters(*vreg).empty()) {
 		debug();
 		warn() << *vreg;
 		throw GenericError(getLocation(), "Can't spill vreg " + vreg->regOrID() + " in function " + name +
 			": no definitions");
 	}
 
+	if (WhyPtr definition = getRematerializer(vreg)) {
+		const bool out = rematerialize(vreg, definition);
+		if (out)
+			++rematerializedCount;
+		if (update_liveness) {
+			split();
+			computeLiveness();
+		}
+		return out;
+	}
+
 	bool out = false;
 	const size_t location = getSpill(vreg, true);
 
-	for (const auto &weak_definition: vreg->writers) {
-		WhyPtr definition = weak_definition.lock();
-		auto store = std::make_shared<StackStoreInstruction>(vreg, location);
+	// Copied because recording new vregs can reallocate the table.
+	const std::vector<WhyInstruction *> definitions = vregTable.getWriters(*vreg);
+	const std::vector<WhyInstruction *> uses = vregTable.getReaders(*vreg);
+
+	for (WhyInstruction *raw_definition: definitions) {
+		WhyPtr definition = raw_definition->shared_from_this();
+		auto store = newInstruction<StackStoreInstruction>(vreg, location);
 		auto next = after(definition);
 		bool should_insert = true;
 
 		// Skip comments.
-		while (next && dynamic_cast<Comment *>(next.get()) != nullptr)
+		while (isa<Comment>(next))
 			next = after(next);
 
 		if (next) {
-			auto other_store = std::dynamic_pointer_cast<StackStoreInstruction>(next);
+			auto *other_store = dyn_cast<StackStoreInstruction>(next);
 			if (other_store && *other_store == *store)
 				should_insert = false;
 		}
 
 		if (should_insert) {
-			insertAfter(definition, store, false);
-			insertBefore(store, std::make_shared<Comment>("Spill: stack store for " + vreg->regOrID() +
+			insertAfter(definition, store);
+			insertBefore(store, newInstruction<Comment>("Spill: stack store for " + vreg->regOrID() +
 				" into location=" + std::to_string(location)));
 			VregPtr new_var = mx(6, definition);
 			definition->replaceWritten(vreg, new_var);
@@ -845,15 +1247,17 @@ bool Function::spill(const VregPtr &vreg) {
 			addComment(after(definition), "Spill: no store inserted here for " + vreg->regOrID());
 	}
 
-	for (auto iter = instructions.begin(), end = instructions.end(); iter != end; ++iter) {
-		WhyPtr &instruction = *iter;
+	for (WhyInstruction *raw_use: uses) {
+		WhyPtr instruction = raw_use->shared_from_this();
 		if (instruction->doesRead(vreg)) {
-			VregPtr new_vreg = newVar();
+			VregPtr new_vreg = newVar(vreg->getType()? TypePtr(vreg->getType()->copy()) : nullptr);
 			const bool replaced = instruction->replaceRead(vreg, new_vreg);
 			if (replaced) {
-				auto load = std::make_shared<StackLoadInstruction>(new_vreg, location);
+				auto load = newInstruction<StackLoadInstruction>(new_vreg, location);
 				insertBefore(instruction, load);
 				addComment(load, "Spill: stack load: location=" + std::to_string(location));
+				vregTable.addWriter(*new_vreg, *load);
+				vregTable.addReader(*new_vreg, *instruction);
 				out = true;
 				markSpilled(new_vreg);
 			} else
@@ -862,8 +1266,77 @@ bool Function::spill(const VregPtr &vreg) {
 	}
 
 	markSpilled(vreg);
-	split();
-	computeLiveness();
+	if (update_liveness) {
+		split();
+		computeLiveness();
+	}
+	return out;
+}
+
+WhyPtr Function::getRematerializer(const VregPtr &vreg) const {
+	const auto &writers = vregTable.getWriters(*vreg);
+	if (writers.size() != 1)
+		return nullptr;
+
+	WhyPtr definition = writers.front()->shared_from_this();
+	if (definition->parent.expired())
+		return nullptr;
+
+	// Immediates and label addresses.
+	if (definition->is<SetIInstruction>())
+		return definition;
+
+	// Stack addresses. The frame pointer doesn't change between the prologue and the epilogue.
+	if (const auto *sub = definition->cast<SubIInstruction>())
+		if (sub->source && sub->source->getReg() == Why::framePointerOffset && sub->destination == vreg)
+			return definition;
+
+	return nullptr;
+}
+
+bool Function::rematerialize(const VregPtr &vreg, const WhyPtr &definition) {
+	// Instead of storing the value on the stack, recompute it into a new vreg right before each use.
+	auto make_copy = [&](const VregPtr &destination) -> WhyPtr {
+		WhyPtr copy;
+		if (const auto *set = definition->cast<SetIInstruction>())
+			copy = newInstruction<SetIInstruction>(destination, set->imm);
+		else if (const auto *sub = definition->cast<SubIInstruction>())
+			copy = newInstruction<SubIInstruction>(sub->source, destination, sub->imm);
+		else
+			throw GenericError(getLocation(), "Can't rematerialize vreg " + vreg->regOrID() + " in function " + name);
+		copy->setDebug(definition->debug);
+		return copy;
+	};
+
+	bool out = false;
+	bool all_replaced = true;
+
+	const std::vector<WhyInstruction *> uses = vregTable.getReaders(*vreg);
+	for (WhyInstruction *raw_use: uses) {
+		WhyPtr instruction = raw_use->shared_from_this();
+		if (instruction == definition || !instruction->doesRead(vreg))
+			continue;
+		VregPtr new_vreg = newVar(vreg->getType()? TypePtr(vreg->getType()->copy()) : nullptr);
+		if (instruction->replaceRead(vreg, new_vreg)) {
+			WhyPtr copy = insertBefore(instruction, make_copy(new_vreg));
+			addComment(copy, "Spill: rematerialize " + vreg->regOrID());
+			vregTable.addWriter(*new_vreg, *copy);
+			vregTable.addReader(*new_vreg, *instruction);
+			markSpilled(new_vreg);
+			out = true;
+		} else {
+			virtualRegisters.erase(new_vreg);
+			all_replaced = false;
+		}
+	}
+
+	// With every use reading its own copy, the original definition is dead.
+	if (all_replaced) {
+		remove(definition);
+		out = true;
+	}
+
+	markSpilled(vreg);
 	return out;
 }
 
@@ -891,29 +1364,25 @@ bool Function::isSpilled(const VregPtr &vreg) const {
 }
 
 bool Function::canSpill(const VregPtr &vreg) {
-	if (vreg->writers.empty() || isSpilled(vreg))
+	const auto &writers = vregTable.getWriters(*vreg);
+	if (writers.empty() || isSpilled(vreg))
 		return false;
 
 	// If the only definition is a stack store, the variable can't be spilled.
-	if (vreg->writers.size() == 1) {
-		auto single_def = vreg->writers.begin()->lock();
-		if (!single_def) {
-			warn() << *vreg << '\n';
-			throw GenericError(getLocation(), "Can't lock single writer of instruction");
-		}
-		auto *store = dynamic_cast<StackStoreInstruction *>(single_def.get());
+	if (writers.size() == 1) {
+		auto *store = dyn_cast<StackStoreInstruction>(writers.front());
 		if (store != nullptr && store->leftSource == vreg) {
 			std::cerr << "Can't spill " << *vreg << ": only definer is a stack store\n";
 			return false;
 		}
 	}
 
-	for (const auto &weak_definition: vreg->writers) {
-		auto definition = weak_definition.lock();
+	for (WhyInstruction *raw_definition: writers) {
+		WhyPtr definition = raw_definition->shared_from_this();
 
 		bool created = false;
 		const size_t location = getSpill(vreg, true, &created);
-		auto store = std::make_shared<StackStoreInstruction>(vreg, location);
+		auto store = newInstruction<StackStoreInstruction>(vreg, location);
 		auto next = after(definition);
 		bool should_insert = true;
 
@@ -948,90 +1417,99 @@ bool Function::canSpill(const VregPtr &vreg) {
 }
 
 std::set<std::shared_ptr<BasicBlock>> Function::getLive(const VregPtr &var,
-const std::function<std::set<VregPtr> &(const std::shared_ptr<BasicBlock> &)> &getter) const {
+const std::function<const Bitset &(const std::shared_ptr<BasicBlock> &)> &getter) const {
 	std::set<std::shared_ptr<BasicBlock>> out;
+	if (!isTracked(var))
+		return out;
 	for (const auto &block: blocks)
-		if (getter(block).count(var) != 0)
+		if (getter(block).test(var->id))
 			out.insert(block);
 	return out;
 }
 
 std::set<std::shared_ptr<BasicBlock>> Function::getLiveIn(const VregPtr &var) const {
-	return getLive(var, [&](const auto &block) -> auto & {
+	return getLive(var, [&](const auto &block) -> const Bitset & {
 		return block->liveIn;
 	});
 }
 
 std::set<std::shared_ptr<BasicBlock>> Function::getLiveOut(const VregPtr &var) const {
-	return getLive(var, [&](const auto &block) -> auto & {
+	return getLive(var, [&](const auto &block) -> const Bitset & {
 		return block->liveOut;
 	});
 }
 
 void Function::updateVregs() {
-	for (const auto &var: virtualRegisters) {
-		var->readingBlocks.clear();
-		var->writingBlocks.clear();
-		var->readers.clear();
-		var->writers.clear();
-	}
+	vregTable.clear(size_t(nextVariable));
 
 	for (const auto &block: blocks)
 		for (const auto &instruction: block->instructions) {
-			for (auto &var: instruction->getRead()) {
-				var->readingBlocks.insert(block);
-				var->readers.insert(instruction);
-			}
-			for (auto &var: instruction->getWritten()) {
-				var->writingBlocks.insert(block);
-				var->writers.insert(instruction);
-			}
+			for (const auto &var: instruction->getRead())
+				if (var->function == this && 0 <= var->id) {
+					vregTable.addReadingBlock(*var, *block);
+					vregTable.addReader(*var, *instruction);
+				}
+			for (const auto &var: instruction->getWritten())
+				if (var->function == this && 0 <= var->id) {
+					vregTable.addWritingBlock(*var, *block);
+					vregTable.addWriter(*var, *instruction);
+				}
 		}
 }
 
+size_t Function::instructionCount() const {
+	return std::count_if(instructions.begin(), instructions.end(), [](const WhyPtr &instruction) {
+		return !instruction->is<Label>() && !instruction->is<Comment>();
+	});
+}
+
+size_t Function::moveCount() const {
+	return std::count_if(instructions.begin(), instructions.end(), [](const WhyPtr &instruction) {
+		return instruction->is<MoveInstruction>();
+	});
+}
+
+int Function::removeRedundantMoves() {
+	int removed = 0;
+	for (auto iter = instructions.begin(); iter != instructions.end();) {
+		const auto *move = (*iter)->cast<MoveInstruction>();
+		if (move != nullptr && move->leftSource->getReg() != -1 &&
+		    move->leftSource->regOrID() == move->destination->regOrID()) {
+			remove(*iter++);
+			++removed;
+		} else
+			++iter;
+	}
+	return removed;
+}
+
 WhyPtr Function::after(const WhyPtr &instruction) {
-	auto iter = std::find(instructions.begin(), instructions.end(), instruction);
+	if (!instruction->functionPosition)
+		return nullptr;
+	auto iter = *instruction->functionPosition;
 	return ++iter == instructions.end()? nullptr : *iter;
 }
 
-WhyPtr Function::insertAfter(const WhyPtr &base, WhyPtr new_instruction, bool reindex) {
+WhyPtr Function::insertAfter(const WhyPtr &base, WhyPtr new_instruction) {
 	BasicBlockPtr block = base->parent.lock();
 	if (!block) {
 		std::cerr << "\e[31;1m!\e[0m " << base->joined(true, "; ") << '\n';
 		throw GenericError(getLocation(), "Couldn't lock instruction's parent block");
 	}
 
-	if (reindex)
-		// There used to be a + 1 here, but I removed it because I believe it gets incremented in the loop shortly
-		// before the end of this function anyway.
-		new_instruction->index = base->index;
-	new_instruction->parent = base->parent;
-	std::list<WhyPtr>::iterator iter;
-
-	if (base == instructions.back()) {
-		instructions.push_back(new_instruction);
-		block->instructions.push_back(new_instruction);
-	} else {
-		if (base == block->instructions.back()) {
-			block->instructions.push_back(new_instruction);
-		} else {
-			iter = std::find(block->instructions.begin(), block->instructions.end(), base);
-			++iter;
-			block->instructions.insert(iter, new_instruction);
-		}
-
-		iter = std::find(instructions.begin(), instructions.end(), base);
-		instructions.insert(++iter, new_instruction);
-
-		if (reindex)
-			for (auto end = instructions.end(); iter != end; ++iter)
-				++(*iter)->index;
-	}
+	if (!base->blockPosition)
+		throw GenericError(getLocation(), "Instruction not found in block " + block->label + " of function " + name);
 
+	new_instruction->parent = base->parent;
+	new_instruction->index = base->index;
+	new_instruction->blockPosition = block->instructions.insert(std::next(*base->blockPosition), new_instruction);
+	if (base->functionPosition)
+		new_instruction->functionPosition = instructions.insert(std::next(*base->functionPosition), new_instruction);
+	indicesStale = true;
 	return new_instruction;
 }
 
-WhyPtr Function::insertBefore(const WhyPtr &base, WhyPtr new_instruction, bool reindex, bool linear_warn,
+WhyPtr Function::insertBefore(const WhyPtr &base, WhyPtr new_instruction, bool linear_warn,
                               bool *should_relinearize_out) {
 	BasicBlockPtr block = base->parent.lock();
 	if (!block) {
@@ -1044,42 +1522,43 @@ WhyPtr Function::insertBefore(const WhyPtr &base, WhyPtr new_instruction, bool r
 
 	new_instruction->parent = base->parent;
 
-	auto instructionIter = std::find(instructions.begin(), instructions.end(), base);
-	if (linear_warn && instructionIter == instructions.end()) {
+	if (linear_warn && !base->functionPosition) {
 		warn() << "Couldn't find instruction in instructions field of function " << name << ": " << *base << '\n';
 		throw GenericError(getLocation(), "Couldn't find instruction in instructions field of function " + name);
 	}
 
-	auto blockIter = std::find(block->instructions.begin(), block->instructions.end(), base);
-	if (blockIter == block->instructions.end()) {
+	if (!base->blockPosition) {
 		warn() << "Couldn't find instruction in block " << block->label << " of function " << name << ": " << *base
 		       << '\n';
-		std::cerr << "Index: " << block->index << '\n';
-		for (const auto &subblock: blocks)
-			std::cerr << subblock->label << '[' << subblock->index << "] ";
-		std::cerr << '\n';
-		for (const auto &block_instruction: block->instructions)
-			std::cerr << '\t' << *block_instruction << '\n';
 		throw GenericError(getLocation(), "Instruction not found in block");
 	}
 
-	const bool can_insert_linear = instructionIter != instructions.end();
-	if (can_insert_linear) {
-		instructions.insert(instructionIter, new_instruction);
-		if (should_relinearize_out != nullptr)
-			*should_relinearize_out = false;
-	} else if (should_relinearize_out != nullptr)
-		*should_relinearize_out = true;
+	const bool can_insert_linear = base->functionPosition.has_value();
+	if (can_insert_linear)
+		new_instruction->functionPosition = instructions.insert(*base->functionPosition, new_instruction);
+	if (should_relinearize_out != nullptr)
+		*should_relinearize_out = !can_insert_linear;
 
-	block->instructions.insert(blockIter, new_instruction);
+	new_instruction->blockPosition = block->instructions.insert(*base->blockPosition, new_instruction);
+	new_instruction->index = base->index;
+	indicesStale = true;
+	return new_instruction;
+}
 
-	if (reindex && can_insert_linear) {
-		new_instruction->index = base->index;
-		for (auto end = instructions.end(); instructionIter != end; ++instructionIter)
-			++(*instructionIter)->index;
+void Function::remove(const WhyPtr &instruction) {
+	// Keep the instruction alive until it's out of both lists.
+	const WhyPtr keep = instruction;
+	vregTable.removeInstruction(*keep);
+	if (keep->blockPosition) {
+		if (auto block = keep->parent.lock())
+			block->instructions.erase(*keep->blockPosition);
+		keep->blockPosition.reset();
 	}
-
-	return new_instruction;
+	if (keep->functionPosition) {
+		instructions.erase(*keep->functionPosition);
+		keep->functionPosition.reset();
+	}
+	indicesStale = true;
 }
 
 void Function::addComment(const std::string &comment) {
@@ -1087,13 +1566,13 @@ void Function::addComment(const std::string &comment) {
 }
 
 void Function::addComment(const WhyPtr &base, const std::string &comment) {
-	insertBefore(base, Comment::make(comment));
+	insertBefore(base, newInstruction<Comment>(comment));
 }
 
 VregPtr Function::mx(int n, const BasicBlockPtr &writer) {
 	auto out = precolored(Why::assemblerOffset + n);
 	if (writer)
-		out->writingBlocks.insert(writer);
+		vregTable.addWritingBlock(*out, *writer);
 	return out;
 }
 
@@ -1122,13 +1601,9 @@ void Function::debug() const {
 		for (const auto &instruction: block->instructions)
 			std::cerr << '\t' << instruction->joined(true, "\n\t") << '\n';
 		std::cerr << "\e[36mLive-in: \e[1m";
-		std::set<int> in;
-		std::set<int> out;
-		for (const auto &var: block->liveIn) in.insert(var->id);
-		for (int id: in) std::cerr << ' ' << id;
+		block->liveIn.forEach([](size_t id) { std::cerr << ' ' << id; });
 		std::cerr << "\e[22m\nLive-out:\e[1m";
-		for (const auto &var: block->liveOut) out.insert(var->id);
-		for (int id: out) std::cerr << ' ' << id;
+		block->liveOut.forEach([](size_t id) { std::cerr << ' ' << id; });
 		std::cerr << "\e[0m\n\n";
 	}
 }
@@ -1137,6 +1612,9 @@ Graph & Function::makeCFG() {
 	cfg.clear();
 	cfg.name = "CFG for " + name;
 	bbNodeMap.clear();
+	dominatorCache.reset();
+	postDominatorCache.reset();
+	loopCache.reset();
 
 	if (blocks.empty())
 		return cfg;
@@ -1194,6 +1672,30 @@ Graph & Function::makeCFG() {
 	return cfg;
 }
 
+const DominatorTree & Function::dominators() {
+	if (!dominatorCache) {
+		if (blocks.empty() || blocks.front()->node == nullptr)
+			throw GenericError(getLocation(), "Function " + name + " has no CFG");
+		dominatorCache = std::make_unique<DominatorTree>(cfg.dominatorTree(*blocks.front()->node));
+	}
+	return *dominatorCache;
+}
+
+const DominatorTree & Function::postDominators() {
+	if (!postDominatorCache) {
+		if (blocks.empty() || blocks.front()->node == nullptr)
+			throw GenericError(getLocation(), "Function " + name + " has no CFG");
+		postDominatorCache = std::make_unique<DominatorTree>(cfg.postDominatorTree(*blocks.front()->node));
+	}
+	return *postDominatorCache;
+}
+
+const LoopForest & Function::loops() {
+	if (!loopCache)
+		loopCache = std::make_unique<LoopForest>(dominators());
+	return *loopCache;
+}
+
 bool Function::isNaked() const {
 	return attributes.count(Attribute::Naked) != 0;
 }
@@ -1279,10 +1781,11 @@ Function * Function::demangle(const std::string &mangled, Program &program) {
 			out->argumentMap.emplace(argument_name, Variable::make(argument_name, argument_types.at(i), *out));
 		}
 		if (!struct_name.empty()) {
-			if (program.structs.count(struct_name) == 0)
+			const auto struct_iter = program.structs.find(StringSet::intern(struct_name));
+			if (struct_iter == program.structs.end())
 				throw std::runtime_error("Error demangling function " + struct_name + "::" + name + ": struct " +
 					struct_name + " not defined");
-			out->structParent = program.structs.at(struct_name);
+			out->structParent = struct_iter->second;
 		}
 	} catch (...) {
 		delete out;
@@ -1343,6 +1846,7 @@ TypePtr Function::getArgumentType(size_t index) const {
 
 Function & Function::setStatic(bool is_static) {
 	isStatic = is_static;
+	mangledName.clear();
 	return *this;
 }
 
@@ -1420,6 +1924,7 @@ void Function::closeScopes(const std::string &until) {
 void Function::setStructParent(const std::shared_ptr<StructType> &new_struct_parent, bool is_static) {
 	structParent = new_struct_parent;
 	isStatic = is_static;
+	mangledName.clear();
 	if (!is_static && !thisAdded) {
 		thisAdded = true;
 		const std::string &struct_name = structParent->name;
@@ -1433,7 +1938,7 @@ void Function::setStructParent(const std::shared_ptr<StructType> &new_struct_par
 		this_var->init();
 		this_var->getType()->setConst(attributes.count(Attribute::Const) != 0);
 		argumentMap.emplace("this", this_var);
-		variables.emplace("this", this_var);
+		variables.emplace(StringSet::intern("this"), this_var);
 		variableOrder.push_back(this_var);
 	}
 }
@@ -1468,38 +1973,71 @@ bool Function::isConstructorDeclaration() const {
 }
 
 void Function::replacePlaceholders() {
-	bool changed = false;
+	TimeReport::Timer timer(TimeReport::Phase::ReplacePlaceholders);
+
+	// The registers saved around a call are the ones still needed after it returns. They're computed at the pop
+	// placeholder and shared with the matching push placeholder so that both sides agree even when the argument setup
+	// in between reads other registers or crosses a block boundary. Calls can nest inside arguments, so placeholders are
+	// matched with a stack.
+	std::map<const WhyInstruction *, std::set<int>> saved;
+	std::vector<const WhyInstruction *> open_pushes;
 
 	for (const auto &block: blocks) {
-		for (auto iter = block->instructions.begin(); iter != block->instructions.end();) {
-			WhyPtr push_placeholder = (*iter)->ptrcast<CallPushPlaceholder>();
-			WhyPtr pop_placeholder = push_placeholder? nullptr : (*iter)->ptrcast<CallPopPlaceholder>();
-			if (push_placeholder || pop_placeholder) {
-				// Accumulate variables that are used later, either in this block or later on.
-				std::set<int> regs;
-				for (const auto &vreg: block->liveOut) {
+		for (auto iter = block->instructions.begin(); iter != block->instructions.end(); ++iter) {
+			if ((*iter)->is<CallPushPlaceholder>()) {
+				open_pushes.push_back(iter->get());
+				continue;
+			}
+
+			if (!(*iter)->is<CallPopPlaceholder>())
+				continue;
+
+			// Accumulate variables that are used later, either in this block or later on.
+			std::set<int> &regs = saved[iter->get()];
+			block->liveOut.forEach([&](size_t id) {
+				if (const auto &vreg = vregTable.vreg(id)) {
 					const int reg = vreg->getReg();
 					if (Why::isGeneralPurpose(reg))
 						regs.insert(reg);
 				}
+			});
 
-				auto subiter = iter;
-				for (++subiter; subiter != block->instructions.end(); ++subiter)
-					for (const auto &vreg: (*subiter)->getRead()) {
-						const int reg = vreg->getReg();
-						if (Why::isGeneralPurpose(reg))
-							regs.insert(reg);
-					}
+			auto subiter = iter;
+			for (++subiter; subiter != block->instructions.end(); ++subiter)
+				for (const auto &vreg: (*subiter)->getRead()) {
+					const int reg = vreg->getReg();
+					if (Why::isGeneralPurpose(reg))
+						regs.insert(reg);
+				}
+
+			if (open_pushes.empty())
+				throw std::runtime_error("Unmatched CallPopPlaceholder in function " + name);
+			saved[open_pushes.back()] = regs;
+			open_pushes.pop_back();
+		}
+	}
+
+	if (!open_pushes.empty())
+		throw std::runtime_error("Unmatched CallPushPlaceholder in function " + name);
+
+	bool changed = false;
+
+	for (const auto &block: blocks) {
+		for (auto iter = block->instructions.begin(); iter != block->instructions.end();) {
+			WhyPtr push_placeholder = (*iter)->ptrcast<CallPushPlaceholder>();
+			WhyPtr pop_placeholder = push_placeholder? nullptr : (*iter)->ptrcast<CallPopPlaceholder>();
+			if (push_placeholder || pop_placeholder) {
+				const std::set<int> &regs = saved.at(iter->get());
 
 				if (push_placeholder) {
 					for (const int reg: regs) {
-						auto push = std::make_shared<StackPushInstruction>(precolored(reg));
+						auto push = newInstruction<StackPushInstruction>(precolored(reg));
 						push->setDebug(push_placeholder->debug);
 						block->instructions.insert(iter, push);
 					}
 				} else {
 					for (auto riter = regs.rbegin(), rend = regs.rend(); riter != rend; ++riter) {
-						auto pop = std::make_shared<StackPopInstruction>(precolored(*riter));
+						auto pop = newInstruction<StackPopInstruction>(precolored(*riter));
 						pop->setDebug(pop_placeholder->debug);
 						block->instructions.insert(iter, pop);
 					}
@@ -1,5 +1,6 @@
 #include <cassert>
 #include <cctype>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -161,12 +162,15 @@ Node & Graph::addNode(const std::string &label) {
 	if (hasLabel(label))
 		throw std::runtime_error("Can't add: a node with label \"" + label + "\" already exists");
 	Node *node = new Node(this, label);
+	// Nodes are only ever appended, so the index can be set now instead of being searched for later.
+	node->index_ = int(nodes_.size());
 	labelMap.insert({label, node});
 	nodes_.push_back(node);
 	return *node;
 }
 
 Node & Graph::addNode(Node *node) {
+	node->index_ = int(nodes_.size());
 	labelMap.insert({node->label(), node});
 	nodes_.push_back(node);
 	return *node;
@@ -213,6 +217,7 @@ void Graph::cloneTo(Graph &out, std::unordered_map<Node *, Node *> *rename_map)
 	std::unordered_map<Node *, Node *> node_map {};
 	for (Node *node: nodes_) {
 		Node *new_node = new Node(&out, node->label());
+		new_node->index_ = int(out.nodes_.size());
 		node_map.insert({node, new_node});
 		out.nodes_.push_back(new_node);
 		out.labelMap.insert({node->label(), new_node});
@@ -341,17 +346,21 @@ std::unordered_set<Node *> Graph::undirectedSearch(const std::string &start_labe
 std::vector<Node *> Graph::postOrder(Node &start) const {
 	std::vector<Node *> out;
 	out.reserve(size());
-	std::unordered_set<Node *> visited;
-
-	std::function<void(Node *)> visit = [&](Node *node) {
-		visited.insert(node);
-		out.push_back(node);
-		for (Node *successor: node->out_)
-			if (visited.count(successor) == 0)
-				visit(successor);
-	};
+	std::unordered_set<Node *> visited {&start};
+	std::vector<std::pair<Node *, Node::Set::const_iterator>> stack {{&start, start.out_.cbegin()}};
+
+	while (!stack.empty()) {
+		auto &[node, iter] = stack.back();
+		if (iter == node->out_.cend()) {
+			out.push_back(node);
+			stack.pop_back();
+			continue;
+		}
+		Node *successor = *iter++;
+		if (visited.insert(successor).second)
+			stack.emplace_back(successor, successor->out_.cbegin());
+	}
 
-	visit(&start);
 	return out;
 }
 
@@ -361,6 +370,18 @@ std::vector<Node *> Graph::reversePostOrder(Node &start) const {
 	return post;
 }
 
+DominatorTree Graph::dominatorTree(Node &entry) const {
+	return {*this, entry};
+}
+
+DominatorTree Graph::postDominatorTree(Node &entry) const {
+	return {*this, entry, true};
+}
+
+LoopForest Graph::loops(Node &entry) const {
+	return LoopForest(dominatorTree(entry));
+}
+
 std::vector<std::pair<Graph::Label, Graph::Label>> Graph::bridges() const {
 	std::vector<std::pair<Label, Label>> out;
 	std::unordered_map<const Node *, bool> visited;
@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "Bitset.h"
+#include "InterferenceGraph.h"
+#include "Variable.h"
+
+size_t InterferenceGraph::bitIndex(size_t left, size_t right) {
+	if (left < right)
+		std::swap(left, right);
+	return left * (left - 1) / 2 + right;
+}
+
+void InterferenceGraph::clear(size_t id_bound) {
+	vregs.clear();
+	indices.assign(id_bound, -1);
+	matrix.clear();
+	adjacency.clear();
+	colors.clear();
+	aliases.clear();
+	edgeCount = 0;
+}
+
+size_t InterferenceGraph::add(const VregPtr &vreg) {
+	if (vreg->id < 0)
+		throw std::invalid_argument("Can't add a vreg without an ID to an interference graph");
+
+	const size_t id = size_t(vreg->id);
+	if (indices.size() <= id)
+		indices.resize(id + 1, -1);
+	else if (indices[id] != -1)
+		return size_t(indices[id]);
+
+	const size_t index = vregs.size();
+	indices[id] = int(index);
+	vregs.push_back(vreg);
+	adjacency.emplace_back();
+	colors.push_back(-1);
+	aliases.push_back(index);
+	// Row n of the triangle holds n bits, so n + 1 nodes need (n + 1) * n / 2 bits in total.
+	matrix.resize((bitIndex(index + 1, 0) + 63) / 64, 0);
+	return index;
+}
+
+bool InterferenceGraph::contains(int id) const {
+	return 0 <= id && size_t(id) < indices.size() && indices[id] != -1;
+}
+
+size_t InterferenceGraph::indexOf(int id) const {
+	if (!contains(id))
+		throw std::out_of_range("Vreg %" + std::to_string(id) + " isn't in the interference graph");
+	return size_t(indices[id]);
+}
+
+bool InterferenceGraph::link(size_t left, size_t right) {
+	if (left == right || interferes(left, right))
+		return false;
+	const size_t bit = bitIndex(left, right);
+	matrix[bit / 64] |= uint64_t(1) << (bit % 64);
+	adjacency[left].push_back(right);
+	adjacency[right].push_back(left);
+	++edgeCount;
+	return true;
+}
+
+bool InterferenceGraph::interferes(size_t left, size_t right) const {
+	if (left == right)
+		return false;
+	const size_t bit = bitIndex(left, right);
+	return ((matrix[bit / 64] >> (bit % 64)) & 1) != 0;
+}
+
+bool InterferenceGraph::canCoalesce(size_t left, size_t right, size_t color_count) const {
+	auto george = [&](size_t kept, size_t removed) {
+		return std::all_of(adjacency[removed].begin(), adjacency[removed].end(), [&](size_t neighbor) {
+			return adjacency[neighbor].size() < color_count || interferes(neighbor, kept);
+		});
+	};
+
+	if (george(left, right) || george(right, left))
+		return true;
+
+	size_t significant = 0;
+	auto count = [&](size_t neighbor, bool shared) {
+		// A neighbor of both nodes loses an edge when they're merged.
+		if (color_count <= adjacency[neighbor].size() - (shared? 1 : 0))
+			++significant;
+	};
+
+	for (const size_t neighbor: adjacency[left])
+		count(neighbor, interferes(neighbor, right));
+	for (const size_t neighbor: adjacency[right])
+		if (!interferes(neighbor, left))
+			count(neighbor, false);
+
+	return significant < color_count;
+}
+
+void InterferenceGraph::merge(size_t kept, size_t removed) {
+	if (kept == removed || isMerged(kept) || isMerged(removed))
+		throw std::invalid_argument("Can't merge interference graph nodes " + std::to_string(kept) + " and " +
+			std::to_string(removed));
+
+	std::vector<size_t> removed_neighbors = std::move(adjacency[removed]);
+	adjacency[removed].clear();
+	edgeCount -= removed_neighbors.size();
+
+	for (const size_t neighbor: removed_neighbors) {
+		auto &list = adjacency[neighbor];
+		list.erase(std::find(list.begin(), list.end(), removed));
+		link(kept, neighbor);
+	}
+
+	aliases[removed] = kept;
+}
+
+size_t InterferenceGraph::find(size_t index) {
+	while (aliases[index] != index) {
+		aliases[index] = aliases[aliases[index]];
+		index = aliases[index];
+	}
+	return index;
+}
+
+std::vector<size_t> InterferenceGraph::colorOptimistic(int color_min, int color_max,
+                                                     const std::vector<double> &costs) {
+	const size_t node_count = vregs.size();
+	const size_t color_count = size_t(color_max - color_min + 1);
+	if (costs.size() != node_count)
+		throw std::invalid_argument("Expected one spill cost per interference graph node");
+
+	// Simplify: repeatedly remove a node of insignificant degree, or the cheapest node to spill relative to its degree
+	// if every remaining node has significant degree, and push it onto the stack.
+	std::vector<size_t> degrees(node_count);
+	std::vector<bool> removed(node_count, false);
+	std::vector<size_t> low;
+	std::vector<size_t> stack;
+	size_t representatives = 0;
+	stack.reserve(node_count);
+
+	for (size_t index = 0; index < node_count; ++index) {
+		if (isMerged(index)) {
+			removed[index] = true;
+			continue;
+		}
+		++representatives;
+		degrees[index] = adjacency[index].size();
+		if (degrees[index] < color_count)
+			low.push_back(index);
+	}
+
+	auto remove = [&](size_t index) {
+		removed[index] = true;
+		stack.push_back(index);
+		for (const size_t neighbor: adjacency[index])
+			if (!removed[neighbor] && degrees[neighbor]-- == color_count)
+				low.push_back(neighbor);
+	};
+
+	while (stack.size() < representatives) {
+		if (!low.empty()) {
+			const size_t index = low.back();
+			low.pop_back();
+			if (!removed[index])
+				remove(index);
+			continue;
+		}
+
+		size_t candidate = node_count;
+		double best = 0.;
+		for (size_t index = 0; index < node_count; ++index) {
+			if (removed[index])
+				continue;
+			const double weighted = costs[index] / double(degrees[index]);
+			if (candidate == node_count || weighted < best) {
+				candidate = index;
+				best = weighted;
+			}
+		}
+		remove(candidate);
+	}
+
+	// Select: pop nodes off the stack and give each the lowest color none of its neighbors has. Potential spills often
+	// still find a color; the ones that don't are returned as actual spills.
+	std::vector<size_t> uncolored;
+	Bitset taken(color_count);
+	std::fill(colors.begin(), colors.end(), -1);
+
+	for (auto iter = stack.rbegin(), rend = stack.rend(); iter != rend; ++iter) {
+		const size_t index = *iter;
+		taken.clear();
+		for (const size_t neighbor: adjacency[index])
+			if (colors[neighbor] != -1)
+				taken.set(size_t(colors[neighbor] - color_min));
+
+		for (size_t offset = 0; offset < color_count; ++offset)
+			if (!taken.test(offset)) {
+				colors[index] = color_min + int(offset);
+				break;
+			}
+
+		if (colors[index] == -1)
+			uncolored.push_back(index);
+	}
+
+	for (size_t index = 0; index < node_count; ++index)
+		if (isMerged(index))
+			colors[index] = colors[find(index)];
+
+	return uncolored;
+}
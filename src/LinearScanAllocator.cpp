@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "Bitset.h"
+#include "Function.h"
+#include "LinearScanAllocator.h"
+#include "WhyInstructions.h"
+
+bool LinearScanAllocator::prefers(const Function &function) {
+	return instructionThreshold < function.instructions.size() || vregThreshold < size_t(function.nextVariable);
+}
+
+std::vector<LinearScanAllocator::Interval> LinearScanAllocator::makeIntervals() const {
+	std::vector<Interval> intervals(size_t(function.nextVariable));
+	std::vector<bool> seen(intervals.size(), false);
+
+	enum class Access {Read, Write, Both};
+
+	auto extend = [&](const VregPtr &var, size_t position, Access access) {
+		Interval &interval = intervals[var->id];
+		if (!seen[var->id]) {
+			seen[var->id] = true;
+			interval.vreg = var;
+			interval.start = interval.end = position;
+			interval.startsWithWrite = access == Access::Write;
+			interval.endsWithRead = access == Access::Read;
+			return;
+		}
+		if (position < interval.start) {
+			interval.start = position;
+			interval.startsWithWrite = access == Access::Write;
+		} else if (position == interval.start)
+			interval.startsWithWrite = interval.startsWithWrite && access == Access::Write;
+		if (interval.end < position) {
+			interval.end = position;
+			interval.endsWithRead = access == Access::Read;
+		} else if (interval.end == position)
+			interval.endsWithRead = interval.endsWithRead && access == Access::Read;
+	};
+
+	auto allocatable = [this](const VregPtr &var) {
+		return function.isTracked(var) && var->getReg() == -1;
+	};
+
+	size_t position = 0;
+	for (const auto &block: function.blocks) {
+		const size_t block_start = position;
+
+		for (const WhyPtr &instruction: block->instructions) {
+			const auto read = instruction->getRead();
+			const auto written = instruction->getWritten();
+			for (const VregPtr &var: read)
+				if (allocatable(var))
+					extend(var, position,
+						std::find(written.begin(), written.end(), var) == written.end()? Access::Read : Access::Both);
+			for (const VregPtr &var: written)
+				if (allocatable(var) && std::find(read.begin(), read.end(), var) == read.end())
+					extend(var, position, Access::Write);
+			++position;
+		}
+
+		// Empty blocks still get a position so that values live through them are covered.
+		const size_t block_end = block_start == position? position : position - 1;
+		// Being live across a block boundary counts as both a read and a write there.
+		auto extend_live = [&](size_t id, size_t at) {
+			if (const VregPtr &var = function.vregTable.vreg(id); var && allocatable(var))
+				extend(var, at, Access::Both);
+		};
+		block->liveIn.forEach([&](size_t id) { extend_live(id, block_start); });
+		block->liveOut.forEach([&](size_t id) { extend_live(id, block_end); });
+	}
+
+	std::vector<Interval> out;
+	for (size_t id = 0; id < intervals.size(); ++id)
+		if (seen[id])
+			out.push_back(std::move(intervals[id]));
+
+	std::stable_sort(out.begin(), out.end(), [](const Interval &left, const Interval &right) {
+		return left.start < right.start;
+	});
+
+	return out;
+}
+
+bool LinearScanAllocator::isSpillable(const VregPtr &var) {
+	return !function.vregTable.getWriters(*var).empty() && !function.isSpilled(var) && triedIDs.count(var->id) == 0 &&
+		function.canSpill(var);
+}
+
+LinearScanAllocator::Result LinearScanAllocator::attempt() {
+	++attempts;
+
+	std::vector<Interval> intervals = makeIntervals();
+	const size_t register_count = size_t(lastRegister - firstRegister + 1);
+	Bitset taken(register_count);
+	// Active intervals ordered by end position.
+	std::set<std::pair<size_t, size_t>> active;
+	std::vector<VregPtr> to_spill;
+
+	auto take = [&](size_t index, int reg) {
+		intervals[index].reg = reg;
+		taken.set(size_t(reg - firstRegister));
+		active.emplace(intervals[index].end, index);
+	};
+
+	for (size_t index = 0; index < intervals.size(); ++index) {
+		Interval &current = intervals[index];
+
+		// An interval whose last read is where the current one is first written can hand over its register, since an
+		// instruction reads its operands before writing its results.
+		while (!active.empty()) {
+			const auto [end, other] = *active.begin();
+			if (current.start < end ||
+			    (end == current.start && !(intervals[other].endsWithRead && current.startsWithWrite)))
+				break;
+			taken.reset(size_t(intervals[other].reg - firstRegister));
+			active.erase(active.begin());
+		}
+
+		int free_reg = -1;
+		for (size_t offset = 0; offset < register_count; ++offset)
+			if (!taken.test(offset)) {
+				free_reg = firstRegister + int(offset);
+				break;
+			}
+
+		if (free_reg != -1) {
+			take(index, free_reg);
+			continue;
+		}
+
+		// Evict an active interval that can be spilled and ends after the current one, if only_longer is true, or any
+		// active interval that can be spilled otherwise. The current interval takes the evicted one's register.
+		auto evict = [&](bool only_longer) {
+			for (auto iter = active.rbegin(); iter != active.rend(); ++iter) {
+				const size_t victim = iter->second;
+				if (only_longer && intervals[victim].end <= current.end)
+					return false;
+				if (!isSpillable(intervals[victim].vreg))
+					continue;
+				const int reg = intervals[victim].reg;
+				active.erase(std::next(iter).base());
+				intervals[victim].reg = -1;
+				to_spill.push_back(intervals[victim].vreg);
+				take(index, reg);
+				return true;
+			}
+			return false;
+		};
+
+		if (evict(true))
+			continue;
+
+		if (isSpillable(current.vreg)) {
+			to_spill.push_back(current.vreg);
+			continue;
+		}
+
+		if (!evict(false))
+			throw std::runtime_error("Linear scan couldn't find a register or a spillable vreg for " +
+				current.vreg->regOrID() + " in function " + function.name);
+	}
+
+	if (to_spill.empty()) {
+		for (const Interval &interval: intervals)
+			interval.vreg->setReg(interval.reg);
+		return Result::Success;
+	}
+
+	bool spilled = false;
+	for (const VregPtr &var: to_spill) {
+		triedIDs.insert(var->id);
+		lastSpillAttempt = var;
+		if (function.spill(var, false)) {
+			lastSpill = var;
+			++spillCount;
+			spilled = true;
+		}
+	}
+
+	if (0 < function.split())
+		function.makeCFG();
+	function.computeLiveness();
+	return spilled? Result::Spilled : Result::NotSpilled;
+}
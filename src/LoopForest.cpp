@@ -0,0 +1,115 @@
+#include <stdexcept>
+#include <utility>
+
+#include "DominatorTree.h"
+#include "LoopForest.h"
+#include "Node.h"
+
+LoopForest::LoopForest(const DominatorTree &tree) {
+	if (tree.isPost())
+		throw std::invalid_argument("Loops can't be found with a post-dominator tree");
+
+	// The outermost loop found so far that contains each loop, with path compression.
+	std::vector<size_t> outer;
+	auto outermost = [&](size_t loop) {
+		size_t root = loop;
+		while (outer[root] != root)
+			root = outer[root];
+		while (outer[loop] != root)
+			loop = std::exchange(outer[loop], root);
+		return root;
+	};
+
+	// A loop's header dominates every header nested in it, so visiting headers in reverse of the tree's order finds
+	// inner loops first. The body of each loop is found by walking backward from its latches; whenever the walk runs
+	// into a loop that was already found, that loop gets nested in the new one and the walk skips to its header.
+	const std::vector<Node *> &order = tree.order();
+	std::vector<Node *> work;
+	for (auto iter = order.rbegin(), rend = order.rend(); iter != rend; ++iter) {
+		Node *header = *iter;
+		std::vector<Node *> latches;
+		for (Node *predecessor: header->in())
+			if (tree.dominates(*header, *predecessor))
+				latches.push_back(predecessor);
+		if (latches.empty())
+			continue;
+
+		const size_t index = loopList.size();
+		loopList.emplace_back(header);
+		outer.push_back(index);
+		innermostLoops.emplace(header, index);
+		work = latches;
+		loopList.back().latches = std::move(latches);
+
+		while (!work.empty()) {
+			Node *node = work.back();
+			work.pop_back();
+
+			const Node *entered = node;
+			if (const auto found = innermostLoops.find(node); found == innermostLoops.end()) {
+				innermostLoops.emplace(node, index);
+			} else {
+				const size_t inner = outermost(found->second);
+				if (inner == index)
+					continue;
+				loopList[inner].parent = index;
+				loopList[index].children.push_back(inner);
+				outer[inner] = index;
+				entered = loopList[inner].header;
+			}
+
+			for (Node *predecessor: entered->in())
+				if (tree.dominates(*header, *predecessor))
+					work.push_back(predecessor);
+		}
+	}
+
+	// Parents come after their children.
+	for (auto iter = loopList.rbegin(), rend = loopList.rend(); iter != rend; ++iter)
+		if (iter->parent != NONE)
+			iter->depth = loopList[iter->parent].depth + 1;
+
+	for (Loop &loop: loopList)
+		loop.nodes.push_back(loop.header);
+
+	for (Node *node: order)
+		if (const auto found = innermostLoops.find(node); found != innermostLoops.end())
+			if (Loop &loop = loopList[found->second]; loop.header != node)
+				loop.nodes.push_back(node);
+}
+
+const LoopForest::Loop * LoopForest::innermost(const Node &node) const {
+	const auto found = innermostLoops.find(&node);
+	return found == innermostLoops.end()? nullptr : &loopList[found->second];
+}
+
+size_t LoopForest::depth(const Node &node) const {
+	const Loop *loop = innermost(node);
+	return loop == nullptr? 0 : loop->depth;
+}
+
+bool LoopForest::isHeader(const Node &node) const {
+	const Loop *loop = innermost(node);
+	return loop != nullptr && loop->header == &node;
+}
+
+bool LoopForest::contains(const Loop &loop, const Node &node) const {
+	for (const Loop *current = innermost(node); current != nullptr;
+	     current = current->parent == NONE? nullptr : &loopList[current->parent])
+		if (current == &loop)
+			return true;
+	return false;
+}
+
+std::vector<Node *> LoopForest::allNodes(const Loop &loop) const {
+	std::vector<Node *> out;
+	std::vector<const Loop *> work {&loop};
+	while (!work.empty()) {
+		const Loop *current = work.back();
+		work.pop_back();
+		out.insert(out.end(), current->nodes.begin(), current->nodes.end());
+		for (const size_t child: current->children)
+			work.push_back(&loopList[child]);
+	}
+	return out;
+}
@@ -1,3 +1,10 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <thread>
+
 #include "ASTNode.h"
 #include "Casting.h"
 #include "Enums.h"
@@ -7,16 +14,21 @@
 #include "Parser.h"
 #include "Program.h"
 #include "Scope.h"
+#include "StringSet.h"
+#include "TimeReport.h"
 #include "Type.h"
 #include "Why.h"
 #include "WhyInstructions.h"
+#include "Writer.h"
+
+static std::mutex stringIDsMutex;
 
 Program compileRoot(const ASTNode &root, const std::string &filename) {
 	Program out(filename);
 
 	FunctionPtr init = Function::make(out, nullptr);
 	out.functions.emplace(".init", init);
-	out.bareFunctions.emplace(".init", init);
+	out.bareFunctions[StringSet::intern(".init")].push_back(init);
 	init->name = ".init";
 
 	for (const ASTNode *node: root)
@@ -25,13 +37,13 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 				const size_t size = node->size();
 				if (size < 4 || 6 < size)
 					throw GenericError(node->location, "Ident under program root not a function definition");
-				std::string name = *node->text;
-				if (name == "$d")
-					throw InvalidFunctionNameError(name, node->location);
-				if (name == "~")
-					name = "$d";
+				const std::string *name = node->text;
+				if (*name == "$d")
+					throw InvalidFunctionNameError(*name, node->location);
+				if (*name == "~")
+					name = StringSet::intern("$d");
 				FunctionPtr function = Function::make(out, node);
-				function->name = name;
+				function->name = *name;
 				if (size == 5 || size == 6) {
 					// 0: return type
 					// 1: args list
@@ -39,20 +51,21 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 					// 3: block
 					// 4: struct name
 					// 5: static
-					const std::string &struct_name = *node->at(4)->text;
-					if (out.structs.count(struct_name) == 0) {
+					const std::string *struct_name = node->at(4)->text;
+					const auto struct_iter = out.structs.find(struct_name);
+					if (struct_iter == out.structs.end()) {
 						std::string message = "Can't define function ";
-						message += struct_name;
+						message += *struct_name;
 						message += "::";
-						message += name;
+						message += *name;
 						message += ": struct not defined";
 						throw GenericError(node->at(4)->location, message);
 					}
-					function->setStructParent(out.structs.at(struct_name), size == 6);
+					function->setStructParent(struct_iter->second, size == 6);
 					if (function->name == "$d") {
 						if (auto destructor = function->structParent->destructor.lock())
 							if (destructor->source != nullptr)
-								throw GenericError(node->location, "Struct " + struct_name + " cannot have multiple "
+								throw GenericError(node->location, "Struct " + *struct_name + " cannot have multiple "
 									"destructors");
 						function->structParent->destructor = function;
 					}
@@ -65,7 +78,7 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 					args.emplace_back(Type::get(*arg->front(), out));
 				out.signatures.try_emplace(mangled, TypePtr(Type::get(*node->front(), out)), std::move(args));
 				out.functions.emplace(mangled, function);
-				out.bareFunctions.emplace(name, function);
+				out.bareFunctions[name].push_back(function);
 				break;
 			}
 			case CPMTOK_OPERATOR: { // Operator overload definition
@@ -83,8 +96,8 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 					args.emplace_back(Type::get(*arg->front(), out));
 				out.signatures.try_emplace(mangled, TypePtr(Type::get(*node->front(), out)), std::move(args));
 				out.functions.emplace(mangled, function);
-				out.bareFunctions.emplace(function->name, function);
-				out.operators.emplace(node->at(1)->symbol, function);
+				out.bareFunctions[StringSet::intern(function->name)].push_back(function);
+				out.operators[{node->at(1)->symbol, function->arguments.size()}].push_back(function);
 				break;
 			}
 			case CPMTOK_PLUS: { // Constructor definition
@@ -92,11 +105,12 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 				// 1: args list
 				// 2: fnattrs
 				// 3: block
-				const std::string &struct_name = *node->front()->text;
-				if (out.structs.count(struct_name) == 0)
-					throw GenericError(node->front()->location, "Can't define constructor for " + struct_name +
+				const std::string *struct_name = node->front()->text;
+				const auto struct_iter = out.structs.find(struct_name);
+				if (struct_iter == out.structs.end())
+					throw GenericError(node->front()->location, "Can't define constructor for " + *struct_name +
 						": struct not defined");
-				auto struct_type = out.structs.at(struct_name);
+				auto struct_type = struct_iter->second;
 				Types args;
 				for (const ASTNode *arg: *node->at(1))
 					args.emplace_back(Type::get(*arg->front(), out));
@@ -108,11 +122,11 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 					throw GenericError(node->location, "Cannot redefine constructor " + mangled);
 				out.signatures.try_emplace(mangled, struct_type, std::move(args));
 				out.functions.emplace(mangled, fn);
-				out.bareFunctions.emplace(fn->name, fn);
+				out.bareFunctions[StringSet::intern(fn->name)].push_back(fn);
 				break;
 			}
 			case CPM_FNDECL: {
-				const std::string &name = *node->text;
+				const std::string *name = node->text;
 				decltype(Signature::argumentTypes) args;
 				for (const ASTNode *arg: *node->at(1))
 					args.emplace_back(Type::get(*arg->front(), out));
@@ -122,27 +136,27 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 					throw GenericError(node->location, "Cannot redefine function " + mangled);
 				out.signatures.try_emplace(mangled, TypePtr(Type::get(*node->front(), out)), std::move(args));
 				out.functionDeclarations.emplace(mangled, fn);
-				out.bareFunctionDeclarations.emplace(name, fn);
+				out.bareFunctionDeclarations[name].push_back(fn);
 				break;
 			}
 			case CPM_DECL: { // Global variable
-				const std::string &name = *node->at(1)->text;
+				const std::string *name = node->at(1)->text;
 				if (out.globals.count(name) != 0)
-					throw GenericError(node->location, "Cannot redefine global " + name);
+					throw GenericError(node->location, "Cannot redefine global " + *name);
 				auto type = TypePtr(Type::get(*node->front(), out));
 				if (node->size() <= 2)
-					out.globalOrder.push_back(out.globals.try_emplace(name,
-						std::make_shared<Global>(name, type, nullptr)).first);
+					out.globalOrder.push_back(&*out.globals.try_emplace(name,
+						std::make_shared<Global>(*name, type, nullptr)).first);
 				else
-					out.globalOrder.push_back(out.globals.try_emplace(name, std::make_shared<Global>(name, type,
+					out.globalOrder.push_back(&*out.globals.try_emplace(name, std::make_shared<Global>(*name, type,
 						std::shared_ptr<Expr>(Expr::get(*node->at(2), init.get())))).first);
 				break;
 			}
 			case CPMTOK_STRUCT: {
-				const std::string &struct_name = *node->front()->text;
+				const std::string *struct_name = node->front()->text;
 				if (node->size() == 1) {
 					if (out.forwardDeclarations.count(struct_name) != 0)
-						throw NameConflictError(struct_name, node->front()->location);
+						throw NameConflictError(*struct_name, node->front()->location);
 					out.forwardDeclarations.insert(struct_name);
 				} else {
 					std::vector<std::pair<std::string, TypePtr>> order;
@@ -154,13 +168,13 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 							if (field_names.count(field_name) != 0)
 								throw NameConflictError(field_name, child->location);
 							field_names.insert(field_name);
-							if (child->attributes.count("static") == 0) {
+							if (!child->hasAttribute(ASTNode::Attribute::Static)) {
 								order.emplace_back(field_name, Type::get(*child->front(), out));
 							} else {
-								if (out.globals.count(field_name) != 0)
+								if (out.globals.count(child->text) != 0)
 									throw NameConflictError(field_name, child->location);
 								auto type = TypePtr(Type::get(*child->front(), out));
-								const std::string mangled = Util::mangleStaticField(struct_name, type, field_name);
+								const std::string mangled = Util::mangleStaticField(*struct_name, type, field_name);
 								statics.emplace(field_name, type);
 								GlobalPtr global;
 								if (child->size() == 1) {
@@ -169,34 +183,35 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 									auto expr = ExprPtr(Expr::get(*child->at(1), init.get()));
 									global = std::make_shared<Global>(mangled, type, expr);
 								}
-								out.globalOrder.push_back(out.globals.emplace(mangled, global).first);
+								auto global_iter = out.globals.emplace(StringSet::intern(mangled), global).first;
+								out.globalOrder.push_back(&*global_iter);
 							}
 						}
-					auto struct_type = out.structs.emplace(struct_name, StructType::make(out, struct_name,
+					auto struct_type = out.structs.emplace(struct_name, StructType::make(out, *struct_name,
 						std::move(order), std::move(statics))).first->second;
 					for (ASTNode *child: *node->at(1))
 						if (child->symbol == CPM_FNDECL) {
-							const std::string &name = *child->text;
+							const std::string *name = child->text;
 							decltype(Signature::argumentTypes) args;
 							for (const ASTNode *arg: *child->at(1))
 								args.emplace_back(Type::get(*arg->front(), out));
 							FunctionPtr fn = Function::make(out, child);
 							fn->structParent = struct_type;
-							fn->setStatic(child->attributes.count("static") != 0);
+							fn->setStatic(child->hasAttribute(ASTNode::Attribute::Static));
 							const std::string mangled = fn->mangle();
 							if (out.signatures.count(mangled) != 0)
 								throw GenericError(child->location, "Cannot redefine function " + mangled);
 							TypePtr ret_type = TypePtr(Type::get(*child->front(), out));
 							out.signatures.try_emplace(mangled, ret_type, std::move(args));
 							out.functionDeclarations.emplace(mangled, fn);
-							out.bareFunctionDeclarations.emplace(name, fn);
+							out.bareFunctionDeclarations[name].push_back(fn);
 						} else if (child->symbol == CPM_CONSTRUCTORDECL) {
 							// 0: args
 							// 1: fnattrs
 							decltype(Signature::argumentTypes) args;
 							for (const ASTNode *arg: *child->at(0))
 								args.emplace_back(Type::get(*arg->front(), out));
-							child->map["StructName"] = struct_type->name;
+							child->structName = StringSet::intern(struct_type->name);
 							FunctionPtr fn = Function::make(out, child);
 							fn->structParent = struct_type;
 							fn->name = "$c";
@@ -207,7 +222,7 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 								throw GenericError(node->location, "Cannot redefine constructor " + mangled);
 							out.signatures.try_emplace(mangled, struct_type, std::move(args));
 							out.functionDeclarations.emplace(mangled, fn);
-							out.bareFunctionDeclarations.emplace(fn->name, fn);
+							out.bareFunctionDeclarations[StringSet::intern(fn->name)].push_back(fn);
 						} else if (child->symbol == CPMTOK_TILDE) {
 							FunctionPtr fn = Function::make(out, nullptr);
 							fn->structParent = struct_type;
@@ -219,7 +234,7 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 								throw GenericError(child->location, "Cannot redefine function " + mangled);
 							out.signatures.try_emplace(mangled, VoidType::make(), Types());
 							out.functionDeclarations.emplace(mangled, fn);
-							out.bareFunctionDeclarations.emplace("$d", fn);
+							out.bareFunctionDeclarations[StringSet::intern("$d")].push_back(fn);
 						} else if (child->symbol != CPMTOK_IDENT)
 							child->debug();
 				}
@@ -239,13 +254,13 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 				break;
 			default:
 				throw GenericError(node->location, "Unexpected token under root: " +
-					std::string(cpmParser.getName(node->symbol)));
+					std::string(node->getName()));
 		}
 
 	auto add_dummy = [&](const std::string &function_name) -> Function & {
 		FunctionPtr fn = Function::make(out, nullptr);
 		out.functions.emplace("`" + function_name, fn);
-		out.bareFunctions.emplace("`" + function_name, fn);
+		out.bareFunctions[StringSet::intern("`" + function_name)].push_back(fn);
 		fn->name = "`" + function_name;
 		return *fn;
 	};
@@ -261,43 +276,77 @@ Program compileRoot(const ASTNode &root, const std::string &filename) {
 	return out;
 }
 
-void Program::compile() {
-	lines = {"#meta"};
+/** Finalizes functions on up to the given number of worker threads. Exceptions are rethrown in the original order so
+ *  that the reported error doesn't depend on scheduling. */
+static void finalizeFunctions(const std::vector<Function *> &to_finalize, size_t jobs) {
+	if (jobs <= 1 || to_finalize.size() <= 1) {
+		for (Function *function: to_finalize)
+			function->finalize();
+		return;
+	}
+
+	std::vector<std::exception_ptr> errors(to_finalize.size());
+	std::atomic_size_t next_index = 0;
+	std::vector<std::thread> workers;
+	jobs = std::min(jobs, to_finalize.size());
+	workers.reserve(jobs);
+
+	for (size_t i = 0; i < jobs; ++i)
+		workers.emplace_back([&] {
+			for (size_t index = next_index++; index < to_finalize.size(); index = next_index++) {
+				try {
+					to_finalize[index]->finalize();
+				} catch (...) {
+					errors[index] = std::current_exception();
+				}
+			}
+		});
+
+	for (std::thread &worker: workers)
+		worker.join();
+
+	for (const std::exception_ptr &error: errors)
+		if (error)
+			std::rethrow_exception(error);
+}
+
+void Program::compile(Writer &writer, size_t jobs) {
+	lookupCache.clear();
+	operatorCache.clear();
+	// The metadata and data sections are held back until every function has been finalized so that nothing is
+	// written if compilation fails.
+	std::string data = "#meta\n";
 	if (!name.empty())
-		lines.emplace_back("name: " + name);
+		data += "name: " + name + '\n';
 	if (!author.empty())
-		lines.emplace_back("author: " + author);
+		data += "author: " + author + '\n';
 	if (!orcid.empty())
-		lines.emplace_back("orcid: " + orcid);
+		data += "orcid: " + orcid + '\n';
 	if (!version.empty())
-		lines.emplace_back("version: " + version);
-	lines.emplace_back("");
-	lines.emplace_back("#text");
-	lines.emplace_back("");
-	lines.emplace_back("%data");
+		data += "version: " + version + '\n';
+	data += "\n#text\n\n%data\n";
 	auto init_scope = std::make_shared<GlobalScope>(*this);
 
 	auto &init = functions.at(".init");
 
 	for (const auto &iter: globalOrder) {
-		const auto &global_name = iter->first;
+		const std::string &global_name = *iter->first;
 		const auto &expr = iter->second->value;
-		lines.emplace_back("");
-		lines.emplace_back("@" + global_name);
+		data += "\n@" + global_name + '\n';
 		auto type = iter->second->getType();
 		auto size = type->getSize();
 		if (expr) {
 			auto value = expr->evaluate(Context(*this, init->selfScope));
 			if (value && size == 1) {
-				lines.emplace_back("\t%1b " + std::to_string(*value));
+				data += "\t%1b " + std::to_string(*value) + '\n';
 			} else if (value && size == 2) {
-				lines.emplace_back("\t%2b " + std::to_string(*value));
+				data += "\t%2b " + std::to_string(*value) + '\n';
 			} else if (value && size == 4) {
-				lines.emplace_back("\t%4b " + std::to_string(*value));
+				data += "\t%4b " + std::to_string(*value) + '\n';
 			} else if (value && size == 8) {
-				lines.emplace_back("\t%8b " + std::to_string(*value));
+				data += "\t%8b " + std::to_string(*value) + '\n';
 			} else {
-				lines.emplace_back("\t%fill " + std::to_string(size) + " 0");
+				data += "\t%fill " + std::to_string(size) + " 0\n";
 				TypePtr expr_type = expr->getType(Context(*this, init->selfScope));
 				VregPtr vreg = init->newVar();
 				if (auto *initializer = expr->cast<InitializerExpr>()) {
@@ -310,37 +359,65 @@ void Program::compile() {
 						throw ImplicitConversionError(expr_type, type, expr->getLocation());
 					OperandType op_type(*iter->second->getType());
 					++op_type.pointerLevel;
-					init->add<StoreIInstruction>(vreg, TypedImmediate(op_type, iter->first))->setDebug(*expr);
+					init->add<StoreIInstruction>(vreg, TypedImmediate(op_type, global_name))->setDebug(*expr);
 				}
 			}
 		} else if (size == 1) {
-			lines.emplace_back("\t%1b 0");
+			data += "\t%1b 0\n";
 		} else if (size == 2) {
-			lines.emplace_back("\t%2b 0");
+			data += "\t%2b 0\n";
 		} else if (size == 4) {
-			lines.emplace_back("\t%4b 0");
+			data += "\t%4b 0\n";
 		} else if (size == 8) {
-			lines.emplace_back("\t%8b 0");
+			data += "\t%8b 0\n";
 		} else {
-			lines.emplace_back("\t%fill " + std::to_string(size) + " 0");
+			data += "\t%fill " + std::to_string(size) + " 0\n";
 		}
 	}
 
-	for (auto &[name, function]: functions)
-		function->compile();
+	std::vector<Function *> to_finalize;
+	to_finalize.reserve(functions.size());
+	for (auto &[name, function]: functions) {
+		function->lower();
+		to_finalize.push_back(function.get());
+	}
 
-	for (const auto &[str, id]: stringIDs) {
-		lines.emplace_back("");
-		lines.emplace_back("@.str" + std::to_string(id));
-		lines.emplace_back("\t%stringz \"" + Util::escape(str) + "\"");
+	finalizeFunctions(to_finalize, jobs);
+
+	if (allocationReport) {
+		int total_spills = 0, total_rematerialized = 0, total_coalesced = 0, total_removed = 0;
+		size_t total_instructions = 0, total_moves = 0;
+		for (const auto &[name, function]: functions) {
+			if (name != ".init" && function->isBuiltin())
+				continue;
+			const size_t instruction_count = function->instructionCount();
+			const size_t move_count = function->moveCount();
+			info() << function->mangle() << ": " << function->spillCount << " spill"
+			       << (function->spillCount == 1? "" : "s") << ", " << function->rematerializedCount
+			       << " rematerialized, " << function->allocationAttempts << " attempt"
+			       << (function->allocationAttempts == 1? "" : "s") << ", " << function->coalescedMoves
+			       << " coalesced, " << move_count << " move" << (move_count == 1? "" : "s") << " ("
+			       << function->removedMoves << " removed), " << instruction_count << " instruction"
+			       << (instruction_count == 1? "" : "s") << (function->usedLinearScan? " (linear scan)" : "") << '\n';
+			total_spills += function->spillCount;
+			total_rematerialized += function->rematerializedCount;
+			total_coalesced += function->coalescedMoves;
+			total_removed += function->removedMoves;
+			total_instructions += instruction_count;
+			total_moves += move_count;
+		}
+		info() << "Total: " << total_spills << " spills, " << total_rematerialized << " rematerialized, "
+		       << total_coalesced << " coalesced, " << total_moves
+		       << " moves (" << total_removed << " removed), " << total_instructions << " instructions\n";
 	}
 
-	lines.emplace_back("");
-	lines.emplace_back("%code");
-	lines.emplace_back("");
-	lines.emplace_back(":: .init");
-	lines.emplace_back(":: main");
-	lines.emplace_back("<halt>");
+	TimeReport::Timer timer(TimeReport::Phase::Emit);
+	writer << data;
+
+	for (const auto &[str, id]: stringIDs)
+		writer << "\n@.str" << id << "\n\t%stringz \"" << Util::escape(str) << "\"\n";
+
+	writer << "\n%code\n\n:: .init\n:: main\n<halt>\n";
 
 	for (const std::string &line:
 		Util::split("|@`c|\t<prc $a0{uc}>|\t: $rt{v*}||@`ptr|\t<prc '0'>|\t<prc 'x'>|\t<prx $a0{v}>|\t: $rt{v*}||@`s|\t"
@@ -349,7 +426,7 @@ void Program::compile() {
 			"|\t: $rt{v*}||@`s8|\t<prd $a0{sc}>|\t: $rt{v*}||@`u16|\t<prd $a0{us}>|\t: $rt{v*}||@`u32|\t<prd $a0{ui}>|"
 			"\t: $rt{v*}||@`u64|\t<prd $a0{ul}>|\t: $rt{v*}||@`u8|\t<prd $a0{uc}>|\t: $rt{v*}||@`bool|\t!$a0{v} -> $a0{"
 			"uc}|\t!$a0{uc} -> $a0{uc}|\t<prd $a0{uc}>|\t: $rt{v*}", "|", false))
-		lines.emplace_back(line);
+		writer << line << '\n';
 
 	std::map<DebugData, size_t> debug_map;
 	std::map<size_t, DebugData *> inverse_debug_map;
@@ -367,56 +444,94 @@ void Program::compile() {
 
 	for (auto &[name, function]: functions)
 		if (name == ".init" || !function->isBuiltin()) {
-			lines.emplace_back("");
-			lines.emplace_back("@" + function->mangle());
-			for (const std::string &line: function->stringify(debug_map))
-				lines.emplace_back("\t" + line);
+			writer << "\n@" << function->mangle() << '\n';
+			function->emit(writer, debug_map);
 		}
 
-	lines.emplace_back("");
-	lines.emplace_back("#debug");
-	lines.emplace_back("");
-	lines.emplace_back("1 \"" + Util::escape(filename) + "\"");
+	writer << "\n#debug\n\n1 \"" << Util::escape(filename) << "\"\n";
 	std::map<std::string, size_t> function_indices;
 	for (auto &[name, function]: functions) {
-		const std::string mangled = function->mangle();
+		const std::string &mangled = function->mangle();
 		function_indices.emplace(mangled, function_indices.size() + 1);
-		lines.emplace_back("2 \"" + Util::escape(mangled) + "\"");
+		writer << "2 \"" << Util::escape(mangled) << "\"\n";
 	}
 
 	for (const auto &[index, debug]: inverse_debug_map)
-		lines.emplace_back("3 0 " + std::to_string(debug->location.line + 1) + " " +
-			std::to_string(debug->location.column) + " " + std::to_string(function_indices.at(debug->mangledFunction)));
+		writer << "3 0 " << debug->location.line + 1 << ' ' << debug->location.column << ' '
+		       << function_indices.at(debug->mangledFunction) << '\n';
+}
+
+/** Escapes a string for use in a JSON string literal. */
+static std::string escapeJSON(const std::string &str) {
+	std::string out;
+	out.reserve(str.size());
+	for (const char ch: str) {
+		if (ch == '"' || ch == '\\') {
+			out += '\\';
+			out += ch;
+		} else if (static_cast<unsigned char>(ch) < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(ch));
+			out += escaped;
+		} else
+			out += ch;
+	}
+	return out;
+}
+
+void Program::writeStats(std::ostream &stream) const {
+	stream << "{\n\t\"functions\": [";
+	bool first = true;
+	for (const auto &[name, function]: functions) {
+		if (name != ".init" && function->isBuiltin())
+			continue;
+		stream << (first? "\n" : ",\n");
+		first = false;
+		stream << "\t\t{\"name\": \"" << escapeJSON(function->mangle()) << "\", \"instructions\": "
+		       << function->instructionCount() << ", \"vregs\": " << function->nextVariable << ", \"blocks\": "
+		       << function->blockCount << ", \"spillRounds\": " << std::max(function->allocationAttempts - 1, 0)
+		       << ", \"spilledVregs\": " << function->spillCount << ", \"stackUsage\": " << function->stackUsage
+		       << "}";
+	}
+	stream << (first? "]\n}\n" : "\n\t]\n}\n");
 }
 
 size_t Program::getStringID(const std::string &str) {
+	std::unique_lock lock(stringIDsMutex);
 	if (stringIDs.count(str) != 0)
 		return stringIDs.at(str);
 	const size_t old_size = stringIDs.size();
 	return stringIDs[str] = old_size;
 }
 
-FunctionPtr Program::getOperator(const std::vector<Type *> &types, int oper, const ASTLocation &location) const {
-	if (operators.count(oper) == 0)
+FunctionPtr Program::getOperator(const std::vector<const Type *> &types, int oper,
+                                 const ASTLocation &location) const {
+	const auto overloads = operators.find({oper, types.size()});
+	if (overloads == operators.end())
 		return nullptr;
 
-	std::vector<FunctionPtr> candidates;
-	const size_t types_size = types.size();
+	// Operator overloads are rare next to uses of builtin operators, so the key is only built once there's a candidate.
+	std::string key = std::to_string(oper);
+	for (const Type *type: types)
+		key += '\0' + std::string(*type);
 
-	auto [begin, end] = operators.equal_range(oper);
-	for (auto iter = begin; iter != end; ++iter)
-		if (iter->second->arguments.size() == types_size) {
+	auto cached = operatorCache.find(key);
+	if (cached == operatorCache.end()) {
+		std::vector<FunctionPtr> found;
+		for (const FunctionPtr &candidate: overloads->second) {
 			bool good = true;
-			for (size_t i = 0; i < types_size; ++i) {
-				Type *type = types.at(i);
-				if (!(*type && *iter->second->getArgumentType(i))) {
+			for (size_t i = 0; i < types.size(); ++i)
+				if (!(*types.at(i) && *candidate->getArgumentType(i))) {
 					good = false;
 					break;
 				}
-			}
 			if (good)
-				candidates.push_back(iter->second);
+				found.push_back(candidate);
 		}
+		cached = operatorCache.emplace(std::move(key), std::move(found)).first;
+	}
+
+	const std::vector<FunctionPtr> &candidates = cached->second;
 
 	if (candidates.empty())
 		return nullptr;
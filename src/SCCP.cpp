@@ -0,0 +1,593 @@
+#include <climits>
+#include <optional>
+
+#include "Function.h"
+#include "SCCP.h"
+#include "Type.h"
+#include "WhyInstructions.h"
+
+using Wide = SCCP::Wide;
+using Value = SCCP::Value;
+
+enum class Operation {
+	Add, Sub, Mult, And, Or, Xor, Nand, Nor, Xnor, Shl, Sra, Srl, Div, Mod, DivUnsigned, Not,
+	Land, Lor, Lxor, Lnand, Lnor, Lxnor, Lnot, Less, LessEqual, Equal, NotEqual, LessUnsigned, LessEqualUnsigned
+};
+
+struct Operand {
+	Value value;
+	OperandType type;
+};
+
+/** Returns the width in bits and the signedness of an operand type, or nullopt if it's not a number or a pointer. */
+static std::optional<std::pair<int, bool>> widthOf(const OperandType &type) {
+	if (0 < type.pointerLevel)
+		return std::make_pair(64, false);
+	if (type.pointerLevel != 0)
+		return std::nullopt;
+	switch (type.primitive) {
+		case Primitive::Char:  return std::make_pair(8,  type.isSigned);
+		case Primitive::Short: return std::make_pair(16, type.isSigned);
+		case Primitive::Int:   return std::make_pair(32, type.isSigned);
+		case Primitive::Long:  return std::make_pair(64, type.isSigned);
+		default: return std::nullopt;
+	}
+}
+
+static bool fits(Wide value, const OperandType &type) {
+	const auto width = widthOf(type);
+	if (!width)
+		return false;
+	const auto [bits, is_signed] = *width;
+	if (is_signed)
+		return -(Wide(1) << (bits - 1)) <= value && value < (Wide(1) << (bits - 1));
+	return 0 <= value && value < (Wide(1) << bits);
+}
+
+/** Returns the operand type of a vreg that holds a number, a bool or a pointer. */
+static std::optional<OperandType> operandType(const VregPtr &vreg) {
+	const auto type = vreg->getType();
+	if (!type || !(type->isInt() || type->isBool() || type->isPointer()))
+		return std::nullopt;
+	const OperandType out(*type);
+	if (!widthOf(out))
+		return std::nullopt;
+	return out;
+}
+
+/** Returns the trailing conditional branch of a block, if it has one. */
+static const JumpConditionalInstruction * conditionalJump(const BasicBlock &block) {
+	if (block.instructions.empty())
+		return nullptr;
+	const auto *jump = block.instructions.back()->cast<JumpConditionalInstruction>();
+	return jump != nullptr && !jump->link? jump : nullptr;
+}
+
+/** Recognizes the register instructions that can be folded. Inverse instructions read their sources the other way
+ *  around. */
+static std::optional<Operation> registerOperation(const WhyInstruction &instruction, bool &inverse) {
+	inverse = false;
+	if (instruction.is<AddRInstruction>())  return Operation::Add;
+	if (instruction.is<SubRInstruction>())  return Operation::Sub;
+	if (instruction.is<MultRInstruction>()) return Operation::Mult;
+	if (instruction.is<AndRInstruction>())  return Operation::And;
+	if (instruction.is<OrRInstruction>())   return Operation::Or;
+	if (instruction.is<XorRInstruction>())  return Operation::Xor;
+	if (instruction.is<NandRInstruction>()) return Operation::Nand;
+	if (instruction.is<NorRInstruction>())  return Operation::Nor;
+	if (instruction.is<XnorRInstruction>()) return Operation::Xnor;
+	if (instruction.is<ShiftLeftLogicalRInstruction>())     return Operation::Shl;
+	if (instruction.is<ShiftRightArithmeticRInstruction>()) return Operation::Sra;
+	if (instruction.is<ShiftRightLogicalRInstruction>())    return Operation::Srl;
+	if (instruction.is<DivRInstruction>())   return Operation::Div;
+	if (instruction.is<ModRInstruction>())   return Operation::Mod;
+	if (instruction.is<NotRInstruction>())   return Operation::Not;
+	if (instruction.is<LandRInstruction>())  return Operation::Land;
+	if (instruction.is<LorRInstruction>())   return Operation::Lor;
+	if (instruction.is<LxorRInstruction>())  return Operation::Lxor;
+	if (instruction.is<LnandRInstruction>()) return Operation::Lnand;
+	if (instruction.is<LnorRInstruction>())  return Operation::Lnor;
+	if (instruction.is<LxnorRInstruction>()) return Operation::Lxnor;
+	if (instruction.is<LnotRInstruction>())  return Operation::Lnot;
+	if (instruction.is<SlRInstruction>())    return Operation::Less;
+	if (instruction.is<SleRInstruction>())   return Operation::LessEqual;
+	if (instruction.is<SeqRInstruction>())   return Operation::Equal;
+	if (instruction.is<SneqRInstruction>())  return Operation::NotEqual;
+	inverse = true;
+	if (instruction.is<SgRInstruction>())    return Operation::Less;
+	if (instruction.is<SgeRInstruction>())   return Operation::LessEqual;
+	if (instruction.is<SguRInstruction>())   return Operation::LessUnsigned;
+	if (instruction.is<SgeuRInstruction>())  return Operation::LessEqualUnsigned;
+	return std::nullopt;
+}
+
+/** Recognizes the immediate instructions that can be folded. Inverse instructions have the immediate on the left. */
+static std::optional<Operation> immediateOperation(const WhyInstruction &instruction, bool &inverse) {
+	inverse = false;
+	if (instruction.is<AddIInstruction>())  return Operation::Add;
+	if (instruction.is<SubIInstruction>())  return Operation::Sub;
+	if (instruction.is<MultIInstruction>()) return Operation::Mult;
+	if (instruction.is<AndIInstruction>())  return Operation::And;
+	if (instruction.is<OrIInstruction>())   return Operation::Or;
+	if (instruction.is<XorIInstruction>())  return Operation::Xor;
+	if (instruction.is<NandIInstruction>()) return Operation::Nand;
+	if (instruction.is<NorIInstruction>())  return Operation::Nor;
+	if (instruction.is<XnorIInstruction>()) return Operation::Xnor;
+	if (instruction.is<ShiftLeftLogicalIInstruction>())     return Operation::Shl;
+	if (instruction.is<ShiftRightArithmeticIInstruction>()) return Operation::Sra;
+	if (instruction.is<ShiftRightLogicalIInstruction>())    return Operation::Srl;
+	if (instruction.is<DivIInstruction>())   return Operation::Div;
+	if (instruction.is<ModIInstruction>())   return Operation::Mod;
+	if (instruction.is<LandIInstruction>())  return Operation::Land;
+	if (instruction.is<LorIInstruction>())   return Operation::Lor;
+	if (instruction.is<LxorIInstruction>())  return Operation::Lxor;
+	if (instruction.is<LnandIInstruction>()) return Operation::Lnand;
+	if (instruction.is<LnorIInstruction>())  return Operation::Lnor;
+	if (instruction.is<LxnorIInstruction>()) return Operation::Lxnor;
+	inverse = true;
+	if (instruction.is<DiviIInstruction>())  return Operation::Div;
+	if (instruction.is<DivuiIInstruction>()) return Operation::DivUnsigned;
+	if (instruction.is<ShiftLeftLogicalInverseIInstruction>())     return Operation::Shl;
+	if (instruction.is<ShiftRightArithmeticInverseIInstruction>()) return Operation::Sra;
+	if (instruction.is<ShiftRightLogicalInverseIInstruction>())    return Operation::Srl;
+	return std::nullopt;
+}
+
+/** Applies an operation to constant operands. Returns nullopt whenever the result would depend on how the machine
+ *  treats signedness, overflow or out-of-range shifts, which the operand types don't pin down. */
+static std::optional<Wide> fold(Operation operation, const std::vector<Operand> &operands) {
+	bool any_negative = false, any_unsigned = false;
+	for (const Operand &operand: operands) {
+		any_negative = any_negative || operand.value.constant < 0;
+		any_unsigned = any_unsigned || !widthOf(operand.type)->second;
+	}
+
+	if (any_negative && any_unsigned)
+		return std::nullopt;
+
+	const Wide left = operands.front().value.constant;
+	const Wide right = operands.size() < 2? 0 : operands.back().value.constant;
+	const int left_bits = widthOf(operands.front().type)->first;
+	const bool shift_in_range = 0 <= right && right < left_bits;
+
+	Wide out = 0;
+	bool arithmetic = true, shift = false;
+	switch (operation) {
+		case Operation::Add:  out = left + right;    break;
+		case Operation::Sub:  out = left - right;    break;
+		case Operation::And:  out = left & right;    break;
+		case Operation::Or:   out = left | right;    break;
+		case Operation::Xor:  out = left ^ right;    break;
+		case Operation::Nand: out = ~(left & right); break;
+		case Operation::Nor:  out = ~(left | right); break;
+		case Operation::Xnor: out = ~(left ^ right); break;
+		case Operation::Not:  out = ~left;           break;
+		case Operation::Mult:
+			if (__builtin_mul_overflow(left, right, &out))
+				return std::nullopt;
+			break;
+		case Operation::Shl:
+			if (!shift_in_range || __builtin_mul_overflow(left, Wide(1) << int(right), &out))
+				return std::nullopt;
+			shift = true;
+			break;
+		case Operation::Sra:
+			if (!shift_in_range)
+				return std::nullopt;
+			out = left >> int(right);
+			shift = true;
+			break;
+		case Operation::Srl:
+			if (!shift_in_range || left < 0)
+				return std::nullopt;
+			out = left >> int(right);
+			shift = true;
+			break;
+		case Operation::Div:
+		case Operation::DivUnsigned:
+			if (right == 0 || (operation == Operation::DivUnsigned && any_negative))
+				return std::nullopt;
+			out = left / right;
+			break;
+		case Operation::Mod:
+			if (right == 0)
+				return std::nullopt;
+			out = left % right;
+			break;
+		default:
+			arithmetic = false;
+	}
+
+	if (arithmetic) {
+		// The result is read back through the operands' types (a product goes through $lo, for instance), so it has to
+		// fit in each of them. A shift amount's type doesn't matter.
+		for (size_t i = 0; i < operands.size(); ++i)
+			if ((i == 0 || !shift) && !fits(out, operands[i].type))
+				return std::nullopt;
+		return out;
+	}
+
+	switch (operation) {
+		case Operation::Land:  return Wide(left != 0 && right != 0);
+		case Operation::Lor:   return Wide(left != 0 || right != 0);
+		case Operation::Lxor:  return Wide((left != 0) != (right != 0));
+		case Operation::Lnand: return Wide(!(left != 0 && right != 0));
+		case Operation::Lnor:  return Wide(!(left != 0 || right != 0));
+		case Operation::Lxnor: return Wide((left != 0) == (right != 0));
+		case Operation::Lnot:  return Wide(left == 0);
+		case Operation::Less:      return Wide(left < right);
+		case Operation::LessEqual: return Wide(left <= right);
+		case Operation::Equal:     return Wide(left == right);
+		case Operation::NotEqual:  return Wide(left != right);
+		case Operation::LessUnsigned:
+		case Operation::LessEqualUnsigned:
+			if (any_negative)
+				return std::nullopt;
+			return Wide(operation == Operation::LessUnsigned? left < right : left <= right);
+		default:
+			return std::nullopt;
+	}
+}
+
+Value SCCP::valueOf(const VregPtr &vreg) const {
+	if (!vreg || !function.isTracked(vreg))
+		return Value::bottom();
+	return values[vreg->id];
+}
+
+void SCCP::lower(const VregPtr &vreg, Value value) {
+	if (!function.isTracked(vreg))
+		return;
+
+	Value &current = values[vreg->id];
+	if (current.isBottom() || value.isTop())
+		return;
+	if (current.isConstant()) {
+		if (value.isConstant() && value.constant == current.constant)
+			return;
+		value = Value::bottom();
+	}
+
+	current = value;
+	for (WhyInstruction *reader: function.vregTable.getReaders(*vreg))
+		if (const auto block = reader->parent.lock(); block && executable[blockIndices.at(block.get())])
+			instructionWork.push_back(reader);
+}
+
+void SCCP::markEdge(size_t from, size_t to) {
+	if (executableEdges.emplace(from, to).second)
+		edgeWork.emplace_back(from, to);
+}
+
+void SCCP::visit(WhyInstruction &instruction) {
+	if (const auto *jump = instruction.cast<JumpConditionalInstruction>(); jump && !jump->link) {
+		if (const auto block = instruction.parent.lock())
+			visitBranch(blockIndices.at(block.get()));
+		return;
+	}
+
+	const std::vector<VregPtr> written = instruction.getWritten();
+	bool open = false;
+	for (const VregPtr &vreg: written)
+		open = open || (function.isTracked(vreg) && !values[vreg->id].isBottom());
+	if (!open)
+		return;
+
+	const Value value = written.size() == 1? evaluate(instruction) : Value::bottom();
+	for (const VregPtr &vreg: written)
+		lower(vreg, value);
+}
+
+void SCCP::visitBranch(size_t block_index) {
+	const BasicBlock &block = *order[block_index];
+
+	if (const auto *jump = conditionalJump(block)) {
+		const Value condition = valueOf(jump->source);
+		if (condition.isTop())
+			return;
+		if (condition.isConstant()) {
+			if (condition.constant != 0) {
+				const auto found = labelIndices.find(jump->imm.get<std::string>());
+				if (found != labelIndices.end())
+					markEdge(block_index, found->second);
+			} else if (block_index + 1 < order.size())
+				markEdge(block_index, block_index + 1);
+			return;
+		}
+	}
+
+	for (const auto &weak_successor: block.successors)
+		if (const auto successor = weak_successor.lock())
+			markEdge(block_index, blockIndices.at(successor.get()));
+}
+
+Value SCCP::evaluate(WhyInstruction &instruction) {
+	const VregPtr destination = instruction.getWritten().front();
+	const std::optional<OperandType> destination_type = operandType(destination);
+	if (!destination_type)
+		return Value::bottom();
+
+	auto result = [&](std::optional<Wide> folded) {
+		return folded && fits(*folded, *destination_type)? Value::of(*folded) : Value::bottom();
+	};
+
+	if (const auto *set = instruction.cast<SetIInstruction>()) {
+		if (!set->imm.is<int>() || !fits(set->imm.get<int>(), set->imm.type))
+			return Value::bottom();
+		return result(set->imm.get<int>());
+	}
+
+	if (auto *phi = instruction.cast<PhiInstruction>()) {
+		const size_t block_index = blockIndices.at(phi->parent.lock().get());
+		Value out = Value::top();
+		for (const PhiInstruction::Incoming &entry: phi->incoming) {
+			const auto predecessor = entry.block.lock();
+			if (!predecessor || !executableEdges.contains({blockIndices.at(predecessor.get()), block_index}))
+				continue;
+			const Value incoming = valueOf(entry.value);
+			if (incoming.isTop())
+				continue;
+			if (incoming.isBottom() || (out.isConstant() && out.constant != incoming.constant))
+				return Value::bottom();
+			out = incoming;
+		}
+		return out.isConstant()? result(out.constant) : out;
+	}
+
+	if (const auto *move = instruction.cast<MoveInstruction>()) {
+		const Value source = valueOf(move->leftSource);
+		return source.isConstant()? result(source.constant) : source;
+	}
+
+	if (const auto *sext = instruction.cast<SextInstruction>()) {
+		const Value source = valueOf(sext->leftSource);
+		const auto width = widthOf(sext->destinationType);
+		if (!source.isConstant() || !width)
+			return width? source : Value::bottom();
+		// Only the low bits of the source's register matter.
+		const int bits = width->first;
+		const uint64_t mask = bits == 64? UINT64_MAX : (uint64_t(1) << bits) - 1;
+		const uint64_t low = uint64_t(source.constant) & mask;
+		Wide extended = low;
+		if (((low >> (bits - 1)) & 1) != 0)
+			extended -= Wide(1) << bits;
+		return result(extended);
+	}
+
+	auto register_operand = [&](const VregPtr &vreg) -> Operand {
+		const std::optional<OperandType> type = operandType(vreg);
+		return {type? valueOf(vreg) : Value::bottom(), type? *type : OperandType()};
+	};
+
+	auto immediate_operand = [](const TypedImmediate &imm) -> Operand {
+		if (!imm.is<int>() || !fits(imm.get<int>(), imm.type))
+			return {Value::bottom(), imm.type};
+		return {Value::of(imm.get<int>()), imm.type};
+	};
+
+	bool inverse = false;
+	std::optional<Operation> operation;
+	std::vector<Operand> operands;
+	if (const auto *rtype = instruction.cast<RType>(); rtype && (operation = registerOperation(instruction, inverse))) {
+		operands.push_back(register_operand(rtype->leftSource));
+		if (rtype->rightSource)
+			operands.push_back(register_operand(rtype->rightSource));
+	} else if (const auto *itype = instruction.cast<IType>(); itype && itype->source &&
+	           (operation = immediateOperation(instruction, inverse))) {
+		operands.push_back(register_operand(itype->source));
+		operands.push_back(immediate_operand(itype->imm));
+	} else
+		return Value::bottom();
+
+	if (inverse && operands.size() == 2)
+		std::swap(operands.front(), operands.back());
+
+	bool any_top = false;
+	for (const Operand &operand: operands) {
+		if (operand.value.isBottom())
+			return Value::bottom();
+		any_top = any_top || operand.value.isTop();
+	}
+
+	if (any_top)
+		return Value::top();
+
+	return result(fold(*operation, operands));
+}
+
+void SCCP::solve() {
+	edgeWork.emplace_back(NONE, 0);
+
+	while (true) {
+		while (!edgeWork.empty() || !instructionWork.empty()) {
+			if (!instructionWork.empty()) {
+				WhyInstruction *instruction = instructionWork.back();
+				instructionWork.pop_back();
+				visit(*instruction);
+				continue;
+			}
+
+			const size_t to = edgeWork.back().second;
+			edgeWork.pop_back();
+			BasicBlock &block = *order[to];
+
+			if (executable[to]) {
+				// A new way into a block that was already visited can only change its phis.
+				for (const WhyPtr &instruction: block.instructions) {
+					if (instruction->is<Label>())
+						continue;
+					if (!instruction->is<PhiInstruction>())
+						break;
+					visit(*instruction);
+				}
+				continue;
+			}
+
+			executable[to] = true;
+			for (const WhyPtr &instruction: block.instructions)
+				visit(*instruction);
+			visitBranch(to);
+		}
+
+		// A condition that's still unknown is never defined on any path that gets taken, so nothing can be assumed about
+		// which way it goes.
+		bool lowered = false;
+		for (size_t i = 0; i < order.size(); ++i)
+			if (executable[i])
+				if (const auto *jump = conditionalJump(*order[i]); jump && valueOf(jump->source).isTop()) {
+					lower(jump->source, Value::bottom());
+					lowered = true;
+				}
+
+		if (!lowered)
+			break;
+	}
+}
+
+bool SCCP::rewrite() {
+	bool changed = false;
+
+	// Returns an immediate to replace an instruction with if the vreg it writes turned out to be constant.
+	auto make_set = [&](const WhyPtr &instruction) -> WhyPtr {
+		if (instruction->is<SetIInstruction>())
+			return nullptr;
+		const std::vector<VregPtr> written = instruction->getWritten();
+		if (written.size() != 1)
+			return nullptr;
+		const Value value = valueOf(written.front());
+		if (!value.isConstant() || value.constant < INT_MIN || INT_MAX < value.constant)
+			return nullptr;
+		auto set = function.newInstruction<SetIInstruction>(written.front(),
+			TypedImmediate(*operandType(written.front()), int(value.constant)));
+		set->setDebug(instruction->debug);
+		return set;
+	};
+
+	for (size_t index = 0; index < order.size(); ++index) {
+		if (!executable[index])
+			continue;
+
+		std::list<WhyPtr> &instructions = order[index]->instructions;
+
+		// Phis have to stay at the start of the block, so constant ones become immediates right after the rest.
+		auto iter = instructions.begin();
+		if (iter != instructions.end() && (*iter)->is<Label>())
+			++iter;
+		std::vector<WhyPtr> constants;
+		while (iter != instructions.end() && (*iter)->is<PhiInstruction>()) {
+			if (WhyPtr set = make_set(*iter)) {
+				constants.push_back(set);
+				iter = instructions.erase(iter);
+			} else
+				++iter;
+		}
+		instructions.insert(iter, constants.begin(), constants.end());
+		changed = changed || !constants.empty();
+
+		for (; iter != instructions.end(); ++iter)
+			if (WhyPtr set = make_set(*iter)) {
+				*iter = set;
+				changed = true;
+			}
+
+		if (const auto *jump = conditionalJump(*order[index])) {
+			const Value condition = valueOf(jump->source);
+			if (condition.isConstant()) {
+				if (condition.constant != 0) {
+					auto replacement = function.newInstruction<JumpInstruction>(jump->imm);
+					replacement->setDebug(jump->debug);
+					instructions.back() = replacement;
+				} else
+					instructions.pop_back();
+				changed = true;
+			}
+		}
+	}
+
+	// Unlink every edge that can't be taken, along with the phi inputs that came through it.
+	for (size_t index = 0; index < order.size(); ++index) {
+		const BasicBlockPtr &block = order[index];
+		std::vector<BasicBlockPtr> dropped;
+		for (const auto &weak_successor: block->successors)
+			if (const auto successor = weak_successor.lock())
+				if (!executableEdges.contains({index, blockIndices.at(successor.get())}))
+					dropped.push_back(successor);
+
+		for (const BasicBlockPtr &successor: dropped) {
+			block->successors.erase(successor);
+			successor->predecessors.erase(block);
+			for (const WhyPtr &instruction: successor->instructions) {
+				if (instruction->is<Label>())
+					continue;
+				auto *phi = instruction->cast<PhiInstruction>();
+				if (phi == nullptr)
+					break;
+				std::erase_if(phi->incoming, [&](const PhiInstruction::Incoming &entry) {
+					return entry.block.lock() == block;
+				});
+			}
+			changed = true;
+		}
+	}
+
+	const size_t old_size = function.blocks.size();
+	std::erase_if(function.blocks, [&](const BasicBlockPtr &block) {
+		return !executable[blockIndices.at(block.get())];
+	});
+
+	if (function.blocks.size() != old_size)
+		changed = true;
+
+	if (!changed)
+		return false;
+
+	int last_index = -1;
+	for (const BasicBlockPtr &block: function.blocks)
+		block->index = ++last_index;
+
+	function.relinearize();
+	function.makeCFG();
+	function.updateVregs();
+	for (const VregPtr &vreg: function.virtualRegisters)
+		if (function.isTracked(vreg))
+			function.vregTable.set(vreg);
+	return true;
+}
+
+bool SCCP::run() {
+	for (const BasicBlockPtr &block: function.blocks) {
+		blockIndices.emplace(block.get(), order.size());
+		labelIndices.emplace(block->label, order.size());
+		order.push_back(block);
+	}
+
+	if (order.empty())
+		return false;
+
+	for (const BasicBlockPtr &block: order)
+		for (const WhyPtr &instruction: block->instructions) {
+			// The CFG only knows about branches that end their blocks.
+			if (const auto *jump = instruction->cast<JType>(); jump && !jump->link) {
+				if (instruction != block->instructions.back())
+					return false;
+				continue;
+			}
+
+			// Blocks whose labels are used for anything other than a branch could be reached in ways the CFG doesn't
+			// show.
+			if (const auto *immediate = instruction->cast<HasImmediate>(); immediate && immediate->imm.is<std::string>())
+				if (const auto found = labelIndices.find(immediate->imm.get<std::string>());
+				    found != labelIndices.end() && found->second != 0)
+					return false;
+		}
+
+	// Vregs without exactly one definition aren't in SSA form and could hold anything.
+	values.assign(size_t(function.nextVariable), Value::bottom());
+	for (const VregPtr &vreg: function.virtualRegisters)
+		if (function.isTracked(vreg) && function.vregTable.getWriters(*vreg).size() == 1)
+			values[vreg->id] = Value::top();
+
+	executable.assign(order.size(), false);
+	solve();
+	return rewrite();
+}
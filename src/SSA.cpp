@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "Function.h"
+#include "SSA.h"
+#include "TimeReport.h"
+#include "WhyInstructions.h"
+
+/** Returns the position in a block before which instructions should go to run last, i.e. before its branch. */
+static std::list<WhyPtr>::iterator beforeBranch(BasicBlock &block) {
+	if (block.instructions.empty())
+		return block.instructions.end();
+	if (const auto *jump = block.instructions.back()->cast<JType>(); jump && !jump->link)
+		return std::prev(block.instructions.end());
+	return block.instructions.end();
+}
+
+SSA::SSA(Function &function_): function(function_) {}
+
+int SSA::getOriginal(int id) const {
+	if (id < 0 || originals.size() <= size_t(id) || originals[id] == -1)
+		return id;
+	return originals[id];
+}
+
+bool SSA::canRename(const VirtualRegister &vreg) const {
+	const VregPtr pointer = function.vregTable.vreg(size_t(vreg.id));
+	if (!pointer)
+		return false;
+	for (WhyInstruction *reader: function.vregTable.getReaders(vreg))
+		if (!reader->canReplaceRead(pointer))
+			return false;
+	for (WhyInstruction *writer: function.vregTable.getWriters(vreg))
+		if (!writer->canReplaceWritten(pointer))
+			return false;
+	return true;
+}
+
+bool SSA::construct() {
+	TimeReport::Timer timer(TimeReport::Phase::SSA);
+
+	if (active)
+		throw std::runtime_error("Function " + function.name + " is already in SSA form");
+
+	if (function.blocks.empty() || !function.blocks.front()->predecessors.empty())
+		return false;
+
+	// Branches on flags or to registers have targets that the CFG doesn't know about.
+	for (const WhyPtr &instruction: function.instructions) {
+		if (const auto *jump = instruction->cast<JumpInstruction>(); jump && !jump->link &&
+		    jump->condition != Condition::None)
+			return false;
+		if (const auto *jump = instruction->cast<JumpRegisterInstruction>(); jump && !jump->link)
+			return false;
+		if (const auto *jump = instruction->cast<JumpRegisterConditionalInstruction>(); jump && !jump->link)
+			return false;
+	}
+
+	const std::vector<BasicBlockPtr> order(function.blocks.begin(), function.blocks.end());
+	std::unordered_map<const Node *, size_t> node_indices;
+	for (size_t i = 0; i < order.size(); ++i)
+		node_indices.emplace(static_cast<const Node *>(order[i]->node), i);
+
+	auto indices_of = [&](const std::vector<Node *> &nodes) {
+		std::vector<size_t> out;
+		out.reserve(nodes.size());
+		for (const Node *node: nodes)
+			if (const auto found = node_indices.find(node); found != node_indices.end())
+				out.push_back(found->second);
+		return out;
+	};
+
+	const DominatorTree &dominators = function.dominators();
+	std::vector<std::vector<size_t>> children(order.size()), frontiers(order.size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		const Node *node = order[i]->node;
+		if (dominators.contains(*node)) {
+			children[i] = indices_of(dominators.children(*node));
+			frontiers[i] = indices_of(dominators.frontier(*node));
+		}
+	}
+
+	firstVersion = function.nextVariable;
+	originals.assign(size_t(firstVersion), -1);
+	renamed.assign(size_t(firstVersion), false);
+
+	// Only vregs with more than one definition need new names.
+	bool any_renamed = false;
+	for (const VregPtr &vreg: function.virtualRegisters) {
+		if (!function.isTracked(vreg))
+			continue;
+		originals[vreg->id] = vreg->id;
+		if (1 < function.vregTable.getWriters(*vreg).size() && canRename(*vreg)) {
+			renamed[vreg->id] = true;
+			any_renamed = true;
+		}
+	}
+
+	active = true;
+	if (!any_renamed)
+		return true;
+
+	insertPhis(frontiers, order);
+	rename(children, order);
+	function.relinearize();
+	function.updateVregs();
+	for (const VregPtr &vreg: function.virtualRegisters)
+		if (function.isTracked(vreg))
+			function.vregTable.set(vreg);
+	return true;
+}
+
+void SSA::insertPhis(const std::vector<std::vector<size_t>> &frontiers, const std::vector<BasicBlockPtr> &order) {
+	std::unordered_map<const BasicBlock *, size_t> block_indices;
+	for (size_t i = 0; i < order.size(); ++i)
+		block_indices.emplace(order[i].get(), i);
+
+	std::vector<int> has_phi(order.size(), -1), queued(order.size(), -1);
+	std::vector<size_t> work;
+
+	for (int id = 0; id < firstVersion; ++id) {
+		if (!renamed[id])
+			continue;
+
+		const VregPtr &vreg = function.vregTable.vreg(size_t(id));
+		for (BasicBlock *block: function.vregTable.getWritingBlocks(*vreg)) {
+			const size_t index = block_indices.at(block);
+			if (queued[index] != id) {
+				queued[index] = id;
+				work.push_back(index);
+			}
+		}
+
+		while (!work.empty()) {
+			const size_t index = work.back();
+			work.pop_back();
+			for (const size_t frontier: frontiers[index]) {
+				if (has_phi[frontier] == id)
+					continue;
+				has_phi[frontier] = id;
+
+				// Pruned SSA: a phi is only needed where the vreg is live.
+				BasicBlock &block = *order[frontier];
+				if (!block.liveIn.test(size_t(id)))
+					continue;
+
+				auto phi = function.newInstruction<PhiInstruction>(vreg);
+				for (const auto &weak_predecessor: block.predecessors)
+					if (auto predecessor = weak_predecessor.lock())
+						phi->incoming.push_back({vreg, predecessor});
+
+				auto position = block.instructions.begin();
+				if (position != block.instructions.end() && (*position)->is<Label>())
+					++position;
+				while (position != block.instructions.end() && (*position)->is<PhiInstruction>())
+					++position;
+				block.instructions.insert(position, phi);
+				phi->parent = order[frontier];
+
+				if (queued[frontier] != id) {
+					queued[frontier] = id;
+					work.push_back(frontier);
+				}
+			}
+		}
+	}
+}
+
+void SSA::rename(const std::vector<std::vector<size_t>> &children, const std::vector<BasicBlockPtr> &order) {
+	std::vector<std::vector<VregPtr>> stacks(static_cast<size_t>(firstVersion));
+	std::vector<std::vector<int>> pushed(order.size());
+
+	auto is_renamed = [&](const VregPtr &vreg) {
+		return vreg && function.isTracked(vreg) && vreg->id < firstVersion && renamed[vreg->id];
+	};
+
+	auto current = [&](int id) -> VregPtr {
+		return stacks[id].empty()? function.vregTable.vreg(size_t(id)) : stacks[id].back();
+	};
+
+	auto enter = [&](size_t index) {
+		BasicBlock &block = *order[index];
+		for (const WhyPtr &instruction: block.instructions) {
+			if (!instruction->is<PhiInstruction>())
+				for (const VregPtr &read: instruction->getRead())
+					if (is_renamed(read))
+						instruction->replaceRead(read, current(read->id));
+
+			for (const VregPtr &written: instruction->getWritten()) {
+				if (!is_renamed(written))
+					continue;
+				const VregPtr version = function.newVar(written->getType()? TypePtr(written->getType()->copy()) :
+					nullptr);
+				originals.resize(size_t(function.nextVariable), -1);
+				originals[version->id] = written->id;
+				instruction->replaceWritten(written, version);
+				stacks[written->id].push_back(version);
+				pushed[index].push_back(written->id);
+			}
+		}
+
+		for (const auto &weak_successor: block.successors) {
+			const auto successor = weak_successor.lock();
+			if (!successor)
+				continue;
+			for (const WhyPtr &instruction: successor->instructions) {
+				if (instruction->is<Label>())
+					continue;
+				auto *phi = instruction->cast<PhiInstruction>();
+				if (phi == nullptr)
+					break;
+				if (VregPtr *value = phi->find(&block))
+					*value = current(getOriginal(phi->destination->id));
+			}
+		}
+	};
+
+	// Walk the dominator tree without recursion, since CFGs can be deep.
+	std::vector<std::pair<size_t, size_t>> stack {{0, 0}};
+	enter(0);
+	while (!stack.empty()) {
+		auto &[index, next_child] = stack.back();
+		if (next_child < children[index].size()) {
+			const size_t child = children[index][next_child++];
+			enter(child);
+			stack.emplace_back(child, 0);
+			continue;
+		}
+		for (const int id: pushed[index])
+			stacks[id].pop_back();
+		stack.pop_back();
+	}
+}
+
+void SSA::destruct(bool changed) {
+	TimeReport::Timer timer(TimeReport::Phase::SSA);
+
+	if (!active)
+		return;
+	active = false;
+
+	if (!changed) {
+		restore();
+		return;
+	}
+
+	// Each phi becomes a copy from a fresh vreg at the start of its block, and each predecessor copies its incoming
+	// value into that vreg right before branching. The fresh vreg is only live between the two copies, which avoids the
+	// lost copy and swap problems and means critical edges don't have to be split.
+	std::vector<WhyPtr> copies;
+	for (const BasicBlockPtr &block: function.blocks)
+		for (auto iter = block->instructions.begin(); iter != block->instructions.end(); ++iter) {
+			if ((*iter)->is<Label>())
+				continue;
+			const auto phi = (*iter)->ptrcast<PhiInstruction>();
+			if (!phi)
+				break;
+
+			const VregPtr &destination = phi->destination;
+			const VregPtr merged = function.newVar(destination->getType()?
+				TypePtr(destination->getType()->copy()) : nullptr);
+			originals.resize(size_t(function.nextVariable), -1);
+			originals[merged->id] = getOriginal(destination->id);
+
+			for (const PhiInstruction::Incoming &entry: phi->incoming) {
+				const auto predecessor = entry.block.lock();
+				if (!predecessor)
+					continue;
+				auto copy = function.newInstruction<MoveInstruction>(entry.value, merged);
+				copy->setDebug(phi->debug);
+				copy->parent = predecessor;
+				predecessor->instructions.insert(beforeBranch(*predecessor), copy);
+				copies.push_back(copy);
+			}
+
+			auto copy = function.newInstruction<MoveInstruction>(merged, destination);
+			copy->setDebug(phi->debug);
+			copy->parent = block;
+			*iter = copy;
+			copies.push_back(copy);
+		}
+
+	function.relinearize();
+	function.computeLiveness();
+	coalesce(copies);
+	function.relinearize();
+	function.updateVregs();
+	function.computeLiveness();
+}
+
+void SSA::restore() {
+	for (const BasicBlockPtr &block: function.blocks)
+		for (auto iter = block->instructions.begin(); iter != block->instructions.end();) {
+			const WhyPtr &instruction = *iter;
+			if (instruction->is<PhiInstruction>()) {
+				iter = block->instructions.erase(iter);
+				continue;
+			}
+			for (const VregPtr &read: instruction->getRead())
+				if (function.isTracked(read) && firstVersion <= read->id)
+					instruction->replaceRead(read, function.vregTable.vreg(size_t(getOriginal(read->id))));
+			for (const VregPtr &written: instruction->getWritten())
+				if (function.isTracked(written) && firstVersion <= written->id)
+					instruction->replaceWritten(written, function.vregTable.vreg(size_t(getOriginal(written->id))));
+			++iter;
+		}
+
+	std::erase_if(function.virtualRegisters, [&](const VregPtr &vreg) {
+		return vreg->function == &function && firstVersion <= vreg->id;
+	});
+	function.nextVariable = firstVersion;
+	function.relinearize();
+	function.updateVregs();
+	function.computeLiveness();
+}
+
+void SSA::coalesce(const std::vector<WhyPtr> &copies) {
+	auto family = [&](const VregPtr &vreg) -> int {
+		if (!function.isTracked(vreg))
+			return -1;
+		const int original = getOriginal(vreg->id);
+		return original < firstVersion && renamed[original]? original : -1;
+	};
+
+	// Two versions of a vreg can share it unless one is defined while the other is live, with the exception of a copy
+	// from one to the other.
+	std::vector<bool> broken(size_t(firstVersion), false);
+	for (const BasicBlockPtr &block: function.blocks) {
+		Bitset live = block->liveOut;
+		for (auto iter = block->instructions.rbegin(), rend = block->instructions.rend(); iter != rend; ++iter) {
+			const WhyPtr &instruction = *iter;
+			const auto *move = instruction->cast<MoveInstruction>();
+			for (const VregPtr &written: instruction->getWritten()) {
+				const int written_family = family(written);
+				if (written_family != -1 && !broken[written_family])
+					live.forEach([&](size_t id) {
+						if (int(id) == written->id || (move != nullptr && move->leftSource->id == int(id)))
+							return;
+						if (const VregPtr &other = function.vregTable.vreg(id); other && family(other) == written_family)
+							broken[written_family] = true;
+					});
+			}
+			for (const VregPtr &written: instruction->getWritten())
+				if (function.isTracked(written))
+					live.reset(size_t(written->id));
+			for (const VregPtr &read: instruction->getRead())
+				if (function.isTracked(read))
+					live.set(size_t(read->id));
+		}
+	}
+
+	auto merge_target = [&](const VregPtr &vreg) -> VregPtr {
+		const int vreg_family = family(vreg);
+		if (vreg_family == -1 || vreg_family == vreg->id || broken[vreg_family])
+			return nullptr;
+		return function.vregTable.vreg(size_t(vreg_family));
+	};
+
+	bool changed = false;
+	for (const WhyPtr &instruction: function.instructions) {
+		for (const VregPtr &read: instruction->getRead())
+			if (const VregPtr target = merge_target(read)) {
+				instruction->replaceRead(read, target);
+				changed = true;
+			}
+		for (const VregPtr &written: instruction->getWritten())
+			if (const VregPtr target = merge_target(written)) {
+				instruction->replaceWritten(written, target);
+				changed = true;
+			}
+	}
+
+	if (!changed)
+		return;
+
+	for (const WhyPtr &copy: copies) {
+		const auto *move = copy->cast<MoveInstruction>();
+		if (move->leftSource == move->destination)
+			if (const auto block = copy->parent.lock())
+				block->instructions.erase(*copy->blockPosition);
+	}
+
+	bool versions_left = false;
+	for (auto iter = function.virtualRegisters.begin(); iter != function.virtualRegisters.end();) {
+		const VregPtr &vreg = *iter;
+		if (vreg->function == &function && firstVersion <= vreg->id) {
+			const int vreg_family = family(vreg);
+			if (vreg_family != -1 && !broken[vreg_family]) {
+				iter = function.virtualRegisters.erase(iter);
+				continue;
+			}
+			versions_left = true;
+		}
+		++iter;
+	}
+
+	// Without any versions left, the vreg IDs can be handed out again, which keeps liveness bitsets small.
+	if (!versions_left)
+		function.nextVariable = firstVersion;
+}
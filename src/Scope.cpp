@@ -1,12 +1,19 @@
 #include <algorithm>
 #include <sstream>
+#include <unordered_set>
 
 #include "Errors.h"
 #include "Function.h"
 #include "Program.h"
 #include "Scope.h"
+#include "StringSet.h"
 #include "Util.h"
 
+Scope::Scope(Program *program_): program(program_) {
+	if (program != nullptr)
+		++program->scopeGeneration;
+}
+
 struct Score {
 	int exact = 0;
 	int affinity = 0;
@@ -14,6 +21,34 @@ struct Score {
 	[[nodiscard]] bool match(const Score &other) const { return exact == other.exact && affinity == other.affinity; }
 };
 
+/** Returns the functions registered under a given unmangled name in declaration order. */
+static const Functions & overloads(const std::unordered_map<const std::string *, Functions> &map,
+                                   const std::string *name) {
+	static const Functions empty;
+	const auto iter = map.find(name);
+	return iter == map.end()? empty : iter->second;
+}
+
+/** Builds a key for Program::lookupCache out of a lookup's kind, name, struct name and types. */
+static std::string lookupKey(char kind, const std::string *function_name, const std::string &struct_name,
+                             const TypePtr &return_type, const Types &arg_types) {
+	std::string key = kind + *function_name + '\0' + struct_name + '\0';
+	if (return_type)
+		key += std::string(*return_type);
+	for (const TypePtr &arg_type: arg_types)
+		key += '\0' + std::string(*arg_type);
+	return key;
+}
+
+/** Returns the cached result of a lookup or computes and caches it. Lookups that throw aren't cached. */
+template <typename F>
+static const Functions & cachedLookup(Program &program, std::string key, F &&compute) {
+	auto iter = program.lookupCache.find(key);
+	if (iter == program.lookupCache.end())
+		iter = program.lookupCache.emplace(std::move(key), compute()).first;
+	return iter->second;
+}
+
 static Functions filterResults(const Functions &results, const Types &arg_types) {
 	if (results.empty())
 		return {};
@@ -56,9 +91,12 @@ static Functions filterResults(const Functions &results, const Types &arg_types)
 	return out;
 }
 
-FunctionPtr Scope::lookupFunction(const std::string &function_name, const TypePtr &return_type, const Types &arg_types,
+FunctionPtr Scope::lookupFunction(const std::string *function_name, const TypePtr &return_type, const Types &arg_types,
                                   const std::string &struct_name, const ASTLocation &location) const {
-	Functions filtered = filterResults(lookupFunctions(function_name, return_type, arg_types, struct_name), arg_types);
+	const Functions &filtered = cachedLookup(getProgram(),
+		lookupKey('r', function_name, struct_name, return_type, arg_types), [&] {
+			return filterResults(lookupFunctions(function_name, return_type, arg_types, struct_name), arg_types);
+		});
 
 	if (1 < filtered.size()) {
 		std::stringstream err;
@@ -67,7 +105,7 @@ FunctionPtr Scope::lookupFunction(const std::string &function_name, const TypePt
 			err << *return_type;
 		else
 			err << "<unknown>";
-		err << ' ' << function_name << '(';
+		err << ' ' << *function_name << '(';
 		for (size_t i = 0, max = arg_types.size(); i < max; ++i) {
 			if (i != 0)
 				err << ", ";
@@ -82,13 +120,14 @@ FunctionPtr Scope::lookupFunction(const std::string &function_name, const TypePt
 	return filtered.empty()? nullptr : filtered.front();
 }
 
-FunctionPtr Scope::lookupFunction(const std::string &function_name, const Types &arg_types,
+FunctionPtr Scope::lookupFunction(const std::string *function_name, const Types &arg_types,
                                   const std::string &struct_name, const ASTLocation &location) const {
-	Functions filtered = filterResults(lookupFunctions(function_name, arg_types, struct_name), arg_types);
+	const Functions &filtered = cachedLookup(getProgram(), lookupKey('a', function_name, struct_name, nullptr, arg_types),
+		[&] { return filterResults(lookupFunctions(function_name, arg_types, struct_name), arg_types); });
 
 	if (1 < filtered.size()) {
 		std::stringstream err;
-		err << "Multiple results found for " << function_name << '(';
+		err << "Multiple results found for " << *function_name << '(';
 		for (size_t i = 0, max = arg_types.size(); i < max; ++i) {
 			if (i != 0)
 				err << ", ";
@@ -103,50 +142,52 @@ FunctionPtr Scope::lookupFunction(const std::string &function_name, const Types
 	return filtered.empty()? nullptr : filtered.front();
 }
 
-FunctionPtr Scope::lookupFunction(const std::string &function_name, const ASTLocation &location) const {
-	Functions results = lookupFunctions(function_name);
+FunctionPtr Scope::lookupFunction(const std::string *function_name, const ASTLocation &location) const {
+	const Functions &results = cachedLookup(getProgram(), lookupKey('n', function_name, "", nullptr, {}),
+		[&] { return lookupFunctions(function_name); });
 	if (1 < results.size())
-		throw GenericError(location, "Multiple results found for " + function_name);
+		throw GenericError(location, "Multiple results found for " + *function_name);
 	return results.empty()? nullptr : results.front();
 }
 
 FunctionScope::FunctionScope(Function &function_, const std::shared_ptr<GlobalScope> &parent_):
 	Scope(&function_.program), function(function_), parent(parent_) {}
 
-VariablePtr FunctionScope::lookup(const std::string &name) const {
-	if (function.variables.count(name) == 0)
-		return parent->lookup(name);
-	return function.variables.at(name);
+VariablePtr FunctionScope::lookup(const std::string *name) const {
+	const auto iter = function.variables.find(name);
+	return iter == function.variables.end()? parent->lookup(name) : iter->second;
 }
 
-Functions FunctionScope::lookupFunctions(const std::string &function_name, const TypePtr &return_type,
+Functions FunctionScope::lookupFunctions(const std::string *function_name, const TypePtr &return_type,
                                          const Types &arg_types, const std::string &struct_name) const {
 	return parent->lookupFunctions(function_name, return_type, arg_types, struct_name);
 }
 
-Functions FunctionScope::lookupFunctions(const std::string &function_name, const Types &arg_types,
+Functions FunctionScope::lookupFunctions(const std::string *function_name, const Types &arg_types,
                                          const std::string &struct_name) const {
 	return parent->lookupFunctions(function_name, arg_types, struct_name);
 }
 
-Functions FunctionScope::lookupFunctions(const std::string &function_name) const {
+Functions FunctionScope::lookupFunctions(const std::string *function_name) const {
 	return parent->lookupFunctions(function_name);
 }
 
-TypePtr FunctionScope::lookupType(const std::string &name) const {
+TypePtr FunctionScope::lookupType(const std::string *name) const {
 	return parent->lookupType(name);
 }
 
-bool FunctionScope::doesConflict(const std::string &name) const {
+bool FunctionScope::doesConflict(const std::string *name) const {
 	// It's fine for local variables to shadow global variables.
 	return function.variables.count(name) != 0;
 }
 
 bool FunctionScope::insert(VariablePtr variable) {
-	if (doesConflict(variable->name))
+	const std::string *name = StringSet::intern(variable->name);
+	if (doesConflict(name))
 		return false;
-	function.variables.emplace(variable->name, variable);
+	function.variables.emplace(name, variable);
 	function.variableOrder.push_back(variable);
+	++function.program.scopeGeneration;
 	return true;
 }
 
@@ -154,100 +195,82 @@ std::string FunctionScope::partialStringify() const {
 	return parent->partialStringify() + " -> fn:" + function.name;
 }
 
-VariablePtr GlobalScope::lookup(const std::string &name) const {
-	if (program.globals.count(name) == 0)
-		return nullptr;
-	return program.globals.at(name);
+VariablePtr GlobalScope::lookup(const std::string *name) const {
+	const auto iter = program.globals.find(name);
+	return iter == program.globals.end()? nullptr : iter->second;
 }
 
-Functions GlobalScope::lookupFunctions(const std::string &function_name, const TypePtr &return_type,
+Functions GlobalScope::lookupFunctions(const std::string *function_name, const TypePtr &return_type,
                                        const Types &arg_types, const std::string &struct_name) const {
 	Functions out;
-	std::set<std::string> found_manglings;
-
-	{
-		auto [begin, end] = program.bareFunctions.equal_range(function_name);
-		for (auto iter = begin; iter != end; ++iter) {
-			bool should_add = false;
-			if (!return_type) {
-				should_add = (!iter->second->structParent && struct_name.empty())
-					|| (iter->second->structParent && iter->second->structParent->name == struct_name);
-			} else
-				should_add = iter->second->isMatch(return_type, arg_types, struct_name);
-			if (should_add) {
-				out.push_back(iter->second);
-				found_manglings.insert(iter->second->mangle());
-			}
-		}
-	} {
-		auto [begin, end] = program.bareFunctionDeclarations.equal_range(function_name);
-		for (auto iter = begin; iter != end; ++iter) {
-			bool should_add = false;
-			if (!return_type) {
-				should_add = (!iter->second->structParent && struct_name.empty())
-					|| (iter->second->structParent && iter->second->structParent->name == struct_name);
-			} else
-				should_add = iter->second->isMatch(return_type, arg_types, struct_name);
-			if (should_add && found_manglings.count(iter->second->mangle()) == 0)
-					out.push_back(iter->second);
+	std::unordered_set<std::string> found_manglings;
+
+	for (const FunctionPtr &function: overloads(program.bareFunctions, function_name)) {
+		bool should_add = false;
+		if (!return_type) {
+			should_add = (!function->structParent && struct_name.empty())
+				|| (function->structParent && function->structParent->name == struct_name);
+		} else
+			should_add = function->isMatch(return_type, arg_types, struct_name);
+		if (should_add) {
+			out.push_back(function);
+			found_manglings.insert(function->mangle());
 		}
 	}
+	for (const FunctionPtr &function: overloads(program.bareFunctionDeclarations, function_name)) {
+		bool should_add = false;
+		if (!return_type) {
+			should_add = (!function->structParent && struct_name.empty())
+				|| (function->structParent && function->structParent->name == struct_name);
+		} else
+			should_add = function->isMatch(return_type, arg_types, struct_name);
+		if (should_add && found_manglings.count(function->mangle()) == 0)
+			out.push_back(function);
+	}
 
 	return out;
 }
 
-Functions GlobalScope::lookupFunctions(const std::string &function_name, const Types &arg_types,
+Functions GlobalScope::lookupFunctions(const std::string *function_name, const Types &arg_types,
                                        const std::string &struct_name) const {
 	Functions out;
-	std::set<std::string> found_manglings;
-
-	{
-		auto [begin, end] = program.bareFunctions.equal_range(function_name);
-		for (auto iter = begin; iter != end; ++iter)
-			if (iter->second->isMatch(nullptr, arg_types, struct_name)) {
-				out.push_back(iter->second);
-				found_manglings.insert(iter->second->mangle());
-			}
-	} {
-		auto [begin, end] = program.bareFunctionDeclarations.equal_range(function_name);
-		for (auto iter = begin; iter != end; ++iter)
-			if (iter->second->isMatch(nullptr, arg_types, struct_name))
-				if (found_manglings.count(iter->second->mangle()) == 0)
-					out.push_back(iter->second);
-	}
+	std::unordered_set<std::string> found_manglings;
+
+	for (const FunctionPtr &function: overloads(program.bareFunctions, function_name))
+		if (function->isMatch(nullptr, arg_types, struct_name)) {
+			out.push_back(function);
+			found_manglings.insert(function->mangle());
+		}
+	for (const FunctionPtr &function: overloads(program.bareFunctionDeclarations, function_name))
+		if (function->isMatch(nullptr, arg_types, struct_name))
+			if (found_manglings.count(function->mangle()) == 0)
+				out.push_back(function);
 
 	return out;
 }
 
-Functions GlobalScope::lookupFunctions(const std::string &function_name) const {
+Functions GlobalScope::lookupFunctions(const std::string *function_name) const {
 	Functions out;
-	std::set<std::string> found_manglings;
-
-	{
-		auto [begin, end] = program.bareFunctions.equal_range(function_name);
-		for (auto iter = begin; iter != end; ++iter)
-			if (!iter->second->structParent) {
-				out.push_back(iter->second);
-				found_manglings.insert(iter->second->mangle());
-			}
-	} {
-		auto [begin, end] = program.bareFunctionDeclarations.equal_range(function_name);
-		for (auto iter = begin; iter != end; ++iter)
-			if (!iter->second->structParent && found_manglings.count(iter->second->mangle()) == 0)
-				out.push_back(iter->second);
-	}
+	std::unordered_set<std::string> found_manglings;
 
+	for (const FunctionPtr &function: overloads(program.bareFunctions, function_name))
+		if (!function->structParent) {
+			out.push_back(function);
+			found_manglings.insert(function->mangle());
+		}
+	for (const FunctionPtr &function: overloads(program.bareFunctionDeclarations, function_name))
+		if (!function->structParent && found_manglings.count(function->mangle()) == 0)
+			out.push_back(function);
 
 	return out;
 }
 
-TypePtr GlobalScope::lookupType(const std::string &name) const {
-	if (program.structs.count(name) != 0)
-		return program.structs.at(name);
-	return nullptr;
+TypePtr GlobalScope::lookupType(const std::string *name) const {
+	const auto iter = program.structs.find(name);
+	return iter == program.structs.end()? nullptr : iter->second;
 }
 
-bool GlobalScope::doesConflict(const std::string &name) const {
+bool GlobalScope::doesConflict(const std::string *name) const {
 	return program.globals.count(name) != 0;
 }
 
@@ -255,47 +278,50 @@ bool GlobalScope::insert(VariablePtr variable) {
 	if (!variable->is<Global>())
 		throw std::invalid_argument("Can't insert a non-global into a GlobalScope");
 
-	if (doesConflict(variable->name))
+	const std::string *name = StringSet::intern(variable->name);
+	if (doesConflict(name))
 		return false;
 
-	program.globals.emplace(variable->name, std::dynamic_pointer_cast<Global>(variable));
+	program.globals.emplace(name, std::dynamic_pointer_cast<Global>(variable));
+	++program.scopeGeneration;
 	return true;
 }
 
-VariablePtr BlockScope::lookup(const std::string &name) const {
-	if (variables.count(name) != 0)
-		return variables.at(name);
-	return parent->lookup(name);
+VariablePtr BlockScope::lookup(const std::string *name) const {
+	const auto iter = variables.find(name);
+	return iter == variables.end()? parent->lookup(name) : iter->second;
 }
 
-Functions BlockScope::lookupFunctions(const std::string &function_name, const TypePtr &return_type,
+Functions BlockScope::lookupFunctions(const std::string *function_name, const TypePtr &return_type,
                                       const Types &arg_types, const std::string &struct_name) const {
 	return parent->lookupFunctions(function_name, return_type, arg_types, struct_name);
 }
 
-Functions BlockScope::lookupFunctions(const std::string &function_name, const Types &arg_types,
+Functions BlockScope::lookupFunctions(const std::string *function_name, const Types &arg_types,
                                       const std::string &struct_name) const {
 	return parent->lookupFunctions(function_name, arg_types, struct_name);
 }
 
-Functions BlockScope::lookupFunctions(const std::string &function_name) const {
+Functions BlockScope::lookupFunctions(const std::string *function_name) const {
 	return parent->lookupFunctions(function_name);
 }
 
-TypePtr BlockScope::lookupType(const std::string &name) const {
+TypePtr BlockScope::lookupType(const std::string *name) const {
 	return parent->lookupType(name);
 }
 
-bool BlockScope::doesConflict(const std::string &name) const {
+bool BlockScope::doesConflict(const std::string *name) const {
 	// It's fine if the parent scope has a conflict because it can be shadowed in this scope.
 	return variables.count(name) != 0;
 }
 
 bool BlockScope::insert(VariablePtr variable) {
-	if (doesConflict(variable->name))
+	const std::string *name = StringSet::intern(variable->name);
+	if (doesConflict(name))
 		return false;
-	variables.emplace(variable->name, variable);
+	variables.emplace(name, variable);
 	variableOrder.push_back(variable);
+	++getProgram().scopeGeneration;
 	return true;
 }
 
@@ -0,0 +1,171 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+#include "TimeReport.h"
+
+static thread_local uint64_t allocationCount = 0;
+
+// Allocations are counted on every thread whether or not the report is enabled, since operator new has to be replaced
+// for the whole program anyway. A thread-local increment is all it costs.
+
+void * operator new(size_t size) {
+	++allocationCount;
+	if (void *pointer = std::malloc(size == 0? 1 : size))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void * operator new[](size_t size) {
+	return operator new(size);
+}
+
+// The nothrow forms have to be replaced as well, since the library's versions would pair its own allocation with the
+// std::free above (std::get_temporary_buffer uses them, for example).
+void * operator new(size_t size, const std::nothrow_t &) noexcept {
+	++allocationCount;
+	return std::malloc(size == 0? 1 : size);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) noexcept {
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void *pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+// Over-aligned types (BasicBlock, DFSResult and Context among them) go through the std::align_val_t forms instead, so
+// those are replaced too. std::aligned_alloc wants the size to be a multiple of the alignment.
+
+static void * alignedAllocate(size_t size, std::align_val_t alignment) noexcept {
+	++allocationCount;
+	const size_t align = size_t(alignment);
+	return std::aligned_alloc(align, size == 0? align : (size + align - 1) / align * align);
+}
+
+void * operator new(size_t size, std::align_val_t alignment) {
+	if (void *pointer = alignedAllocate(size, alignment))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void * operator new[](size_t size, std::align_val_t alignment) {
+	return operator new(size, alignment);
+}
+
+void * operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+	return alignedAllocate(size, alignment);
+}
+
+void * operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+	return alignedAllocate(size, alignment);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept {
+	std::free(pointer);
+}
+
+std::atomic_bool TimeReport::enabled = false;
+std::array<TimeReport::Totals, size_t(TimeReport::Phase::Count)> TimeReport::totals;
+
+TimeReport::Timer::Timer(Phase phase_): phase(phase_), active(enabled) {
+	if (!active)
+		return;
+	wallStart = std::chrono::steady_clock::now();
+	cpuStart = threadCPUTime();
+	allocationsStart = allocationCount;
+}
+
+TimeReport::Timer::~Timer() {
+	if (!active)
+		return;
+	Totals &phase_totals = totals[size_t(phase)];
+	++phase_totals.calls;
+	phase_totals.wallNanoseconds += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - wallStart).count());
+	phase_totals.cpuNanoseconds += threadCPUTime() - cpuStart;
+	phase_totals.allocations += allocationCount - allocationsStart;
+}
+
+uint64_t TimeReport::threadCPUTime() {
+	timespec time {};
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+		return 0;
+	return uint64_t(time.tv_sec) * 1'000'000'000 + uint64_t(time.tv_nsec);
+}
+
+const char * TimeReport::getName(Phase phase) {
+	switch (phase) {
+		case Phase::Parse:               return "parse";
+		case Phase::CompileRoot:         return "compileRoot";
+		case Phase::Lower:               return "lower";
+		case Phase::ExtractBlocks:       return "extractBlocks";
+		case Phase::Split:               return "split";
+		case Phase::Liveness:            return "computeLiveness";
+		case Phase::SSA:                 return "SSA";
+		case Phase::Optimize:            return "optimize";
+		case Phase::Allocate:            return "allocation attempt";
+		case Phase::ReplacePlaceholders: return "replacePlaceholders";
+		case Phase::Emit:                return "emit";
+		default:                         return "???";
+	}
+}
+
+void TimeReport::print(std::ostream &stream) {
+	char row[128];
+	std::snprintf(row, sizeof(row), "%-20s %8s %12s %12s %12s\n", "Phase", "Calls", "Wall (ms)", "CPU (ms)",
+		"Allocations");
+	stream << row;
+	for (size_t index = 0; index < totals.size(); ++index) {
+		const Totals &phase_totals = totals[index];
+		if (phase_totals.calls == 0)
+			continue;
+		std::snprintf(row, sizeof(row), "%-20s %8llu %12.3f %12.3f %12llu\n", getName(Phase(index)),
+			static_cast<unsigned long long>(phase_totals.calls.load()), double(phase_totals.wallNanoseconds) / 1e6,
+			double(phase_totals.cpuNanoseconds) / 1e6,
+			static_cast<unsigned long long>(phase_totals.allocations.load()));
+		stream << row;
+	}
+}
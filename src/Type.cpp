@@ -9,6 +9,7 @@
 #include "Parser.h"
 #include "Program.h"
 #include "Scope.h"
+#include "StringSet.h"
 #include "Type.h"
 
 Type & unwrap(Type &type) {
@@ -253,16 +254,16 @@ Type * Type::get(const ASTNode &node, Program &program, bool allow_forward) {
 			return new FunctionPointerType(Type::get(*node.front(), program), std::move(argument_types));
 		}
 		case CPMTOK_MOD: {
-			const std::string &struct_name = *node.front()->text;
+			const std::string *struct_name = node.front()->text;
 			if (program.structs.count(struct_name) != 0)
 				return program.structs.at(struct_name)->copy();
 			if (program.forwardDeclarations.count(struct_name) != 0) {
 				if (allow_forward)
-					return new StructType(program, struct_name);
-				throw GenericError(node.location, "Can't use forward declaration of " + struct_name +
+					return new StructType(program, *struct_name);
+				throw GenericError(node.location, "Can't use forward declaration of " + *struct_name +
 					" in this context");
 			}
-			throw ResolutionError(struct_name, nullptr);
+			throw ResolutionError(*struct_name, nullptr);
 		}
 		case CPMTOK_CONST: {
 			Type *subtype = Type::get(*node.front(), program, allow_forward);
@@ -271,7 +272,7 @@ Type * Type::get(const ASTNode &node, Program &program, bool allow_forward) {
 		}
 		default:
 			throw GenericError(node.location, "Invalid token in getType: " +
-				std::string(cpmParser.getName(node.symbol)));
+				std::string(node.getName()));
 	}
 }
 
@@ -321,9 +322,10 @@ Type * Type::get(const char * &mangled, Program &program) {
 				width = width * 10 + (mangled[0] - '0');
 			const std::string struct_name(mangled, width);
 			mangled += width;
-			if (program.structs.count(struct_name) != 0)
-				return program.structs.at(struct_name)->copy();
-			if (program.forwardDeclarations.count(struct_name) != 0)
+			const std::string *interned = StringSet::intern(struct_name);
+			if (program.structs.count(interned) != 0)
+				return program.structs.at(interned)->copy();
+			if (program.forwardDeclarations.count(interned) != 0)
 				return new StructType(program, struct_name);
 			throw std::runtime_error("Couldn't find struct " + struct_name);
 		}
@@ -475,9 +477,10 @@ TypePtr StructType::getFieldType(const std::string &field_name) const {
 
 const decltype(StructType::order) & StructType::getOrder() const {
 	if (isForwardDeclaration) {
-		if (program.structs.count(name) == 0)
+		const auto iter = program.structs.find(StringSet::intern(name));
+		if (iter == program.structs.end())
 			throw IncompleteStructError(name);
-		return program.structs.at(name)->order;
+		return iter->second->order;
 	}
 
 	return order;
@@ -485,9 +488,10 @@ const decltype(StructType::order) & StructType::getOrder() const {
 
 const decltype(StructType::map) & StructType::getMap() const {
 	if (isForwardDeclaration) {
-		if (program.structs.count(name) == 0)
+		const auto iter = program.structs.find(StringSet::intern(name));
+		if (iter == program.structs.end())
 			throw IncompleteStructError(name);
-		return program.structs.at(name)->map;
+		return iter->second->map;
 	}
 
 	return map;
@@ -495,9 +499,10 @@ const decltype(StructType::map) & StructType::getMap() const {
 
 const decltype(StructType::statics) & StructType::getStatics() const {
 	if (isForwardDeclaration) {
-		if (program.structs.count(name) == 0)
+		const auto iter = program.structs.find(StringSet::intern(name));
+		if (iter == program.structs.end())
 			throw IncompleteStructError(name);
-		return program.structs.at(name)->statics;
+		return iter->second->statics;
 	}
 
 	return statics;
@@ -505,9 +510,10 @@ const decltype(StructType::statics) & StructType::getStatics() const {
 
 FunctionPtr StructType::getDestructor() const {
 	if (isForwardDeclaration) {
-		if (program.structs.count(name) == 0)
+		const auto iter = program.structs.find(StringSet::intern(name));
+		if (iter == program.structs.end())
 			throw IncompleteStructError(name);
-		return program.structs.at(name)->destructor.lock();
+		return iter->second->destructor.lock();
 	}
 
 	return destructor.lock();
@@ -9,11 +9,10 @@ VirtualRegister::VirtualRegister(Function &function_, const std::shared_ptr<Type
 VirtualRegister::VirtualRegister(int id_, const std::shared_ptr<Type> &type_):
 	type(type_), id(id_) {}
 
-std::shared_ptr<VirtualRegister> VirtualRegister::init() {
-	auto ptr = shared_from_this();
+VirtualRegister * VirtualRegister::init() {
 	if (function != nullptr)
-		function->virtualRegisters.insert(ptr);
-	return ptr;
+		function->virtualRegisters.insert(this);
+	return this;
 }
 
 std::string VirtualRegister::regOrID(bool colored, bool with_type) const {
@@ -0,0 +1,107 @@
+#include <algorithm>
+
+#include "Variable.h"
+#include "VregTable.h"
+#include "WhyInstructions.h"
+
+static const VregPtr nullVreg;
+static const std::vector<WhyInstruction *> noInstructions;
+static const std::vector<BasicBlock *> noBlocks;
+
+template <typename T>
+static void appendUnique(std::vector<T *> &vector, T &item) {
+	// Lists are built in program order, so a repeat can only be at the end.
+	if (vector.empty() || vector.back() != &item)
+		vector.push_back(&item);
+}
+
+template <typename T>
+static const std::vector<T *> & lookup(const std::vector<std::vector<T *>> &column, const VirtualRegister &vreg,
+                                       const std::vector<T *> &empty) {
+	if (vreg.id < 0 || column.size() <= size_t(vreg.id))
+		return empty;
+	return column[vreg.id];
+}
+
+void VregTable::grow(size_t id) {
+	if (id < vregs.size())
+		return;
+	vregs.resize(id + 1);
+	readers.resize(id + 1);
+	writers.resize(id + 1);
+	readingBlocks.resize(id + 1);
+	writingBlocks.resize(id + 1);
+}
+
+void VregTable::clear(size_t id_bound) {
+	vregs.assign(id_bound, nullptr);
+	readers.assign(id_bound, {});
+	writers.assign(id_bound, {});
+	readingBlocks.assign(id_bound, {});
+	writingBlocks.assign(id_bound, {});
+}
+
+void VregTable::set(const VregPtr &vreg) {
+	grow(size_t(vreg->id));
+	vregs[vreg->id] = vreg;
+}
+
+void VregTable::clearVregs(size_t id_bound) {
+	if (0 < id_bound)
+		grow(id_bound - 1);
+	std::fill(vregs.begin(), vregs.end(), nullptr);
+}
+
+const VregPtr & VregTable::vreg(size_t id) const {
+	return id < vregs.size()? vregs[id] : nullVreg;
+}
+
+void VregTable::addReader(const VirtualRegister &vreg, WhyInstruction &instruction) {
+	grow(size_t(vreg.id));
+	appendUnique(readers[vreg.id], instruction);
+}
+
+void VregTable::addWriter(const VirtualRegister &vreg, WhyInstruction &instruction) {
+	grow(size_t(vreg.id));
+	appendUnique(writers[vreg.id], instruction);
+}
+
+void VregTable::addReadingBlock(const VirtualRegister &vreg, BasicBlock &block) {
+	grow(size_t(vreg.id));
+	appendUnique(readingBlocks[vreg.id], block);
+}
+
+void VregTable::addWritingBlock(const VirtualRegister &vreg, BasicBlock &block) {
+	grow(size_t(vreg.id));
+	appendUnique(writingBlocks[vreg.id], block);
+}
+
+void VregTable::removeInstruction(WhyInstruction &instruction) {
+	auto remove_from = [&](std::vector<std::vector<WhyInstruction *>> &column, const VregPtr &vreg) {
+		if (vreg->id < 0 || column.size() <= size_t(vreg->id))
+			return;
+		auto &list = column[vreg->id];
+		list.erase(std::remove(list.begin(), list.end(), &instruction), list.end());
+	};
+
+	for (const VregPtr &vreg: instruction.getRead())
+		remove_from(readers, vreg);
+	for (const VregPtr &vreg: instruction.getWritten())
+		remove_from(writers, vreg);
+}
+
+const std::vector<WhyInstruction *> & VregTable::getReaders(const VirtualRegister &vreg) const {
+	return lookup(readers, vreg, noInstructions);
+}
+
+const std::vector<WhyInstruction *> & VregTable::getWriters(const VirtualRegister &vreg) const {
+	return lookup(writers, vreg, noInstructions);
+}
+
+const std::vector<BasicBlock *> & VregTable::getReadingBlocks(const VirtualRegister &vreg) const {
+	return lookup(readingBlocks, vreg, noBlocks);
+}
+
+const std::vector<BasicBlock *> & VregTable::getWritingBlocks(const VirtualRegister &vreg) const {
+	return lookup(writingBlocks, vreg, noBlocks);
+}
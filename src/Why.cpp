@@ -25,6 +25,10 @@ bool Why::isArgumentRegister(int reg) {
 	return argumentOffset <= reg && reg < argumentOffset + argumentCount;
 }
 
+bool Why::isReturnValueRegister(int reg) {
+	return returnValueOffset <= reg && reg < returnValueOffset + returnValueCount;
+}
+
 std::string Why::registerName(int reg) {
 	switch (reg) {
 		case              zeroOffset: return "0";
@@ -1,3 +1,4 @@
+#include "BasicBlock.h"
 #include "WhyInstructions.h"
 #include "Type.h"
 
@@ -71,3 +72,29 @@ OperandType SextInstruction::getType(const VregPtr &source, int width) {
 	}
 	return out;
 }
+
+VregPtr * PhiInstruction::find(const BasicBlock *block) {
+	for (Incoming &entry: incoming)
+		if (entry.block.lock().get() == block)
+			return &entry.value;
+	return nullptr;
+}
+
+PhiInstruction::operator std::vector<std::string>() const {
+	std::string out = "phi";
+	for (const Incoming &entry: incoming) {
+		const auto block = entry.block.lock();
+		out += " [" + entry.value->regOrID() + ", @" + (block? block->label : "?") + "]";
+	}
+	return {out + " -> " + destination->regOrID()};
+}
+
+std::vector<std::string> PhiInstruction::colored() const {
+	std::string out = "\e[36mphi\e[39m";
+	for (const Incoming &entry: incoming) {
+		const auto block = entry.block.lock();
+		out += " \e[2m[\e[22m" + entry.value->regOrID(true) + ", \e[36m@\e[39m\e[38;5;202m" +
+			(block? block->label : "?") + "\e[39m\e[2m]\e[22m";
+	}
+	return {out + o("->") + destination->regOrID(true)};
+}
@@ -0,0 +1,54 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <unistd.h>
+
+#include "Writer.h"
+
+Writer::Writer(int fd_, size_t capacity): fd(fd_), buffer(std::max<size_t>(capacity, 1)) {}
+
+Writer::~Writer() {
+	try {
+		flush();
+	} catch (const std::system_error &) {}
+}
+
+Writer & Writer::write(const char *data, size_t size) {
+	if (buffer.size() - used < size) {
+		flush();
+		// Anything too large for the buffer is written directly instead of being split up.
+		if (buffer.size() < size) {
+			while (0 < size) {
+				const ssize_t written = ::write(fd, data, size);
+				if (written < 0) {
+					if (errno == EINTR)
+						continue;
+					throw std::system_error(errno, std::generic_category(), "Couldn't write output");
+				}
+				data += written;
+				size -= size_t(written);
+			}
+			return *this;
+		}
+	}
+	std::memcpy(buffer.data() + used, data, size);
+	used += size;
+	return *this;
+}
+
+void Writer::flush() {
+	size_t offset = 0;
+	while (offset < used) {
+		const ssize_t written = ::write(fd, buffer.data() + offset, used - offset);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			// Drop the unwritten output so that the destructor doesn't try again.
+			used = 0;
+			throw std::system_error(errno, std::generic_category(), "Couldn't write output");
+		}
+		offset += size_t(written);
+	}
+	used = 0;
+}
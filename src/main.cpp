@@ -1,9 +1,11 @@
-#include <cstring>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
+#include <unistd.h>
 #include <vector>
 
 #include "Errors.h"
@@ -11,8 +13,10 @@
 #include "Lexer.h"
 #include "Parser.h"
 #include "Program.h"
+#include "TimeReport.h"
 #include "Type.h"
 #include "Util.h"
+#include "Writer.h"
 
 // #define CATCH_COMPILE
 
@@ -33,31 +37,132 @@ std::string demangle(const char *name) {
 
 int main(int argc, char **argv) {
 	if (argc <= 1) {
-		std::cerr << "Usage: " << argv[0] << " <input>\n";
+		std::cerr << "Usage: " << argv[0] << " <input> [-d] [-j <jobs>] [--interference precise|cliques] [--allocator auto|coloring|linear] [--no-optimize] [--alloc-report] [--time-report] [--stats <path>]\n";
 		return 1;
 	}
 
-	const std::string input = Util::read(argv[1]);
-
-	cpmParser.in(input);
-	cpmParser.debug(false, false);
-	cpmParser.parse();
-
-	if (cpmParser.errorCount == 0) {
 #ifdef CATCH_COMPILE
-		bool should_try = true;
+	bool should_try = true;
 #else
-		bool should_try = false;
+	bool should_try = false;
 #endif
-		if (2 < argc && strcmp(argv[2], "-d") == 0)
+	size_t jobs = 1;
+	InterferenceMode interference_mode = InterferenceMode::Precise;
+	AllocatorChoice allocator_choice = AllocatorChoice::Auto;
+	bool allocation_report = false;
+	bool optimize = true;
+	std::string stats_path;
+
+	for (int i = 2; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "-d") {
 			should_try = true;
+		} else if (arg.substr(0, 2) == "-j") {
+			std::string count = arg.substr(2);
+			if (count.empty()) {
+				if (++i == argc) {
+					std::cerr << "Expected a job count after -j\n";
+					return 1;
+				}
+				count = argv[i];
+			}
+			int64_t parsed = -1;
+			try {
+				parsed = Util::parseLong(count);
+			} catch (const std::invalid_argument &) {}
+			if (parsed < 0) {
+				std::cerr << "Invalid job count: " << count << '\n';
+				return 1;
+			}
+			jobs = size_t(parsed);
+			if (jobs == 0)
+				jobs = std::max(1u, std::thread::hardware_concurrency());
+		} else if (arg == "--interference") {
+			if (++i == argc) {
+				std::cerr << "Expected precise or cliques after --interference\n";
+				return 1;
+			}
+			const std::string mode = argv[i];
+			if (mode == "precise") {
+				interference_mode = InterferenceMode::Precise;
+			} else if (mode == "cliques") {
+				interference_mode = InterferenceMode::BlockCliques;
+			} else {
+				std::cerr << "Invalid interference mode: " << mode << '\n';
+				return 1;
+			}
+		} else if (arg == "--allocator") {
+			if (++i == argc) {
+				std::cerr << "Expected auto, coloring or linear after --allocator\n";
+				return 1;
+			}
+			const std::string choice = argv[i];
+			if (choice == "auto") {
+				allocator_choice = AllocatorChoice::Auto;
+			} else if (choice == "coloring") {
+				allocator_choice = AllocatorChoice::Coloring;
+			} else if (choice == "linear") {
+				allocator_choice = AllocatorChoice::LinearScan;
+			} else {
+				std::cerr << "Invalid allocator: " << choice << '\n';
+				return 1;
+			}
+		} else if (arg == "--no-optimize") {
+			optimize = false;
+		} else if (arg == "--alloc-report") {
+			allocation_report = true;
+		} else if (arg == "--time-report") {
+			TimeReport::enabled = true;
+		} else if (arg == "--stats") {
+			if (++i == argc) {
+				std::cerr << "Expected a path after --stats\n";
+				return 1;
+			}
+			stats_path = argv[i];
+		} else {
+			std::cerr << "Unknown option: " << arg << '\n';
+			return 1;
+		}
+	}
+
+	Parser parser(Parser::Type::Cpm);
+	parser.map(argv[1]);
+	parser.debug(false, false);
+	{
+		TimeReport::Timer timer(TimeReport::Phase::Parse);
+		parser.parse();
+	}
+
+	if (parser.errorCount == 0) {
+		Writer writer(STDOUT_FILENO);
+
+		auto compile_root = [&] {
+			TimeReport::Timer timer(TimeReport::Phase::CompileRoot);
+			return compileRoot(*parser.root, argv[1]);
+		};
+
+		auto compile = [&] {
+			Program program = compile_root();
+			program.interferenceMode = interference_mode;
+			program.allocatorChoice = allocator_choice;
+			program.allocationReport = allocation_report;
+			program.optimize = optimize;
+			program.compile(writer, jobs);
+			writer.flush();
+			if (!stats_path.empty()) {
+				std::ofstream stats(stats_path);
+				if (!stats.is_open())
+					throw std::runtime_error("Couldn't open " + stats_path + " for writing");
+				program.writeStats(stats);
+			}
+			success() << "Done.\n";
+			if (TimeReport::enabled)
+				TimeReport::print(std::cerr);
+		};
+
 		if (should_try) {
 			try {
-				Program program = compileRoot(*cpmParser.root, argv[1]);
-				program.compile();
-				for (const std::string &line: program.lines)
-					std::cout << line << '\n';
-				success() << "Done.\n";
+				compile();
 			} catch (std::exception &err) {
 				std::cerr << "\e[38;5;88;1m    ..............\n\e[38;5;196;1m   ::::::::::::::::::\n\e[38;5;202;1m  :::::::::::::::\n\e[38;5;208;1m :::`::::::: :::     :    \e[0;31m" << demangle(typeid(err).name()) << "\e[0;38;5;208;1m\n\e[38;5;142;1m :::: ::::: :::::    :    \e[0m" << err.what() << "\e[0m\e[38;5;142;1m\n\e[38;5;40;1m :`   :::::;     :..~~    \e[0m";
 				if (auto *located = dynamic_cast<GenericError *>(&err))
@@ -65,14 +170,9 @@ int main(int argc, char **argv) {
 						std::cerr << "Location: " << located->location;
 				std::cerr << "\e[38;5;40;1m\n\e[38;5;44;1m :   ::  :::.     :::.\n\e[38;5;39;1m :...`:, :::::...:::\n\e[38;5;27;1m::::::.  :::::::::'      \e[0m\e[38;5;27;1m\n\e[38;5;92;1m ::::::::|::::::::  !\n\e[38;5;88;1m :;;;;;;;;;;;;;;;;']}\n\e[38;5;196;1m ;--.--.--.--.--.-\n\e[38;5;202;1m  \\/ \\/ \\/ \\/ \\/ \\/\n\e[38;5;208;1m     :::       ::::\n\e[38;5;142;1m      :::      ::\n\e[38;5;40;1m     :\\:      ::\n\e[38;5;44;1m   /\\::    /\\:::    \n\e[38;5;39;1m ^.:^:.^^^::`::\n\e[38;5;27;1m ::::::::.::::\n\e[38;5;92;1m  .::::::::::\n";
 			}
-		} else {
-			Program program = compileRoot(*cpmParser.root, argv[1]);
-			program.compile();
-			for (const std::string &line: program.lines)
-				std::cout << line << '\n';
-			success() << "Done.\n";
-		}
+		} else
+			compile();
 	}
 
-	cpmParser.done();
+	parser.done();
 }
@@ -31,9 +31,12 @@ using AN = ASTNode;
 %verbose
 
 %define api.prefix {cpm}
+%define api.pure full
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {Parser &parser}
 
 %initial-action {
-    cpmParser.root = new ASTNode(cpmParser, CPMTOK_ROOT, ASTLocation(), "");
+    parser.root = new ASTNode(parser, CPMTOK_ROOT, ASTLocation(), "");
 }
 
 %token CPMTOK_ROOT CPMTOK_NUMBER CPMTOK_IDENT CPMTOK_STRING CPMTOK_CHAR
@@ -158,7 +161,7 @@ program: program decl_or_def ";" { $$ = $1->adopt($2); D($3); }
        | program meta { $$ = $1->adopt($2); }
        | program forward_decl { $$ = $1->adopt($2); }
        | program struct_def { $$ = $1->adopt($2); }
-       | { $$ = cpmParser.root; };
+       | { $$ = parser.root; };
 
 meta_start: "#name" | "#author" | "#orcid" | "#version";
 
@@ -175,16 +178,16 @@ statement: block
          | "break" ";" { D($2); }
          | "continue" ";" { D($2); }
          | "delete" expr ";" { $$ = $1->adopt($2); D($3); }
-         | ";" { $1->symbol = CPM_EMPTY; }
+         | ";" { $$ = new ASTNode(parser, CPM_EMPTY); }
          | inline_asm;
 
 inline_asm: "asm" "(" string ":" _exprlist ":" _exprlist ")" { $$ = $1->adopt({$3, $5, $7}); D($2, $4, $6, $8); }
-          | "asm" "(" string "::" _exprlist ")" { $$ = $1->adopt({$3, new ASTNode(cpmParser, CPM_LIST), $5}); D($2, $4, $6); }
+          | "asm" "(" string "::" _exprlist ")" { $$ = $1->adopt({$3, new ASTNode(parser, CPM_LIST), $5}); D($2, $4, $6); }
           | "asm" "(" string ":" _exprlist ")" { $$ = $1->adopt({$3, $5}); D($2, $4, $6); }
           | "asm" "(" string ")" { $$ = $1->adopt({$3}); D($2, $4); };
 
-declaration: type ident { $$ = (new ASTNode(cpmParser, CPM_DECL, $1->location))->adopt({$1, $2}); }
-definition:  type ident "=" expr { $$ = (new ASTNode(cpmParser, CPM_DECL, $1->location))->adopt({$1, $2, $4}); D($3); }
+declaration: type ident { $$ = (new ASTNode(parser, CPM_DECL, $1->location))->adopt({$1, $2}); }
+definition:  type ident "=" expr { $$ = (new ASTNode(parser, CPM_DECL, $1->location))->adopt({$1, $2, $4}); D($3); }
 decl_or_def: declaration | definition;
 
 forward_decl: "struct" CPMTOK_IDENT ";" { $$ = $1->adopt($2); D($3); };
@@ -193,16 +196,16 @@ struct_def: "struct" CPMTOK_IDENT "{" struct_list "}" ";" { $$ = $1->adopt({$2,
 
 struct_list: struct_list type CPMTOK_IDENT ";" { $$ = $1->adopt($3->adopt($2)); D($4); }
            | struct_list function_decl { $$ = $1->adopt($2); }
-           | struct_list "static" function_decl { $$ = $1->adopt($3); $3->attributes.insert("static"); D($2); }
-           | struct_list "static" type CPMTOK_IDENT ";" { $$ = $1->adopt($4->adopt($3)); $4->attributes.insert("static"); D($2, $5); }
-           | struct_list "static" type CPMTOK_IDENT "=" expr ";" { $$ = $1->adopt($4->adopt({$3, $6})); $4->attributes.insert("static"); D($2, $5, $7); }
+           | struct_list "static" function_decl { $$ = $1->adopt($3); $3->setAttribute(AN::Attribute::Static); D($2); }
+           | struct_list "static" type CPMTOK_IDENT ";" { $$ = $1->adopt($4->adopt($3)); $4->setAttribute(AN::Attribute::Static); D($2, $5); }
+           | struct_list "static" type CPMTOK_IDENT "=" expr ";" { $$ = $1->adopt($4->adopt({$3, $6})); $4->setAttribute(AN::Attribute::Static); D($2, $5, $7); }
            | struct_list "~" ";" { $$ = $1->adopt($2); D($3); }
            | struct_list "+" "(" _arglist ")" fnattrs ";" { $$ = $1->adopt($2->adopt({$4, $6})); D($3, $5, $7); $2->symbol = CPM_CONSTRUCTORDECL; };
-           | { $$ = new ASTNode(cpmParser, CPM_LIST); };
+           | { $$ = new ASTNode(parser, CPM_LIST); };
 
 function_def: type ident "(" _arglist ")" fnattrs block { $$ = $2->adopt({$1, $4, $6, $7}); D($3, $5); }
             | type ident "::" ident "(" _arglist ")" fnattrs block { $$ = $4->adopt({$1, $6, $8, $9, $2}); D($3, $5, $7); }
-            | "~" ident fnattrs block { $$ = $1->adopt({new ASTNode(cpmParser, CPMTOK_VOID), new ASTNode(cpmParser, CPM_LIST), $3, $4, $2}); $1->symbol = CPMTOK_IDENT; }
+            | "~" ident fnattrs block { $$ = $1->adopt({new ASTNode(parser, CPMTOK_VOID), new ASTNode(parser, CPM_LIST), $3, $4, $2}); $1->symbol = CPMTOK_IDENT; }
             | "static" type ident "::" ident "(" _arglist ")" fnattrs block { $$ = $5->adopt({$2, $7, $9, $10, $3, $1}); D($4, $6, $8); }
             | type "operator" oper "(" _arglist ")" fnattrs block { $$ = $2->adopt({$1, $3, $5, $7, $8}); D($4, $6); }
             | constructor_def;
@@ -221,14 +224,14 @@ constructor_def: "+" ident "(" _arglist ")" fnattrs block { $$ = $1->adopt({$2,
 function_decl: type ident "(" _arglist ")" fnattrs ";" { $$ = $2->adopt({$1, $4, $6}); $$->symbol = CPM_FNDECL; D($3, $5, $7); };
 
 fnattrs: fnattrs fnattr { $$ = $1->adopt($2); }
-       | { $$ = new ASTNode(cpmParser, CPM_LIST); };
+       | { $$ = new ASTNode(parser, CPM_LIST); };
 
 fnattr: "#naked" | "#const" | "#saved";
 
 block: "{" statements "}" { $$ = $2; D($1, $3); };
 
 statements: statements statement { $$ = $1->adopt($2); }
-          | { $$ = new ASTNode(cpmParser, CPM_BLOCK); };
+          | { $$ = new ASTNode(parser, CPM_BLOCK); };
 
 conditional: "if" "(" expr ")" statement "else" statement { $$ = $1->adopt({$3, $5, $7}); D($2, $4, $6); }
            | "if" "(" expr ")" statement { $$ = $1->adopt({$3, $5}); D($2, $4); };
@@ -237,8 +240,8 @@ while_loop: "while" "(" expr ")" statement { $$ = $1->adopt({$3, $5}); D($2, $4)
 
 for_loop: "for" "(" _decl_or_def ";" _expr ";" _expr ")" statement { $$ = $1->adopt({$3, $5, $7, $9}); D($2, $4, $6, $8); };
 
-_expr: expr | { $$ = new ASTNode(cpmParser, CPM_EMPTY); };
-_decl_or_def: decl_or_def | { $$ = new ASTNode(cpmParser, CPM_EMPTY); };
+_expr: expr | { $$ = new ASTNode(parser, CPM_EMPTY); };
+_decl_or_def: decl_or_def | { $$ = new ASTNode(parser, CPM_EMPTY); };
 
 expr: expr "&&"  expr { $$ = $2->adopt({$1, $3}); }
     | expr "||"  expr { $$ = $2->adopt({$1, $3}); }
@@ -296,7 +299,7 @@ expr: expr "&&"  expr { $$ = $2->adopt({$1, $3}); }
     | string
     | CPMTOK_CHAR
     | "[" _exprlist "]" { $$ = $2; $$->symbol = CPM_INITIALIZER; D($1, $3); }
-    | "%" "[" _exprlist "]" { $$ = $3; $$->symbol = CPM_INITIALIZER; $$->attributes.insert("constructor"); D($1, $2, $4); }
+    | "%" "[" _exprlist "]" { $$ = $3; $$->symbol = CPM_INITIALIZER; $$->setAttribute(AN::Attribute::Constructor); D($1, $2, $4); }
     | "new" new_type "(" _exprlist ")" %prec "new" { $$ = $1->adopt({$2, $4}); D($3, $5); }
     | struct_type "::" CPMTOK_IDENT { $$ = $2->adopt({$1, $3}); }
     | "null";
@@ -314,9 +317,9 @@ function_call: ident "(" _exprlist ")" { $$ = $2->adopt({$1, $3}); D($4); };
 constructor_call: struct_type "(" _exprlist ")" { $$ = $2->adopt({$1, $3}); D($4); };
 
 exprlist: exprlist "," expr { $$ = $1->adopt($3); D($2); }
-        | expr { $$ = (new ASTNode(cpmParser, CPM_LIST))->locate($1)->adopt($1); };
+        | expr { $$ = (new ASTNode(parser, CPM_LIST))->locate($1)->adopt($1); };
 
-_exprlist: exprlist | { $$ = new ASTNode(cpmParser, CPM_LIST); };
+_exprlist: exprlist | { $$ = new ASTNode(parser, CPM_LIST); };
 
 signed_type:   "s8" | "s16" | "s32" | "s64";
 unsigned_type: "u8" | "u16" | "u32" | "u64";
@@ -328,12 +331,12 @@ reference_type: type "&" { $$ = $2->adopt($1); };
 
 array_type: type "[" expr "]" { $$ = $2->adopt({$1, $3}); D($4); };
 
-fnptr_type: type "(" _typelist ")" "*" { $$ = (new ASTNode(cpmParser, CPM_FNPTR))->locate($1)->adopt({$1, $3}); D($2, $4, $5); };
+fnptr_type: type "(" _typelist ")" "*" { $$ = (new ASTNode(parser, CPM_FNPTR))->locate($1)->adopt({$1, $3}); D($2, $4, $5); };
 
 typelist: typelist "," type { $$ = $1->adopt($3); D($2); }
-        | type { $$ = (new ASTNode(cpmParser, CPM_LIST))->locate($1)->adopt($1); };
+        | type { $$ = (new ASTNode(parser, CPM_LIST))->locate($1)->adopt($1); };
 
-_typelist: typelist | { $$ = new ASTNode(cpmParser, CPM_LIST); };
+_typelist: typelist | { $$ = new ASTNode(parser, CPM_LIST); };
 
 struct_type: "%" CPMTOK_IDENT { $$ = $1->adopt($2); };
 
@@ -344,9 +347,9 @@ type: "bool" | int_type | "void" | pointer_type | reference_type | array_type |
 arg: type ident { $$ = $2->adopt($1); };
 
 arglist: arglist "," arg { $$ = $1->adopt($3); D($2); }
-       | arg { $$ = (new ASTNode(cpmParser, CPM_LIST))->locate($1)->adopt($1); };
+       | arg { $$ = (new ASTNode(parser, CPM_LIST))->locate($1)->adopt($1); };
 
-_arglist: arglist | { $$ = new ASTNode(cpmParser, CPM_LIST); };
+_arglist: arglist | { $$ = new ASTNode(parser, CPM_LIST); };
 
 number: CPMTOK_NUMBER;
 ident:  CPMTOK_IDENT;
@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 
 #include "ASTNode.h"
@@ -21,6 +25,65 @@ std::ostream & operator<<(std::ostream &os, const ASTLocation &location) {
 	return os;
 }
 
+namespace {
+	/** Carves AST nodes out of large chunks. A deleted node goes onto the free list for its size class and is reused by
+	 *  the next node of that class, so a parse makes one allocation per chunk instead of one or more per node. Chunks
+	 *  are only released at exit. Larger objects (some WASM nodes) go straight to the global allocator. */
+	class NodePool {
+		private:
+			static constexpr size_t granularity = 16, maxSize = 256, chunkSize = 64 * 1024;
+			std::mutex mutex;
+			std::vector<std::unique_ptr<std::byte[]>> chunks;
+			std::array<void *, maxSize / granularity + 1> freeLists {};
+			std::byte *next = nullptr, *limit = nullptr;
+
+		public:
+			static bool handles(size_t size) { return size <= maxSize; }
+
+			void * allocate(size_t size) {
+				const size_t size_class = (size + granularity - 1) / granularity;
+				std::unique_lock lock(mutex);
+				if (void *out = freeLists[size_class]) {
+					freeLists[size_class] = *static_cast<void **>(out);
+					return out;
+				}
+				const size_t rounded = size_class * granularity;
+				if (next == nullptr || size_t(limit - next) < rounded) {
+					chunks.emplace_back(new std::byte[chunkSize]);
+					next = chunks.back().get();
+					limit = next + chunkSize;
+				}
+				void *out = next;
+				next += rounded;
+				return out;
+			}
+
+			void deallocate(void *pointer, size_t size) {
+				const size_t size_class = (size + granularity - 1) / granularity;
+				std::unique_lock lock(mutex);
+				*static_cast<void **>(pointer) = freeLists[size_class];
+				freeLists[size_class] = pointer;
+			}
+	};
+
+	/** The pool is never destroyed, so nodes that outlive static destructors can still be deleted. */
+	NodePool & nodePool() {
+		static NodePool &pool = *new NodePool;
+		return pool;
+	}
+}
+
+void * ASTNode::operator new(size_t size) {
+	return NodePool::handles(size)? nodePool().allocate(size) : ::operator new(size);
+}
+
+void ASTNode::operator delete(void *pointer, size_t size) {
+	if (NodePool::handles(size))
+		nodePool().deallocate(pointer, size);
+	else
+		::operator delete(pointer);
+}
+
 ASTNode::ASTNode(Parser &parser_, int sym, const ASTLocation &loc, const char *info):
 	parser(&parser_), symbol(sym), location(loc), text(StringSet::intern(info)) {}
 
@@ -28,10 +91,10 @@ ASTNode::ASTNode(Parser &parser_, int sym, const ASTLocation &loc, const std::st
 	parser(&parser_), symbol(sym), location(loc), text(info) {}
 
 ASTNode::ASTNode(Parser &parser_, int sym, const std::string *info):
-	parser(&parser_), symbol(sym), location(cpmLexer.location), text(info) {}
+	parser(&parser_), symbol(sym), location(parser_.lexer.location), text(info) {}
 
 ASTNode::ASTNode(Parser &parser_, int sym, const char *info):
-	parser(&parser_), symbol(sym), location(cpmLexer.location), text(StringSet::intern(info)) {}
+	parser(&parser_), symbol(sym), location(parser_.lexer.location), text(StringSet::intern(info)) {}
 
 ASTNode::ASTNode(Parser &parser_, int sym, const ASTLocation &loc): ASTNode(parser_, sym, loc, "") {}
 
@@ -57,7 +120,7 @@ ASTNode * ASTNode::operator[](size_t index) const {
 }
 
 ASTNode * ASTNode::at(size_t index) const {
-	return *std::next(children.begin(), ssize_t(index));
+	return children.at(index);
 }
 
 size_t ASTNode::size() const {
@@ -91,12 +154,8 @@ ASTNode * ASTNode::absorb(ASTNode *to_absorb) {
 
 	locate(to_absorb);
 
-	for (auto iter = children.begin(), end = children.end(); iter != end; ++iter) {
-		if (*iter == to_absorb) {
-			children.erase(iter);
-			break;
-		}
-	}
+	if (auto iter = std::find(children.begin(), children.end(), to_absorb); iter != children.end())
+		children.erase(iter);
 
 	for (ASTNode *child: to_absorb->children)
 		adopt(child);
@@ -119,6 +178,7 @@ ASTNode * ASTNode::copy() const {
 	out->location = location;
 	out->text = text;
 	out->parent = parent;
+	out->children.reserve(children.size());
 	for (ASTNode *child: children) {
 		ASTNode *copy = child->copy();
 		copy->parent = out;
@@ -232,7 +292,8 @@ std::string ASTNode::style() const {
 }
 
 std::string ASTNode::extractName() const {
-	if ((parser == &wasmParser && symbol == WASMTOK_STRING) || (parser == &cpmParser && symbol == CPMTOK_STRING))
+	if ((parser->type == Parser::Type::Wasm && symbol == WASMTOK_STRING) ||
+		(parser->type == Parser::Type::Cpm && symbol == CPMTOK_STRING))
 		return text->substr(1, text->size() - 2);
 	throw GenericError(location, "extractName() was called on an inappropriate symbol: " +
 		std::string(parser->getName(symbol)));
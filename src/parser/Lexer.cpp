@@ -5,16 +5,11 @@
 #include "Parser.h"
 #include "Util.h"
 
-Lexer cpmLexer(cpmParser, cpmleng, cpmlval);
-Lexer wasmLexer(wasmParser, wasmleng, wasmlval);
+Lexer::Lexer(Parser &parser_): parser(&parser_) {}
 
-Lexer::Lexer(Parser &parser_, yysize &yyleng_ref, ASTNode *&yylval_ref):
-	parser(&parser_), leng(&yyleng_ref), lval(&yylval_ref) {}
-
-void Lexer::advance(const char *text) {
-	line += text;
+void Lexer::advance(const char *text, yysize length) {
 	location.column += lastYylength;
-	lastYylength = *leng;
+	lastYylength = length;
 
 	size_t newline_count = 0;
 	size_t i = 0;
@@ -31,14 +26,11 @@ void Lexer::advance(const char *text) {
 
 	if (1 < newline_count) {
 		lastYylength = int(col);
-		line.clear();
 		location.line += newline_count;
 	}
 }
 
 void Lexer::newline() {
-	lines.insert({location.line, line});
-	line.clear();
 	++location.line;
 	location.column = 0;
 }
@@ -55,35 +47,36 @@ void Lexer::badchar(unsigned char ch) {
 	}
 }
 
-int Lexer::token(const char *text, int symbol) {
-	*lval = new ASTNode(*parser, symbol, location, text);
-	return symbol;
-}
+int Lexer::token(const char *text, int symbol, ASTNode *&lval) {
+	// The grammar throws away closing brackets, opening braces, commas, colons and semicolons as soon as it sees them.
+	if (parser->type == Parser::Type::Cpm) {
+		switch (symbol) {
+			case CPMTOK_RPAREN:
+			case CPMTOK_RSQUARE:
+			case CPMTOK_LBRACE:
+			case CPMTOK_RBRACE:
+			case CPMTOK_COMMA:
+			case CPMTOK_COLON:
+			case CPMTOK_SEMI:
+				lval = nullptr;
+				return symbol;
+			default:
+				break;
+		}
+	}
 
-void cpmerror(const std::string &message) {
-	cpmerror(message, cpmLexer.location);
+	lval = new ASTNode(*parser, symbol, location, text);
+	return symbol;
 }
 
-void cpmerror(const std::string &message, const ASTLocation &location) {
-	std::cerr << Util::split(cpmParser.getBuffer(), "\n", false).at(location.line) << "\n";
-	std::cerr << "\e[31mParsing error at \e[1m" << location << "\e[22m: " << message << "\e[0m\n";
-	++cpmParser.errorCount;
-	cpmLexer.errors.emplace_back(message, location);
+void cpmerror(yyscan_t, Parser &parser, const std::string &message) {
+	parser.error(message);
 }
 
-void wasmerror(const char *message) {
-	wasmerror(std::string(message), wasmLexer.location);
+void wasmerror(yyscan_t, Parser &parser, const std::string &message) {
+	parser.error(message);
 }
 
 void wasmerror(const std::string &message) {
-	wasmerror(message, wasmLexer.location);
-}
-
-void wasmerror(const std::string &message, const ASTLocation &location) {
-	auto lines = Util::split(wasmParser.getBuffer(), "\n", false);
-	if (location.line < lines.size())
-		std::cerr << lines.at(location.line) << "\n";
-	std::cerr << "\e[31mWASM error at \e[1m" << location << "\e[22m: " << message << "\e[0m\n";
-	++wasmParser.errorCount;
-	wasmLexer.errors.emplace_back(message, location);
+	Parser::current().error(message);
 }
@@ -1,26 +1,46 @@
 #include <cstring>
+#include <fcntl.h>
 #include <fstream>
+#include <iostream>
 #include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "Lexer.h"
 #include "Parser.h"
 #include "StringSet.h"
+#include "Util.h"
 
-int cpmwrap() { return 1; }
-int wasmwrap() { return 1; }
+extern YY_BUFFER_STATE cpm_scan_buffer(char *, size_t, yyscan_t);
+extern YY_BUFFER_STATE wasm_scan_buffer(char *, size_t, yyscan_t);
+extern void cpm_delete_buffer(YY_BUFFER_STATE, yyscan_t);
+extern void wasm_delete_buffer(YY_BUFFER_STATE, yyscan_t);
 
-extern YY_BUFFER_STATE cpm_scan_buffer(char *, size_t);
-extern YY_BUFFER_STATE wasm_scan_buffer(char *, size_t);
-extern void cpm_delete_buffer(YY_BUFFER_STATE);
-extern void wasm_delete_buffer(YY_BUFFER_STATE);
+static thread_local Parser *currentParser = nullptr;
+
+Parser::Parser(Type type_): type(type_), lexer(*this) {
+	if (type == Type::Cpm)
+		cpmlex_init_extra(this, &scanner);
+	else
+		wasmlex_init_extra(this, &scanner);
+}
+
+Parser::~Parser() {
+	done();
+	if (type == Type::Cpm)
+		cpmlex_destroy(scanner);
+	else
+		wasmlex_destroy(scanner);
+}
 
 void Parser::open(const std::string &filename_) {
 	errorCount = 0;
 	filename = filename_;
 	if (type == Type::Cpm)
-		cpmin = fopen(filename.c_str(), "re");
+		cpmset_in(fopen(filename.c_str(), "re"), scanner);
 	else
-		wasmin = fopen(filename.c_str(), "re");
+		wasmset_in(fopen(filename.c_str(), "re"), scanner);
 }
 
 void Parser::in(const std::string &text) {
@@ -28,38 +48,113 @@ void Parser::in(const std::string &text) {
 	buffer = new char[text.size() + 2];
 	std::strncpy(buffer, text.c_str(), text.size() + 1);
 	buffer[text.size() + 1] = '\0'; // Input to flex needs two null terminators.
+	bufferSize = text.size();
+	if (type == Type::Cpm)
+		bufferState = cpm_scan_buffer(buffer, text.size() + 2, scanner);
+	else
+		bufferState = wasm_scan_buffer(buffer, text.size() + 2, scanner);
+}
+
+void Parser::map(const std::string &path) {
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::runtime_error("Couldn't open file for reading");
+
+	struct stat info {};
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+		::close(fd);
+		in(Util::read(path));
+		return;
+	}
+
+	const size_t size = size_t(info.st_size);
+	const size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+	const size_t length = (size + 2 + page_size - 1) / page_size * page_size;
+
+	// Reserve zeroed anonymous memory for the whole length first and then map the file over the start of it. The
+	// rest of the file's last page reads as zeroes too, so the null terminators are there even when the file ends
+	// right at a page boundary.
+	void *reserved = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (reserved == MAP_FAILED) {
+		::close(fd);
+		in(Util::read(path));
+		return;
+	}
+
+	if (0 < size && mmap(reserved, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(reserved, length);
+		::close(fd);
+		in(Util::read(path));
+		return;
+	}
+
+	::close(fd);
+	errorCount = 0;
+	buffer = static_cast<char *>(reserved);
+	bufferSize = size;
+	mappedSize = length;
 	if (type == Type::Cpm)
-		bufferState = cpm_scan_buffer(buffer, text.size() + 2);
+		bufferState = cpm_scan_buffer(buffer, size + 2, scanner);
 	else
-		bufferState = wasm_scan_buffer(buffer, text.size() + 2);
+		bufferState = wasm_scan_buffer(buffer, size + 2, scanner);
 }
 
 void Parser::debug(bool flex, bool bison) const {
 	if (type == Type::Cpm) {
-		cpm_flex_debug = int(flex);
+		cpmset_debug(int(flex), scanner);
 		cpmdebug = int(bison);
 	} else {
-		wasm_flex_debug = int(flex);
+		wasmset_debug(int(flex), scanner);
 		wasmdebug = int(bison);
 	}
 }
 
-void Parser::parse() const {
-	if (type == Type::Cpm)
-		cpmparse();
-	else
-		wasmparse();
+void Parser::parse() {
+	Parser *previous = currentParser;
+	currentParser = this;
+	try {
+		if (type == Type::Cpm)
+			cpmparse(scanner, *this);
+		else
+			wasmparse(scanner, *this);
+	} catch (...) {
+		currentParser = previous;
+		throw;
+	}
+	currentParser = previous;
 }
 
 void Parser::done() {
-	if (type == Type::Cpm)
-		cpmlex_destroy();
-	else
-		wasmlex_destroy();
+	if (bufferState != nullptr) {
+		if (type == Type::Cpm)
+			cpm_delete_buffer(bufferState, scanner);
+		else
+			wasm_delete_buffer(bufferState, scanner);
+	}
 	delete root;
-	delete buffer;
+	if (mappedSize != 0)
+		munmap(buffer, mappedSize);
+	else
+		delete[] buffer;
 	root = nullptr;
 	buffer = nullptr;
+	bufferSize = 0;
+	mappedSize = 0;
+	bufferState = nullptr;
+}
+
+void Parser::error(const std::string &message) {
+	error(message, lexer.location);
+}
+
+void Parser::error(const std::string &message, const ASTLocation &location) {
+	std::cerr << getLine(location.line) << "\n";
+	if (type == Type::Cpm)
+		std::cerr << "\e[31mParsing error at \e[1m" << location << "\e[22m: " << message << "\e[0m\n";
+	else
+		std::cerr << "\e[31mWASM error at \e[1m" << location << "\e[22m: " << message << "\e[0m\n";
+	++errorCount;
+	lexer.errors.emplace_back(message, location);
 }
 
 const char * Parser::getName(int symbol) {
@@ -70,8 +165,28 @@ const char * Parser::getName(int symbol) {
 	}
 }
 
-std::string Parser::getBuffer() const {
-	return buffer != nullptr? buffer : "";
+std::string_view Parser::getLine(size_t index) const {
+	if (buffer == nullptr)
+		return {};
+
+	const char *start = buffer;
+	const char *const end = buffer + bufferSize;
+	for (; 0 < index; --index) {
+		const void *newline = std::memchr(start, '\n', size_t(end - start));
+		if (newline == nullptr)
+			return {};
+		start = static_cast<const char *>(newline) + 1;
+	}
+
+	// flex temporarily writes a null character after the token it's looking at, which usually lies on this line.
+	const char *line_end = start;
+	while (line_end != end && *line_end != '\n' && *line_end != '\0')
+		++line_end;
+	return {start, size_t(line_end - start)};
 }
 
-Parser cpmParser(Parser::Type::Cpm), wasmParser(Parser::Type::Wasm);
+Parser & Parser::current() {
+	if (currentParser == nullptr)
+		throw std::runtime_error("No parser is running on this thread");
+	return *currentParser;
+}
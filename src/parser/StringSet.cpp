@@ -1,6 +1,7 @@
 #include "StringSet.h"
 
 std::unordered_set<std::string> StringSet::set;
+std::mutex StringSet::mutex;
 StringSet set;
 
 StringSet::StringSet() {
@@ -12,6 +13,7 @@ const std::string * StringSet::intern(const char *str) {
 }
 
 const std::string * StringSet::intern(const std::string &str) {
+	std::unique_lock lock(mutex);
 	auto handle = set.insert(str);
 	return &*handle.first;
 }
@@ -45,6 +45,9 @@ using AN = ASTNode;
 %glr-parser
 
 %define api.prefix {wasm}
+%define api.pure
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {Parser &parser}
 
 %token WASMTOK_ROOT WASMTOK_IDENT WASMTOK_INT_TYPE WASMTOK_TYPE
 
@@ -165,7 +168,7 @@ using AN = ASTNode;
 %define api.value.type {ASTNode *}
 
 %initial-action {
-    wasmParser.root = new ASTNode(wasmParser, WASMTOK_ROOT, ASTLocation(), "");
+    parser.root = new ASTNode(parser, WASMTOK_ROOT, ASTLocation(), "");
 }
 
 %%
@@ -175,15 +178,15 @@ start: program;
 program: program statement { $$ = $1->adopt($2); }
        | program label { $$ = $1->adopt($2); }
        | program endop { $$ = $1; D($2); }
-       | { $$ = wasmParser.root; };
+       | { $$ = parser.root; };
 
 statement: operation;
 endop: "\n" | ";";
 
 type: WASMTOK_TYPE;
-typed_reg: reg type { $$ = $2->adopt($1); };
+typed_reg: reg type { $$ = $1->adopt($2); };
 typed_imm: immediate type { $$ = $2->adopt($1); };
-address: immediate { $$ = (new ASTNode(wasmParser, WASMTOK_TYPE, "{uv*}"))->adopt($1); };
+address: immediate { $$ = (new ASTNode(parser, WASMTOK_TYPE, "{uv*}"))->adopt($1); };
 
 operation: op_r     | op_mult | op_multi | op_lui   | op_i     | op_c      | op_l      | op_s    | op_set   | op_divii
          | op_li    | op_si   | op_ms    | op_lni   | op_cmp   | op_cmpi   | op_sel    | op_j    | op_jc    | op_jr
@@ -334,7 +337,7 @@ ident: ident_option { $1->symbol = WASMTOK_IDENT; } | WASMTOK_IDENT;
 ident_option: "memset" | "lui" | "if" | "halt" | "on" | "off" | "sleep" | "io" | "version" | "author" | "orcid" | "name"
             | "sext" | printop | "translate";
 
-zero: number { if (*$1->text != "0") { wasmerror("Invalid number in jump condition: " + *$1->text); } };
+zero: number { if (*$1->text != "0") { parser.error("Invalid number in jump condition: " + *$1->text); } };
 
 reg: WASMTOK_REG;
 number: WASMTOK_NUMBER | "-" WASMTOK_NUMBER { $$ = $2; $$->text = StringSet::intern("-" + *$$->text); D($1); };
@@ -92,7 +92,7 @@ static TypedImmediate getImmediate(const ASTNode *node) {
 	return {OperandType(node), getUntypedImmediate(node->front())};
 }
 
-WASMBaseNode::WASMBaseNode(int sym): ASTNode(wasmParser, sym) {}
+WASMBaseNode::WASMBaseNode(int sym): ASTNode(Parser::current(), sym) {}
 
 VregPtr WASMInstructionNode::convertVariable(Function &function, VarMap &map, const std::string *name) {
 	if (registerMap.count(*name) != 0)
@@ -117,8 +117,8 @@ WASMLabelNode::operator std::string() const {
 	return "@" + *label;
 }
 
-std::unique_ptr<WhyInstruction> WASMLabelNode::convert(Function &, VarMap &) {
-	return std::make_unique<Label>(*label);
+std::shared_ptr<WhyInstruction> WASMLabelNode::convert(Function &function, VarMap &) {
+	return function.newInstruction<Label>(*label);
 }
 
 RNode::RNode(ASTNode *rs_, ASTNode *oper_, ASTNode *rt_, ASTNode *rd_):
@@ -141,62 +141,62 @@ RNode::operator std::string() const {
 	return *rs + " " + *oper + " " + *rt + " -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> RNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> RNode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
 
 	switch (operToken) {
 		case WASMTOK_PERCENT:
-			return std::make_unique<ModRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<ModRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_SLASH:
-			return std::make_unique<DivRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<DivRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_LANGLE:
-			return std::make_unique<ComparisonRInstruction>(conv(rs), conv(rt), conv(rd), Comparison::Lt);
+			return function.newInstruction<ComparisonRInstruction>(conv(rs), conv(rt), conv(rd), Comparison::Lt);
 		case WASMTOK_LEQ:
-			return std::make_unique<ComparisonRInstruction>(conv(rs), conv(rt), conv(rd), Comparison::Lte);
+			return function.newInstruction<ComparisonRInstruction>(conv(rs), conv(rt), conv(rd), Comparison::Lte);
 		case WASMTOK_DEQ:
-			return std::make_unique<ComparisonRInstruction>(conv(rs), conv(rt), conv(rd), Comparison::Eq);
+			return function.newInstruction<ComparisonRInstruction>(conv(rs), conv(rt), conv(rd), Comparison::Eq);
 		case WASMTOK_RANGLE:
-			return std::make_unique<ComparisonRInstruction>(conv(rs), conv(rt), conv(rd), Comparison::Gt);
+			return function.newInstruction<ComparisonRInstruction>(conv(rs), conv(rt), conv(rd), Comparison::Gt);
 		case WASMTOK_GEQ:
-			return std::make_unique<ComparisonRInstruction>(conv(rs), conv(rt), conv(rd), Comparison::Gte);
+			return function.newInstruction<ComparisonRInstruction>(conv(rs), conv(rt), conv(rd), Comparison::Gte);
 		case WASMTOK_AND:
-			return std::make_unique<AndRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<AndRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_OR:
-			return std::make_unique<OrRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<OrRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_X:
-			return std::make_unique<XorRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<XorRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_NAND:
-			return std::make_unique<NandRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<NandRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_NOR:
-			return std::make_unique<NorRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<NorRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_XNOR:
-			return std::make_unique<XnorRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<XnorRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_LAND:
-			return std::make_unique<LandRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<LandRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_LOR:
-			return std::make_unique<LorRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<LorRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_LXOR:
-			return std::make_unique<LxorRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<LxorRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_LNAND:
-			return std::make_unique<LnandRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<LnandRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_LNOR:
-			return std::make_unique<LnorRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<LnorRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_LXNOR:
-			return std::make_unique<LxnorRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<LxnorRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_PLUS:
-			return std::make_unique<AddRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<AddRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_MINUS:
-			return std::make_unique<SubRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<SubRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_NOT:
-			return std::make_unique<NotRInstruction>(conv(rs), conv(rd));
+			return function.newInstruction<NotRInstruction>(conv(rs), conv(rd));
 		case WASMTOK_MEMSET:
-			return std::make_unique<MemsetInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<MemsetInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_LL:
-			return std::make_unique<ShiftLeftLogicalRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<ShiftLeftLogicalRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_RL:
-			return std::make_unique<ShiftRightLogicalRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<ShiftRightLogicalRInstruction>(conv(rs), conv(rt), conv(rd));
 		case WASMTOK_RA:
-			return std::make_unique<ShiftRightArithmeticRInstruction>(conv(rs), conv(rt), conv(rd));
+			return function.newInstruction<ShiftRightArithmeticRInstruction>(conv(rs), conv(rt), conv(rd));
 		default:
 			throw std::invalid_argument("Unknown operator in RNode::convert: " + *oper);
 	}
@@ -223,58 +223,58 @@ INode::operator std::string() const {
 	return *rs + " " + *oper + " " + stringify(imm) + " -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> INode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> INode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
 
 	switch (operToken) {
 		case WASMTOK_PERCENT:
-			return std::make_unique<ModIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<ModIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_SLASH:
-			return std::make_unique<DivIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<DivIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_LANGLE:
-			return std::make_unique<ComparisonIInstruction>(conv(rs), conv(rd), imm, Comparison::Lt);
+			return function.newInstruction<ComparisonIInstruction>(conv(rs), conv(rd), imm, Comparison::Lt);
 		case WASMTOK_LEQ:
-			return std::make_unique<ComparisonIInstruction>(conv(rs), conv(rd), imm, Comparison::Lte);
+			return function.newInstruction<ComparisonIInstruction>(conv(rs), conv(rd), imm, Comparison::Lte);
 		case WASMTOK_DEQ:
-			return std::make_unique<ComparisonIInstruction>(conv(rs), conv(rd), imm, Comparison::Eq);
+			return function.newInstruction<ComparisonIInstruction>(conv(rs), conv(rd), imm, Comparison::Eq);
 		case WASMTOK_RANGLE:
-			return std::make_unique<ComparisonIInstruction>(conv(rs), conv(rd), imm, Comparison::Gt);
+			return function.newInstruction<ComparisonIInstruction>(conv(rs), conv(rd), imm, Comparison::Gt);
 		case WASMTOK_GEQ:
-			return std::make_unique<ComparisonIInstruction>(conv(rs), conv(rd), imm, Comparison::Gte);
+			return function.newInstruction<ComparisonIInstruction>(conv(rs), conv(rd), imm, Comparison::Gte);
 		case WASMTOK_AND:
-			return std::make_unique<AndIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<AndIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_OR:
-			return std::make_unique<OrIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<OrIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_X:
-			return std::make_unique<XorIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<XorIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_NAND:
-			return std::make_unique<NandIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<NandIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_NOR:
-			return std::make_unique<NorIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<NorIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_XNOR:
-			return std::make_unique<XnorIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<XnorIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_LAND:
-			return std::make_unique<LandIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<LandIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_LOR:
-			return std::make_unique<LorIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<LorIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_LXOR:
-			return std::make_unique<LxorIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<LxorIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_LNAND:
-			return std::make_unique<LnandIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<LnandIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_LNOR:
-			return std::make_unique<LnorIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<LnorIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_LXNOR:
-			return std::make_unique<LxnorIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<LxnorIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_PLUS:
-			return std::make_unique<AddIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<AddIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_MINUS:
-			return std::make_unique<SubIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<SubIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_LL:
-			return std::make_unique<ShiftLeftLogicalIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<ShiftLeftLogicalIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_RL:
-			return std::make_unique<ShiftRightLogicalIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<ShiftRightLogicalIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_RA:
-			return std::make_unique<ShiftRightArithmeticIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<ShiftRightArithmeticIInstruction>(conv(rs), conv(rd), imm);
 		default:
 			throw std::invalid_argument("Unknown operator in INode::convert: " + *oper);
 	}
@@ -297,9 +297,9 @@ WASMCopyNode::operator std::string() const {
 	return "[" + *rs + "] -> [" + *rd + "]";
 }
 
-std::unique_ptr<WhyInstruction> WASMCopyNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMCopyNode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
-	return std::make_unique<CopyRInstruction>(conv(rs), conv(rd));
+	return function.newInstruction<CopyRInstruction>(conv(rs), conv(rd));
 }
 
 WASMLoadNode::WASMLoadNode(ASTNode *rs_, ASTNode *rd_):
@@ -313,9 +313,9 @@ WASMLoadNode::operator std::string() const {
 	return "[" + *rs + "] -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMLoadNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMLoadNode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
-	return std::make_unique<LoadRInstruction>(conv(rs), conv(rd));
+	return function.newInstruction<LoadRInstruction>(conv(rs), conv(rd));
 }
 
 WASMStoreNode::WASMStoreNode(ASTNode *rs_, ASTNode *rd_):
@@ -329,9 +329,9 @@ WASMStoreNode::operator std::string() const {
 	return *rs + " -> [" + *rd + "]";
 }
 
-std::unique_ptr<WhyInstruction> WASMStoreNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMStoreNode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
-	return std::make_unique<StoreRInstruction>(conv(rs), conv(rd));
+	return function.newInstruction<StoreRInstruction>(conv(rs), conv(rd));
 }
 
 WASMSetNode::WASMSetNode(ASTNode *imm_, ASTNode *rd_):
@@ -348,8 +348,8 @@ WASMSetNode::operator std::string() const {
 	return stringify(imm) + " -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMSetNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<SetIInstruction>(convertVariable(function, map, rd), imm);
+std::shared_ptr<WhyInstruction> WASMSetNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<SetIInstruction>(convertVariable(function, map, rd), imm);
 }
 
 WASMLiNode::WASMLiNode(ASTNode *imm_, ASTNode *rd_):
@@ -366,8 +366,8 @@ WASMLiNode::operator std::string() const {
 	return "[" + stringify(imm) + "] -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMLiNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<LoadIInstruction>(convertVariable(function, map, rd), imm);
+std::shared_ptr<WhyInstruction> WASMLiNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<LoadIInstruction>(convertVariable(function, map, rd), imm);
 }
 
 WASMSiNode::WASMSiNode(ASTNode *rs_, ASTNode *imm_):
@@ -384,8 +384,8 @@ WASMSiNode::operator std::string() const {
 	return *rs + " -> [" + stringify(imm) + "]";
 }
 
-std::unique_ptr<WhyInstruction> WASMSiNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<StoreIInstruction>(convertVariable(function, map, rs), imm);
+std::shared_ptr<WhyInstruction> WASMSiNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<StoreIInstruction>(convertVariable(function, map, rs), imm);
 }
 
 WASMLniNode::WASMLniNode(ASTNode *imm_, ASTNode *rd_): WASMLiNode(imm_, rd_) {
@@ -400,8 +400,8 @@ WASMLniNode::operator std::string() const {
 	return "[" + stringify(imm) + "] -> [" + *rd + "]";
 }
 
-std::unique_ptr<WhyInstruction> WASMLniNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<LoadIndirectIInstruction>(convertVariable(function, map, rd), imm);
+std::shared_ptr<WhyInstruction> WASMLniNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<LoadIndirectIInstruction>(convertVariable(function, map, rd), imm);
 }
 
 WASMMidMemoryNode::WASMMidMemoryNode(int sym, ASTNode *rs_, ASTNode *rd_):
@@ -424,9 +424,9 @@ WASMCmpNode::operator std::string() const {
 	return *rs + " ~ " + *rt;
 }
 
-std::unique_ptr<WhyInstruction> WASMCmpNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMCmpNode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
-	return std::make_unique<CompareRInstruction>(conv(rs), conv(rt));
+	return function.newInstruction<CompareRInstruction>(conv(rs), conv(rt));
 }
 
 WASMCmpiNode::WASMCmpiNode(ASTNode *rs_, ASTNode *imm_):
@@ -443,8 +443,8 @@ WASMCmpiNode::operator std::string() const {
 	return *rs + " ~ " + stringify(imm);
 }
 
-std::unique_ptr<WhyInstruction> WASMCmpiNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<CompareIInstruction>(convertVariable(function, map, rs), imm);
+std::shared_ptr<WhyInstruction> WASMCmpiNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<CompareIInstruction>(convertVariable(function, map, rs), imm);
 }
 
 WASMSelNode::WASMSelNode(ASTNode *rs_, ASTNode *oper_, ASTNode *rt_, ASTNode *rd_):
@@ -493,9 +493,9 @@ WASMSelNode::operator std::string() const {
 	return "[" + *rs + " " + oper_ + " " + *rt + "] -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMSelNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMSelNode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
-	return std::make_unique<SelectInstruction>(conv(rs), conv(rt), conv(rd), condition);
+	return function.newInstruction<SelectInstruction>(conv(rs), conv(rt), conv(rd), condition);
 }
 
 WASMJNode::WASMJNode(ASTNode *cond, ASTNode *colons, ASTNode *addr_):
@@ -518,8 +518,8 @@ WASMJNode::operator std::string() const {
 	return conditionString(condition) + std::string(link? "::" : ":") + " " + stringify(addr);
 }
 
-std::unique_ptr<WhyInstruction> WASMJNode::convert(Function &, VarMap &) {
-	return std::make_unique<JumpInstruction>(addr, link, condition);
+std::shared_ptr<WhyInstruction> WASMJNode::convert(Function &function, VarMap &) {
+	return function.newInstruction<JumpInstruction>(addr, link, condition);
 }
 
 WASMJcNode::WASMJcNode(WASMJNode *j, ASTNode *rs_):
@@ -545,8 +545,8 @@ WASMJcNode::operator std::string() const {
 	return std::string(link? "::" : ":") + " " + stringify(addr) + " if " + *rs;
 }
 
-std::unique_ptr<WhyInstruction> WASMJcNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<JumpConditionalInstruction>(addr, convertVariable(function, map, rs), link);
+std::shared_ptr<WhyInstruction> WASMJcNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<JumpConditionalInstruction>(addr, convertVariable(function, map, rs), link);
 }
 
 WASMJrNode::WASMJrNode(ASTNode *cond, ASTNode *colons, ASTNode *rd_):
@@ -569,8 +569,8 @@ WASMJrNode::operator std::string() const {
 	return conditionString(condition) + std::string(link? "::" : ":") + " " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMJrNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<JumpRegisterInstruction>(convertVariable(function, map, rd), false, condition);
+std::shared_ptr<WhyInstruction> WASMJrNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<JumpRegisterInstruction>(convertVariable(function, map, rd), false, condition);
 }
 
 WASMJrcNode::WASMJrcNode(WASMJrNode *jr, ASTNode *rs_):
@@ -594,9 +594,9 @@ WASMJrcNode::operator std::string() const {
 	return std::string(link? "::" : ":") + " " + *rd + " if " + *rs;
 }
 
-std::unique_ptr<WhyInstruction> WASMJrcNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMJrcNode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
-	return std::make_unique<JumpRegisterConditionalInstruction>(conv(rs), conv(rd), link);
+	return function.newInstruction<JumpRegisterConditionalInstruction>(conv(rs), conv(rd), link);
 }
 
 WASMMultRNode::WASMMultRNode(ASTNode *rs_, ASTNode *rt_):
@@ -613,9 +613,9 @@ WASMMultRNode::operator std::string() const {
 	return *rs + " * " + *rt;
 }
 
-std::unique_ptr<WhyInstruction> WASMMultRNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMMultRNode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
-	return std::make_unique<BareMultRInstruction>(conv(rs), conv(rt));
+	return function.newInstruction<BareMultRInstruction>(conv(rs), conv(rt));
 }
 
 WASMMultINode::WASMMultINode(ASTNode *rs_, ASTNode *imm_):
@@ -632,8 +632,8 @@ WASMMultINode::operator std::string() const {
 	return *rs + " * " + stringify(imm);
 }
 
-std::unique_ptr<WhyInstruction> WASMMultINode::convert(Function &function, VarMap &map) {
-	return std::make_unique<BareMultIInstruction>(convertVariable(function, map, rs), imm);
+std::shared_ptr<WhyInstruction> WASMMultINode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<BareMultIInstruction>(convertVariable(function, map, rs), imm);
 }
 
 WASMDiviINode::WASMDiviINode(ASTNode *imm_, ASTNode *rs_, ASTNode *rd_):
@@ -651,9 +651,9 @@ WASMDiviINode::operator std::string() const {
 	return stringify(imm) + " / " + *rs + " -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMDiviINode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMDiviINode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
-	return std::make_unique<DiviIInstruction>(conv(rs), conv(rd), imm);
+	return function.newInstruction<DiviIInstruction>(conv(rs), conv(rd), imm);
 }
 
 WASMLuiNode::WASMLuiNode(ASTNode *imm_, ASTNode *rd_):
@@ -670,8 +670,8 @@ WASMLuiNode::operator std::string() const {
 	return "lui: " + stringify(imm) + " -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMLuiNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<LuiIInstruction>(convertVariable(function, map, rd), imm);
+std::shared_ptr<WhyInstruction> WASMLuiNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<LuiIInstruction>(convertVariable(function, map, rd), imm);
 }
 
 WASMStackNode::WASMStackNode(ASTNode *reg_, bool is_push):
@@ -687,10 +687,10 @@ WASMStackNode::operator std::string() const {
 	return std::string(isPush? "[" : "]") + " " + *reg;
 }
 
-std::unique_ptr<WhyInstruction> WASMStackNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMStackNode::convert(Function &function, VarMap &map) {
 	if (isPush)
-		return std::make_unique<StackPushInstruction>(convertVariable(function, map, reg));
-	return std::make_unique<StackPopInstruction>(convertVariable(function, map, reg));
+		return function.newInstruction<StackPushInstruction>(convertVariable(function, map, reg));
+	return function.newInstruction<StackPopInstruction>(convertVariable(function, map, reg));
 }
 
 WASMNopNode::WASMNopNode(): WASMInstructionNode(WASM_NOPNODE) {}
@@ -703,8 +703,8 @@ WASMNopNode::operator std::string() const {
 	return "<>";
 }
 
-std::unique_ptr<WhyInstruction> WASMNopNode::convert(Function &, VarMap &) {
-	return std::make_unique<Nop>();
+std::shared_ptr<WhyInstruction> WASMNopNode::convert(Function &function, VarMap &) {
+	return function.newInstruction<Nop>();
 }
 
 WASMIntINode::WASMIntINode(ASTNode *imm_): WASMInstructionNode(WASM_INTINODE), imm(getImmediate(imm_)) {
@@ -719,8 +719,8 @@ WASMIntINode::operator std::string() const {
 	return "int " + stringify(imm);
 }
 
-std::unique_ptr<WhyInstruction> WASMIntINode::convert(Function &, VarMap &) {
-	return std::make_unique<IntIInstruction>(imm);
+std::shared_ptr<WhyInstruction> WASMIntINode::convert(Function &function, VarMap &) {
+	return function.newInstruction<IntIInstruction>(imm);
 }
 
 WASMRitINode::WASMRitINode(ASTNode *imm_): WASMInstructionNode(WASM_RITINODE), imm(getImmediate(imm_)) {
@@ -735,8 +735,8 @@ WASMRitINode::operator std::string() const {
 	return "rit " + stringify(imm);
 }
 
-std::unique_ptr<WhyInstruction> WASMRitINode::convert(Function &, VarMap &) {
-	return std::make_unique<RitIInstruction>(imm);
+std::shared_ptr<WhyInstruction> WASMRitINode::convert(Function &function, VarMap &) {
+	return function.newInstruction<RitIInstruction>(imm);
 }
 
 WASMTimeINode::WASMTimeINode(ASTNode *imm_): WASMInstructionNode(WASM_TIMEINODE), imm(getImmediate(imm_)) {
@@ -751,8 +751,8 @@ WASMTimeINode::operator std::string() const {
 	return "time " + stringify(imm);
 }
 
-std::unique_ptr<WhyInstruction> WASMTimeINode::convert(Function &, VarMap &) {
-	return std::make_unique<TimeIInstruction>(imm);
+std::shared_ptr<WhyInstruction> WASMTimeINode::convert(Function &function, VarMap &) {
+	return function.newInstruction<TimeIInstruction>(imm);
 }
 
 WASMTimeRNode::WASMTimeRNode(ASTNode *rs_): WASMInstructionNode(WASM_TIMERNODE), rs(rs_->text) {
@@ -767,8 +767,8 @@ WASMTimeRNode::operator std::string() const {
 	return "time " + *rs;
 }
 
-std::unique_ptr<WhyInstruction> WASMTimeRNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<TimeRInstruction>(convertVariable(function, map, rs));
+std::shared_ptr<WhyInstruction> WASMTimeRNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<TimeRInstruction>(convertVariable(function, map, rs));
 }
 
 WASMSvtimeNode::WASMSvtimeNode(ASTNode *rd_): WASMInstructionNode(WASM_SVTIMENODE), rd(rd_->text) {
@@ -783,8 +783,8 @@ WASMSvtimeNode::operator std::string() const {
 	return "%time -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMSvtimeNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<SvtimeRInstruction>(convertVariable(function, map, rd));
+std::shared_ptr<WhyInstruction> WASMSvtimeNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<SvtimeRInstruction>(convertVariable(function, map, rd));
 }
 
 WASMRingINode::WASMRingINode(ASTNode *imm_): WASMInstructionNode(WASM_RINGINODE), imm(getImmediate(imm_)) {
@@ -799,8 +799,8 @@ WASMRingINode::operator std::string() const {
 	return "ring " + stringify(imm);
 }
 
-std::unique_ptr<WhyInstruction> WASMRingINode::convert(Function &, VarMap &) {
-	return std::make_unique<RingIInstruction>(imm);
+std::shared_ptr<WhyInstruction> WASMRingINode::convert(Function &function, VarMap &) {
+	return function.newInstruction<RingIInstruction>(imm);
 }
 
 WASMRingRNode::WASMRingRNode(ASTNode *rs_): WASMInstructionNode(WASM_RINGRNODE), rs(rs_->text) {
@@ -815,8 +815,8 @@ WASMRingRNode::operator std::string() const {
 	return "%ring " + *rs;
 }
 
-std::unique_ptr<WhyInstruction> WASMRingRNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<RingRInstruction>(convertVariable(function, map, rs));
+std::shared_ptr<WhyInstruction> WASMRingRNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<RingRInstruction>(convertVariable(function, map, rs));
 }
 
 WASMSvringNode::WASMSvringNode(ASTNode *rd_): WASMInstructionNode(WASM_SVRINGNODE), rd(rd_->text) {
@@ -831,8 +831,8 @@ WASMSvringNode::operator std::string() const {
 	return "%ring -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMSvringNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<SvringRInstruction>(convertVariable(function, map, rd));
+std::shared_ptr<WhyInstruction> WASMSvringNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<SvringRInstruction>(convertVariable(function, map, rd));
 }
 
 WASMPrintNode::WASMPrintNode(ASTNode *rs_, ASTNode *type_):
@@ -880,8 +880,8 @@ WASMPrintNode::operator std::string() const {
 	}
 }
 
-std::unique_ptr<WhyInstruction> WASMPrintNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<PrintRInstruction>(convertVariable(function, map, rs), type);
+std::shared_ptr<WhyInstruction> WASMPrintNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<PrintRInstruction>(convertVariable(function, map, rs), type);
 }
 
 WASMHaltNode::WASMHaltNode(): WASMInstructionNode(WASM_HALTNODE) {}
@@ -894,8 +894,8 @@ WASMHaltNode::operator std::string() const {
 	return "<halt>";
 }
 
-std::unique_ptr<WhyInstruction> WASMHaltNode::convert(Function &, VarMap &) {
-	return std::make_unique<HaltRInstruction>();
+std::shared_ptr<WhyInstruction> WASMHaltNode::convert(Function &function, VarMap &) {
+	return function.newInstruction<HaltRInstruction>();
 }
 
 WASMSleepRNode::WASMSleepRNode(ASTNode *rs_): WASMInstructionNode(WASM_SLEEPRNODE), rs(rs_->text) {
@@ -910,8 +910,8 @@ WASMSleepRNode::operator std::string() const {
 	return "<sleep " + *rs + ">";
 }
 
-std::unique_ptr<WhyInstruction> WASMSleepRNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<SleepRInstruction>(convertVariable(function, map, rs));
+std::shared_ptr<WhyInstruction> WASMSleepRNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<SleepRInstruction>(convertVariable(function, map, rs));
 }
 
 WASMPageNode::WASMPageNode(bool on_): WASMInstructionNode(WASM_PAGENODE), on(on_) {}
@@ -924,8 +924,8 @@ WASMPageNode::operator std::string() const {
 	return "%page " + std::string(on? "on" : "off");
 }
 
-std::unique_ptr<WhyInstruction> WASMPageNode::convert(Function &, VarMap &) {
-	return std::make_unique<PageRInstruction>(on);
+std::shared_ptr<WhyInstruction> WASMPageNode::convert(Function &function, VarMap &) {
+	return function.newInstruction<PageRInstruction>(on);
 }
 
 WASMSetptINode::WASMSetptINode(ASTNode *imm_): WASMInstructionNode(WASM_SETPTINODE), imm(getImmediate(imm_)) {
@@ -940,8 +940,8 @@ WASMSetptINode::operator std::string() const {
 	return "%setpt " + stringify(imm);
 }
 
-std::unique_ptr<WhyInstruction> WASMSetptINode::convert(Function &, VarMap &) {
-	return std::make_unique<SetptIInstruction>(imm);
+std::shared_ptr<WhyInstruction> WASMSetptINode::convert(Function &function, VarMap &) {
+	return function.newInstruction<SetptIInstruction>(imm);
 }
 
 WASMSetptRNode::WASMSetptRNode(ASTNode *rs_, ASTNode *rt_):
@@ -962,8 +962,8 @@ WASMSetptRNode::operator std::string() const {
 	return ": %setpt " + *rs + " " + *rt;
 }
 
-std::unique_ptr<WhyInstruction> WASMSetptRNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<SetptRInstruction>(convertVariable(function, map, rs),
+std::shared_ptr<WhyInstruction> WASMSetptRNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<SetptRInstruction>(convertVariable(function, map, rs),
 	                                           rt != nullptr? convertVariable(function, map, rt) : nullptr);
 }
 
@@ -981,9 +981,9 @@ WASMMvNode::operator std::string() const {
 	return *rs + " -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMMvNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMMvNode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
-	return std::make_unique<MoveInstruction>(conv(rs), conv(rd));
+	return function.newInstruction<MoveInstruction>(conv(rs), conv(rd));
 }
 
 WASMSvpgNode::WASMSvpgNode(ASTNode *rd_):
@@ -999,9 +999,9 @@ WASMSvpgNode::operator std::string() const {
 	return "%page -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMSvpgNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMSvpgNode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
-	return std::make_unique<SvpgRInstruction>(conv(rd));
+	return function.newInstruction<SvpgRInstruction>(conv(rd));
 }
 
 WASMQueryNode::WASMQueryNode(QueryType type_, ASTNode *rd_):
@@ -1017,8 +1017,8 @@ WASMQueryNode::operator std::string() const {
 	return "? mem -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMQueryNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<QueryRInstruction>(convertVariable(function, map, rd), type);
+std::shared_ptr<WhyInstruction> WASMQueryNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<QueryRInstruction>(convertVariable(function, map, rd), type);
 }
 
 WASMPseudoPrintNode::WASMPseudoPrintNode(ASTNode *imm_):
@@ -1037,10 +1037,10 @@ WASMPseudoPrintNode::operator std::string() const {
 	return "<p " + (printText != nullptr? *printText : stringify(imm)) + ">";
 }
 
-std::unique_ptr<WhyInstruction> WASMPseudoPrintNode::convert(Function &, VarMap &) {
+std::shared_ptr<WhyInstruction> WASMPseudoPrintNode::convert(Function &function, VarMap &) {
 	if (printText != nullptr)
-		return std::make_unique<PrintPseudoinstruction>(*printText);
-	return std::make_unique<PrintPseudoinstruction>(imm);
+		return function.newInstruction<PrintPseudoinstruction>(*printText);
+	return function.newInstruction<PrintPseudoinstruction>(imm);
 }
 
 WASMRestNode::WASMRestNode(): WASMInstructionNode(WASM_RESTNODE) {}
@@ -1053,8 +1053,8 @@ WASMRestNode::operator std::string() const {
 	return "<rest>";
 }
 
-std::unique_ptr<WhyInstruction> WASMRestNode::convert(Function &, VarMap &) {
-	return std::make_unique<RestRInstruction>();
+std::shared_ptr<WhyInstruction> WASMRestNode::convert(Function &function, VarMap &) {
+	return function.newInstruction<RestRInstruction>();
 }
 
 WASMIONode::WASMIONode(const std::string *ident_): WASMInstructionNode(WASM_IONODE), ident(ident_) {}
@@ -1067,8 +1067,8 @@ WASMIONode::operator std::string() const {
 	return ident != nullptr? "<io " + *ident + ">" : "<io>";
 }
 
-std::unique_ptr<WhyInstruction> WASMIONode::convert(Function &, VarMap &) {
-	return std::make_unique<IOInstruction>(*ident);
+std::shared_ptr<WhyInstruction> WASMIONode::convert(Function &function, VarMap &) {
+	return function.newInstruction<IOInstruction>(*ident);
 }
 
 WASMInterruptsNode::WASMInterruptsNode(bool enable_): WASMInstructionNode(WASM_INTERRUPTSNODE), enable(enable_) {}
@@ -1081,8 +1081,8 @@ WASMInterruptsNode::operator std::string() const {
 	return enable? "%ei" : "%di";
 }
 
-std::unique_ptr<WhyInstruction> WASMInterruptsNode::convert(Function &, VarMap &) {
-	return std::make_unique<InterruptsInstruction>(enable);
+std::shared_ptr<WhyInstruction> WASMInterruptsNode::convert(Function &function, VarMap &) {
+	return function.newInstruction<InterruptsInstruction>(enable);
 }
 
 WASMInverseShiftNode::WASMInverseShiftNode(ASTNode *rs_, ASTNode *oper_, ASTNode *imm_, ASTNode *rd_):
@@ -1102,16 +1102,16 @@ WASMInverseShiftNode::operator std::string() const {
 	return stringify(imm) + " " + *oper + " " + *rs + " -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMInverseShiftNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMInverseShiftNode::convert(Function &function, VarMap &map) {
 	auto conv = [&](const std::string *str) { return convertVariable(function, map, str); };
 
 	switch (operToken) {
 		case WASMTOK_LL:
-			return std::make_unique<ShiftLeftLogicalInverseIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<ShiftLeftLogicalInverseIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_RL:
-			return std::make_unique<ShiftRightLogicalInverseIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<ShiftRightLogicalInverseIInstruction>(conv(rs), conv(rd), imm);
 		case WASMTOK_RA:
-			return std::make_unique<ShiftRightArithmeticInverseIInstruction>(conv(rs), conv(rd), imm);
+			return function.newInstruction<ShiftRightArithmeticInverseIInstruction>(conv(rs), conv(rd), imm);
 		default:
 			throw std::invalid_argument("Unknown operator in WASMInverseShiftNode::convert: " + *oper);
 	}
@@ -1131,10 +1131,10 @@ WASMTransNode::operator std::string() const {
 	return "translate " + *rs + " -> " + *rd;
 }
 
-std::unique_ptr<WhyInstruction> WASMTransNode::convert(Function &function, VarMap &map) {
+std::shared_ptr<WhyInstruction> WASMTransNode::convert(Function &function, VarMap &map) {
 	auto rs_ = convertVariable(function, map, rs);
 	auto rd_ = convertVariable(function, map, rd);
-	return std::make_unique<TranslateAddressRInstruction>(rs_, rd_);
+	return function.newInstruction<TranslateAddressRInstruction>(rs_, rd_);
 }
 
 WASMPageStackNode::WASMPageStackNode(bool is_push, const ASTNode *rs_):
@@ -1157,6 +1157,7 @@ WASMPageStackNode::operator std::string() const {
 	return ": " + std::string(isPush? "[" : "]") + " %page " + *rs;
 }
 
-std::unique_ptr<WhyInstruction> WASMPageStackNode::convert(Function &function, VarMap &map) {
-	return std::make_unique<PageStackInstruction>(isPush, rs != nullptr? convertVariable(function, map, rs) : nullptr);
+std::shared_ptr<WhyInstruction> WASMPageStackNode::convert(Function &function, VarMap &map) {
+	return function.newInstruction<PageStackInstruction>(isPush,
+		rs != nullptr? convertVariable(function, map, rs) : nullptr);
 }